@@ -0,0 +1,243 @@
+/**
+ * batch.c -- headless mode which writes samples to stdout
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "batch.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "collector.h"
+#include "outbuf.h"
+#include "pidhash.h"
+#include "sampler.h"
+
+// set by the signal handlers, checked after each wait
+static volatile sig_atomic_t batchstop = 0;
+static volatile sig_atomic_t batchreload = 0;
+
+static void batchinterupt(int signum)
+{
+	if(signum == SIGHUP) {
+		batchreload = 1;
+	} else {
+		batchstop = 1;
+	}
+}
+
+static void setbatchhandlers()
+{
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = batchinterupt;
+	sigemptyset(&action.sa_mask);
+	// no SA_RESTART, a signal has to end the wait for the next sample
+	action.sa_flags = 0;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGUSR1, &action, NULL);
+	sigaction(SIGUSR2, &action, NULL);
+	sigaction(SIGHUP, &action, NULL);
+	// a reader which went away shows up as a failed write instead
+	signal(SIGPIPE, SIG_IGN);
+}
+
+static void batchfixed(struct outbuf *out, const char *key, double value, int decimals)
+{
+	outbufstring(out, key);
+	outbuffixed(out, value, decimals);
+}
+
+static void batchuint(struct outbuf *out, const char *key, unsigned long long value)
+{
+	outbufstring(out, key);
+	outbufuint(out, value);
+}
+
+/*
+ * One line, written before the records, which describes the machine
+ */
+static void batchheader(struct outbuf *out, struct sysdata *data, struct nmondstate *state)
+{
+	char hostname[256];
+	if(gethostname(hostname, sizeof(hostname))) {
+		strcpy(hostname, "unknown");
+	}
+	hostname[sizeof(hostname) - 1] = '\0';
+
+	outbufstring(out, "# nmond batch host=");
+	outbufstring(out, hostname);
+	batchuint(out, " cpus=", (unsigned long long)data->res.cpucount);
+	batchuint(out, " mem.total=", data->hw.memorysize);
+	batchuint(out, " interval.ms=", (unsigned long long)state->refreshms);
+	batchuint(out, " burst.hz=", (unsigned long long)state->bursthz);
+	outbufchar(out, '\n');
+}
+
+/*
+ * One sample as a line of key=value fields (rates are per second)
+ */
+static void batchrecord(struct outbuf *out, struct sysdata *data)
+{
+	char timestamp[32];
+	struct tm utc;
+	gmtime_r(&data->time, &utc);
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+	outbufstring(out, "time=");
+	outbufstring(out, timestamp);
+
+	batchfixed(out, " cpu.user=", data->res.avgpercentuser, 1);
+	batchfixed(out, " cpu.sys=", data->res.avgpercentsys, 1);
+	batchfixed(out, " cpu.nice=", data->res.avgpercentnice, 1);
+	batchfixed(out, " cpu.idle=", data->res.avgpercentidle, 1);
+	if(data->burst.hz) {
+		batchfixed(out, " cpu.max=", data->burst.cpu.max, 1);
+		batchfixed(out, " cpu.p99=", data->burst.cpu.p99, 1);
+	}
+	batchfixed(out, " load1=", data->res.loadavg1, 2);
+	batchfixed(out, " load5=", data->res.loadavg5, 2);
+	batchfixed(out, " load15=", data->res.loadavg15, 2);
+
+	batchuint(out, " mem.used=", data->res.memused);
+	batchuint(out, " vm.pageouts=", data->vms);
+
+	batchuint(out, " net.in=", collectorrate(data, COLLECT_NET, data->net.ibytes - data->net.oldibytes));
+	batchuint(out, " net.out=", collectorrate(data, COLLECT_NET, data->net.obytes - data->net.oldobytes));
+	if(data->burst.hz) {
+		batchuint(out, " net.in.max=", (unsigned long long)data->burst.netin.max);
+		batchuint(out, " net.out.max=", (unsigned long long)data->burst.netout.max);
+	}
+
+	batchuint(out, " disk.read=", collectorrate(data, COLLECT_PROC, data->res.diskuser - data->res.diskuserlast));
+	batchuint(out, " disk.write=", collectorrate(data, COLLECT_PROC, data->res.diskusew - data->res.diskusewlast));
+	batchuint(out, " gpu=", collectorrate(data, COLLECT_PROC, data->res.gpuuse - data->res.gpuuselast));
+	batchuint(out, " procs=", (unsigned long long)data->procs.count);
+	outbufchar(out, '\n');
+}
+
+/*
+ * Sample without the terminal, one record per sample to stdout until
+ *  the count is reached or a signal (or a closed pipe) ends it
+ */
+int batchrun(struct nmondstate *state)
+{
+	setbatchhandlers();
+
+	struct sampler *sampler = samplernew(state->refreshms);
+	if(sampler == NULL) {
+		// TODO: handle memory allocation failure
+		return 1;
+	}
+	struct sysdata *data = &sampler->data;
+	data->proccache.hash = hashtnew();
+	sysproccacheworkers(&data->proccache, state->workers);
+	data->proccache.budget = (size_t)state->budget;
+	collectorsreload(data);
+	collectorsrun(data, BATCH_COLLECT);
+	if(state->bursthz && !samplerburst(sampler, state->bursthz)) {
+		state->bursthz = 0;
+	}
+	if(state->recordpath && !samplerrecord(sampler, state->recordpath)) {
+		fprintf(stderr, "nmond: cannot record to %s: %s\n", state->recordpath, strerror(errno));
+		samplerfree(sampler);
+		return 1;
+	}
+	if(state->rolluppath && !samplerrollup(sampler, state->rolluppath)) {
+		fprintf(stderr, "nmond: cannot keep roll-ups in %s: %s\n", state->rolluppath, \
+			(errno == EINVAL) ? "not a roll-up file" : strerror(errno));
+		samplerfree(sampler);
+		return 1;
+	}
+	if(state->metricsaddress && !samplermetrics(sampler, state->metricsaddress, state->metricstop)) {
+		fprintf(stderr, "nmond: cannot serve metrics on %s: %s\n", state->metricsaddress, \
+			(errno == EINVAL) ? "not a port or socket path" : strerror(errno));
+		samplerfree(sampler);
+		return 1;
+	}
+	samplerconfigure(sampler, BATCH_COLLECT, false);
+	// the records only have the names, which batch records do not show
+	samplershow(sampler, 0, NULL);
+
+	struct outbuf out = OUTBUF_INIT;
+	if(!outbufinit(&out, STDOUT_FILENO, 1024)) {
+		samplerfree(sampler);
+		return 1;
+	}
+	batchheader(&out, data, state);
+	outbufflush(&out);
+
+	if(!samplerstart(sampler)) {
+		samplerfree(sampler);
+		outbuffree(&out);
+		return 1;
+	}
+
+	struct pollfd ready = { samplerreadyfd(sampler), POLLIN, 0 };
+	bool fresh = false;
+	bool first = true;
+	int records = 0;
+	while(!batchstop && !out.failed) {
+		if(batchreload) {
+			batchreload = 0;
+			samplerreload(sampler);
+		}
+
+		data = samplerlatest(sampler, &fresh);
+		if(fresh) {
+			// the sample taken before the thread started has no rates yet
+			if(first) {
+				first = false;
+			} else {
+				batchrecord(&out, data);
+				outbufflush(&out);
+				records += 1;
+				if(state->count && (records >= state->count)) {
+					break;
+				}
+			}
+		}
+		// a signal also ends the wait
+		poll(&ready, 1, -1);
+	}
+
+	samplerfree(sampler);
+	outbuffree(&out);
+	return out.failed ? 1 : 0;
+}
@@ -0,0 +1,407 @@
+/**
+ * burst.c -- high frequency sampling of the cheap counters
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "burst.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "collector.h"
+
+/*
+ * Allocate the rings for a number of samples per refresh, the old rings
+ *  are only replaced (and their samples dropped) when all allocations worked
+ */
+static bool burstalloc(struct burst *burst, size_t capacity)
+{
+	size_t ringcount = (size_t)burst->cpucount + 3;
+	double **values = (double **)calloc(ringcount + 1, sizeof(double *));
+	if(values == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i <= ringcount; ++i) {
+		values[i] = (double *)malloc(sizeof(double) * capacity);
+		if(values[i] == NULL) {
+			for (size_t j = 0; j < i; ++j) {
+				free(values[j]);
+			}
+			free(values);
+			return false;
+		}
+	}
+
+	struct burstring *rings[3] = { &burst->cpu, &burst->netin, &burst->netout };
+	for (int cpuno = 0; cpuno < burst->cpucount; ++cpuno) {
+		free(burst->cpus[cpuno].values);
+		burst->cpus[cpuno].values = values[cpuno];
+		burst->cpus[cpuno].count = 0;
+		burst->cpus[cpuno].next = 0;
+	}
+	for (size_t i = 0; i < 3; ++i) {
+		free(rings[i]->values);
+		rings[i]->values = values[(size_t)burst->cpucount + i];
+		rings[i]->count = 0;
+		rings[i]->next = 0;
+	}
+	free(burst->scratch);
+	burst->scratch = values[ringcount];
+	burst->capacity = capacity;
+
+	free(values);
+	return true;
+}
+
+static size_t burstcapacity(int hz, int refreshms)
+{
+	return ((size_t)hz * (size_t)refreshms / 1000) + BURST_RING_SLACK;
+}
+
+static void burstpush(struct burstring *ring, size_t capacity, double value)
+{
+	ring->values[ring->next] = value;
+	ring->next = (ring->next + 1) % capacity;
+	if(ring->count < capacity) {
+		ring->count += 1;
+	}
+}
+
+/*
+ * Find the k-th smallest value (quickselect, reorders the values)
+ */
+static double burstselect(double *values, long count, long k)
+{
+	long left = 0;
+	long right = count - 1;
+	double pivot = 0;
+	double swap = 0;
+	long i = 0;
+	long j = 0;
+
+	while(left < right) {
+		pivot = values[left + ((right - left) / 2)];
+		i = left;
+		j = right;
+		while(i <= j) {
+			while(values[i] < pivot) {
+				++i;
+			}
+			while(values[j] > pivot) {
+				--j;
+			}
+			if(i <= j) {
+				swap = values[i];
+				values[i] = values[j];
+				values[j] = swap;
+				++i;
+				--j;
+			}
+		}
+		// values[left..j] <= pivot <= values[i..right]
+		if(k <= j) {
+			right = j;
+		} else if(k >= i) {
+			left = i;
+		} else {
+			break;
+		}
+	}
+	return values[k];
+}
+
+/*
+ * Summarize a ring (p99 is the nearest rank), then empty it
+ */
+static void burststatof(struct burstring *ring, double *scratch, struct burststat *stat)
+{
+	stat->samples = (unsigned int)ring->count;
+	if(!ring->count) {
+		stat->avg = 0;
+		stat->min = 0;
+		stat->max = 0;
+		stat->p99 = 0;
+		return;
+	}
+
+	// after a summary the ring starts over at zero, so the samples are the
+	//  first count values whether it wrapped or not
+	double sum = 0;
+	stat->min = ring->values[0];
+	stat->max = ring->values[0];
+	for (size_t i = 0; i < ring->count; ++i) {
+		sum += ring->values[i];
+		if(ring->values[i] < stat->min) {
+			stat->min = ring->values[i];
+		}
+		if(ring->values[i] > stat->max) {
+			stat->max = ring->values[i];
+		}
+	}
+	stat->avg = sum / (double)ring->count;
+
+	long rank = (long)((ring->count * 99 + 99) / 100);
+	memcpy(scratch, ring->values, sizeof(double) * ring->count);
+	stat->p99 = burstselect(scratch, (long)ring->count, rank - 1);
+
+	ring->count = 0;
+	ring->next = 0;
+}
+
+/*
+ * Take one burst sample: the busy percent of each CPU and the network rates
+ */
+static void burstsample(struct burst *burst)
+{
+	unsigned long long ibytes = 0;
+	unsigned long long obytes = 0;
+	int count = getsyscputicks(burst->ticks, burst->cpucount);
+	int netcount = getsysnetbytes(&burst->netbuffer, &burst->netbuffersize, &ibytes, &obytes);
+	bool havenet = (netcount >= 0);
+	unsigned long long now = collectorclock();
+
+	unsigned int cpubusy = 0;
+	unsigned int cputotal = 0;
+	double busy = 0;
+	double total = 0;
+
+	pthread_mutex_lock(&burst->lock);
+	if(burst->ticksprimed && (count == burst->cpucount)) {
+		for (int cpuno = 0; cpuno < count; ++cpuno) {
+			// the tick counters wrap, unsigned differences do not mind
+			cpubusy = (burst->ticks[cpuno].user - burst->lastticks[cpuno].user) +
+				(burst->ticks[cpuno].sys - burst->lastticks[cpuno].sys) +
+				(burst->ticks[cpuno].nice - burst->lastticks[cpuno].nice);
+			cputotal = cpubusy + (burst->ticks[cpuno].idle - burst->lastticks[cpuno].idle);
+			// no tick passed on this CPU, there is nothing to measure
+			if(cputotal) {
+				burstpush(&burst->cpus[cpuno], burst->capacity, (double)cpubusy * 100.0 / (double)cputotal);
+			}
+			busy += cpubusy;
+			total += cputotal;
+		}
+		if(total > 0) {
+			burstpush(&burst->cpu, burst->capacity, busy * 100.0 / total);
+		}
+	}
+	// the sums jump when an interface comes or goes, that is not a rate
+	if(burst->netprimed && havenet && (now > burst->lastnetns) && (netcount == burst->lastnetcount) &&
+		(ibytes >= burst->lastibytes) && (obytes >= burst->lastobytes)) {
+		burstpush(&burst->netin, burst->capacity, (double)(ibytes - burst->lastibytes) * 1000000000.0 / (double)(now - burst->lastnetns));
+		burstpush(&burst->netout, burst->capacity, (double)(obytes - burst->lastobytes) * 1000000000.0 / (double)(now - burst->lastnetns));
+	}
+	pthread_mutex_unlock(&burst->lock);
+
+	if(count == burst->cpucount) {
+		struct syscputicks *swap = burst->lastticks;
+		burst->lastticks = burst->ticks;
+		burst->ticks = swap;
+		burst->ticksprimed = true;
+	}
+	if(havenet) {
+		burst->lastibytes = ibytes;
+		burst->lastobytes = obytes;
+		burst->lastnetcount = netcount;
+		burst->lastnetns = now;
+		burst->netprimed = true;
+	}
+}
+
+static void *burstmain(void *arg)
+{
+	struct burst *burst = (struct burst *)arg;
+	unsigned long long periodns = 1000000000ULL / (unsigned long long)burst->hz;
+	unsigned long long deadline = collectorclock();
+	unsigned long long now = 0;
+	struct timespec wait;
+
+	while(!atomic_load(&burst->quit)) {
+		burstsample(burst);
+
+		// absolute deadlines, the time spent sampling does not add up
+		deadline += periodns;
+		now = collectorclock();
+		if(deadline <= now) {
+			// fell behind (or the machine slept), do not catch up
+			deadline = now + periodns;
+		}
+		wait.tv_sec = (time_t)((deadline - now) / 1000000000ULL);
+		wait.tv_nsec = (long)((deadline - now) % 1000000000ULL);
+		nanosleep(&wait, NULL);
+	}
+	return NULL;
+}
+
+/*
+ * Create a burst sampler, hz is clamped to BURST_MIN_HZ..BURST_MAX_HZ
+ */
+struct burst *burstnew(int hz, int cpucount, int refreshms)
+{
+	struct burst *burst = (struct burst *)calloc(1, sizeof(struct burst));
+	if(burst == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+
+	if(hz < BURST_MIN_HZ) {
+		hz = BURST_MIN_HZ;
+	}
+	if(hz > BURST_MAX_HZ) {
+		hz = BURST_MAX_HZ;
+	}
+	burst->hz = hz;
+	burst->cpucount = (cpucount > 0) ? cpucount : 1;
+
+	burst->cpus = (struct burstring *)calloc((size_t)burst->cpucount, sizeof(struct burstring));
+	burst->ticks = (struct syscputicks *)calloc((size_t)burst->cpucount, sizeof(struct syscputicks));
+	burst->lastticks = (struct syscputicks *)calloc((size_t)burst->cpucount, sizeof(struct syscputicks));
+	if((burst->cpus == NULL) || (burst->ticks == NULL) || (burst->lastticks == NULL) || !burstalloc(burst, burstcapacity(hz, refreshms))) {
+		// TODO: handle memory allocation failure
+		free(burst->cpus);
+		free(burst->ticks);
+		free(burst->lastticks);
+		free(burst);
+		return NULL;
+	}
+
+	pthread_mutex_init(&burst->lock, NULL);
+	atomic_init(&burst->quit, false);
+	return burst;
+}
+
+/*
+ * Start sampling on a thread (call with the signals blocked, they are
+ *  left to the UI thread)
+ */
+bool burststart(struct burst *burst)
+{
+	burst->running = !pthread_create(&burst->thread, NULL, burstmain, burst);
+	return burst->running;
+}
+
+/*
+ * Size the rings for a new refresh delay (the samples so far are dropped)
+ */
+void burstrefresh(struct burst *burst, int refreshms)
+{
+	size_t capacity = burstcapacity(burst->hz, refreshms);
+	if(capacity == burst->capacity) {
+		return;
+	}
+
+	pthread_mutex_lock(&burst->lock);
+	if(!burstalloc(burst, capacity)) {
+		// TODO: handle memory allocation failure
+	}
+	pthread_mutex_unlock(&burst->lock);
+}
+
+/*
+ * Summarize the samples taken since the last summary, and start over
+ */
+void burstsummarize(struct burst *burst, struct sysburst *out)
+{
+	if((out->cpus == NULL) || (out->cpucount != burst->cpucount)) {
+		struct burststat *cpus = (struct burststat *)realloc(out->cpus, sizeof(struct burststat) * (size_t)burst->cpucount);
+		if(cpus == NULL) {
+			// TODO: handle memory allocation failure
+			return;
+		}
+		out->cpus = cpus;
+		out->cpucount = burst->cpucount;
+	}
+	out->hz = burst->hz;
+
+	pthread_mutex_lock(&burst->lock);
+	for (int cpuno = 0; cpuno < burst->cpucount; ++cpuno) {
+		burststatof(&burst->cpus[cpuno], burst->scratch, &out->cpus[cpuno]);
+	}
+	burststatof(&burst->cpu, burst->scratch, &out->cpu);
+	burststatof(&burst->netin, burst->scratch, &out->netin);
+	burststatof(&burst->netout, burst->scratch, &out->netout);
+	pthread_mutex_unlock(&burst->lock);
+}
+
+/*
+ * Copy burst summaries, the copy owns its own per CPU array
+ */
+void sysburstcopy(struct sysburst *to, struct sysburst *from)
+{
+	struct burststat *cpus = to->cpus;
+	if((to->cpucount != from->cpucount) || (cpus == NULL)) {
+		cpus = (struct burststat *)realloc(to->cpus, sizeof(struct burststat) * (size_t)(from->cpucount ? from->cpucount : 1));
+		if(cpus == NULL) {
+			// TODO: handle memory allocation failure
+			return;
+		}
+	}
+
+	*to = *from;
+	to->cpus = cpus;
+	if(from->cpus && from->cpucount) {
+		memcpy(to->cpus, from->cpus, sizeof(struct burststat) * (size_t)from->cpucount);
+	}
+}
+
+void sysburstfree(struct sysburst *sysburst)
+{
+	free(sysburst->cpus);
+	sysburst->cpus = NULL;
+	sysburst->cpucount = 0;
+}
+
+void burstfree(struct burst *burst)
+{
+	if(burst == NULL) {
+		return;
+	}
+
+	if(burst->running) {
+		atomic_store(&burst->quit, true);
+		pthread_join(burst->thread, NULL);
+	}
+	for (int cpuno = 0; cpuno < burst->cpucount; ++cpuno) {
+		free(burst->cpus[cpuno].values);
+	}
+	free(burst->cpu.values);
+	free(burst->netin.values);
+	free(burst->netout.values);
+	free(burst->scratch);
+	free(burst->cpus);
+	free(burst->ticks);
+	free(burst->lastticks);
+	free(burst->netbuffer);
+	pthread_mutex_destroy(&burst->lock);
+	free(burst);
+}
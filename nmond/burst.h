@@ -0,0 +1,124 @@
+#ifndef BURST_H
+#define BURST_H
+
+/**
+ * burst.h -- high frequency sampling of the cheap counters
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sysinfo.h"
+
+// burst sampling rates (-z), the CPU tick counters only advance at 100 Hz
+#define BURST_MIN_HZ 10
+#define BURST_MAX_HZ 100
+// samples kept per refresh, beyond what the refresh delay needs
+#define BURST_RING_SLACK 16
+
+//
+// Summary of the burst samples taken during one refresh
+//
+
+struct burststat {
+	double avg;
+	double min;
+	double max;
+	double p99;
+	unsigned int samples;
+};
+#define BURSTSTAT_INIT { 0.0, 0.0, 0.0, 0.0, 0 }
+
+struct sysburst {
+	int hz; // 0 when burst sampling is off
+	int cpucount;
+	struct burststat *cpus; // busy percent of each CPU
+	struct burststat cpu; // busy percent of all CPUs
+	struct burststat netin; // bytes per second
+	struct burststat netout;
+};
+#define SYSBURST_INIT { 0, 0, NULL, BURSTSTAT_INIT, BURSTSTAT_INIT, BURSTSTAT_INIT }
+
+//
+// The burst sampler thread
+//
+
+struct burstring {
+	double *values;
+	size_t count; // values since the last summary (at most capacity)
+	size_t next;
+};
+
+struct burst {
+	int hz;
+	int cpucount;
+
+	// one ring per metric, cleared by each summary (guarded by lock)
+	pthread_mutex_t lock;
+	size_t capacity;
+	struct burstring *cpus;
+	struct burstring cpu;
+	struct burstring netin;
+	struct burstring netout;
+	double *scratch; // for the percentile selection
+
+	// counters of the previous burst sample (owned by the thread)
+	struct syscputicks *ticks;
+	struct syscputicks *lastticks;
+	bool ticksprimed;
+	unsigned long long lastibytes;
+	unsigned long long lastobytes;
+	int lastnetcount;
+	char *netbuffer; // reused NET_RT_IFLIST2 buffer
+	size_t netbuffersize;
+	unsigned long long lastnetns;
+	bool netprimed;
+
+	atomic_bool quit;
+	pthread_t thread;
+	bool running;
+};
+
+extern struct burst *burstnew(int, int, int);
+extern bool burststart(struct burst*);
+extern void burstrefresh(struct burst*, int);
+extern void burstsummarize(struct burst*, struct sysburst*);
+extern void sysburstcopy(struct sysburst*, struct sysburst*);
+extern void sysburstfree(struct sysburst*);
+extern void burstfree(struct burst*);
+
+#endif
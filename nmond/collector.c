@@ -0,0 +1,194 @@
+/**
+ * collector.c -- Registry of the system information collectors
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "collector.h"
+#include <time.h>
+
+static void collecthw(struct sysdata *data)
+{
+	getsyshwdyninfo(&data->hwdyn);
+}
+
+static void collectkern(struct sysdata *data)
+{
+	getsyskerndyninfo(&data->kerndyn, &data->kern);
+}
+
+static void collectres(struct sysdata *data)
+{
+	getsysresinfo(&data->res);
+}
+
+static void collectnet(struct sysdata *data)
+{
+	getsysnetinfo(&data->net);
+}
+
+static void collectproc(struct sysdata *data)
+{
+	getsysprocinfoall(&data->procs, &data->proccache, &data->res);
+}
+
+static void collectvm(struct sysdata *data)
+{
+	data->vms = getsysvminfo();
+}
+
+// ordered so that a collector always runs after the ones it requires
+// (never changed, what each run measured is kept in the sysdata)
+static const struct collector collectors[COLLECTOR_COUNT] = {
+	{ "hw", COLLECT_HW, COLLECT_NONE, collecthw, COLLECTOR_SLOW_NS },
+	{ "kern", COLLECT_KERN, COLLECT_NONE, collectkern, COLLECTOR_SLOW_NS },
+	{ "res", COLLECT_RES, COLLECT_NONE, collectres, 0 },
+	{ "net", COLLECT_NET, COLLECT_NONE, collectnet, 0 },
+	// the process walk sums its own disk, memory and GPU totals into
+	// sysres (it does not read the CPU load), so it needs no other collector
+	{ "proc", COLLECT_PROC, COLLECT_NONE, collectproc, 0 },
+	{ "vm", COLLECT_VM, COLLECT_NONE, collectvm, 0 }
+};
+
+/*
+ * Monotonic clock in nanoseconds (for measuring collector costs)
+ */
+unsigned long long collectorclock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long long)now.tv_sec * 1000000000ULL) + (unsigned long long)now.tv_nsec;
+}
+
+/*
+ * Expand a collector mask with the collectors it depends upon
+ */
+unsigned int collectorsrequired(unsigned int mask)
+{
+	unsigned int result = mask;
+	// walk backwards so that dependencies of dependencies are picked up
+	for (int i = COLLECTOR_COUNT - 1; i >= 0; --i) {
+		if(result & collectors[i].id) {
+			result |= collectors[i].requires;
+		}
+	}
+	return result;
+}
+
+/*
+ * Run the requested collectors (and their dependencies), timing each one
+ *  (a slow collector is skipped while its last values are recent enough)
+ */
+unsigned int collectorsrun(struct sysdata *data, unsigned int mask)
+{
+	unsigned long long started = 0;
+	mask = collectorsrequired(mask);
+
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		if(mask & collectors[i].id) {
+			started = collectorclock();
+			// a slow collector's last values stand until its period is up
+			if(collectors[i].periodns && data->startedns[i] && ((started - data->startedns[i]) < collectors[i].periodns)) {
+				data->collectns[i] = 0;
+				continue;
+			}
+			// counters are turned into rates over the time actually
+			// measured between two runs, not the nominal refresh delay
+			data->intervalns[i] = data->startedns[i] ? (started - data->startedns[i]) : 0;
+			data->startedns[i] = started;
+			collectors[i].collect(data);
+			// the sample carries its own timings (the UI reads a copy)
+			data->collectns[i] = collectorclock() - started;
+		} else {
+			data->collectns[i] = 0;
+		}
+	}
+	data->collected = mask;
+	data->time = time(NULL);
+	return mask;
+}
+
+/*
+ * Convert the change in a counter since the collector's previous run
+ *  into a per second rate (zero until the collector has run twice)
+ */
+unsigned long long collectorrate(struct sysdata *data, unsigned int id, unsigned long long delta)
+{
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		if(collectors[i].id == id) {
+			if(!data->intervalns[i]) {
+				return 0;
+			}
+			return (unsigned long long)(((double)delta * 1000000000.0) / (double)data->intervalns[i]);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Time between the collector's last two runs (ns, zero until it ran twice)
+ */
+unsigned long long collectorinterval(struct sysdata *data, unsigned int id)
+{
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		if(collectors[i].id == id) {
+			return data->intervalns[i];
+		}
+	}
+	return 0;
+}
+
+/*
+ * Collect the static hardware and kernel facts (model, OS version, ...)
+ *  these do not change at runtime, so this is only done at startup
+ *  and when the user asks for a reload (L key or SIGHUP)
+ */
+void collectorsreload(struct sysdata *data)
+{
+	getsyshwinfo(&data->hw);
+	getsyskerninfo(&data->kern);
+	data->reloads += 1;
+
+	// and the slow collectors run again with the next sample
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		if(collectors[i].periodns) {
+			data->startedns[i] = 0;
+		}
+	}
+}
+
+const struct collector *collectorsget()
+{
+	return collectors;
+}
@@ -0,0 +1,108 @@
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+/**
+ * collector.h -- Registry of the system information collectors
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "burst.h"
+#include "pidhash.h"
+#include "sysinfo.h"
+
+// collector identifiers (bit mask), panes declare which ones they consume
+#define COLLECT_NONE 0x00
+#define COLLECT_HW 0x01
+#define COLLECT_KERN 0x02
+#define COLLECT_RES 0x04
+#define COLLECT_NET 0x08
+#define COLLECT_PROC 0x10
+#define COLLECT_VM 0x20
+#define COLLECT_ALL 0x3F
+
+#define COLLECTOR_COUNT 6
+
+// the dynamic hardware and kernel facts barely change, refresh them slowly
+#define COLLECTOR_SLOW_NS 10000000000ULL
+
+//
+// Everything the collectors fill in, the panes read from here
+//
+
+struct sysdata {
+	struct syshw hw; // static facts, see collectorsreload()
+	struct syskern kern; // static facts, see collectorsreload()
+	struct syshwdyn hwdyn;
+	struct syskerndyn kerndyn;
+	struct sysres res;
+	struct sysnet net;
+
+	struct sysproctable procs;
+	struct sysproccache proccache;
+
+	unsigned long long vms;
+	time_t time; // wall clock of the sample
+
+	struct sysburst burst; // summaries of the burst samples (from the sampler)
+
+	unsigned int collected; // collectors which ran for this sample
+	unsigned long reloads; // times the static facts were read
+	unsigned long long intervalns[COLLECTOR_COUNT]; // time between each collector's last two runs
+	unsigned long long collectns[COLLECTOR_COUNT]; // time each collector took for this sample (0 when not run)
+	unsigned long long startedns[COLLECTOR_COUNT]; // when each collector last ran (monotonic clock)
+};
+#define SYSDATA_INIT { SYSHW_INIT, SYSKERN_INIT, SYSHWDYN_INIT, SYSKERNDYN_INIT, SYSRES_INIT, SYSNET_INIT, SYSPROCTABLE_INIT, SYSPROCCACHE_INIT, 0, 0, \
+SYSBURST_INIT, COLLECT_NONE, 0, { 0 }, { 0 }, { 0 } }
+
+struct collector {
+	char *name;
+	unsigned int id;
+	unsigned int requires; // collectors which must run first (same tick)
+	void (*collect)(struct sysdata*);
+	unsigned long long periodns; // shortest time between runs (0 to run for every sample)
+};
+
+extern unsigned long long collectorclock(void);
+extern unsigned int collectorsrequired(unsigned int);
+extern unsigned int collectorsrun(struct sysdata*, unsigned int);
+extern unsigned long long collectorrate(struct sysdata*, unsigned int, unsigned long long);
+extern unsigned long long collectorinterval(struct sysdata*, unsigned int);
+extern void collectorsreload(struct sysdata*);
+extern const struct collector *collectorsget(void);
+
+#endif
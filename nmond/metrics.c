@@ -0,0 +1,714 @@
+/**
+ * metrics.c -- serve the samples in the OpenMetrics text format
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+#define METRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/*
+ * Mark a descriptor non-blocking and not inherited, and keep writes
+ *  to a scraper which went away from raising SIGPIPE
+ */
+static void metricsdescriptor(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+/*
+ * Listen on a UNIX domain socket, a socket left behind by an earlier run
+ *  is replaced (anything else at the path is left alone)
+ */
+static int metricslistenunix(struct metrics *metrics, const char *path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0) {
+		return -1;
+	}
+	if(bind(fd, (struct sockaddr *)&address, sizeof(address))) {
+		// a socket nobody accepts on was left behind, anything else stays
+		int error = errno;
+		struct stat info;
+		bool stale = (error == EADDRINUSE) && !lstat(path, &info) && S_ISSOCK(info.st_mode) && \
+			connect(fd, (struct sockaddr *)&address, sizeof(address)) && (errno == ECONNREFUSED);
+		close(fd);
+		if(!stale) {
+			errno = error;
+			return -1;
+		}
+		unlink(path);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if((fd < 0) || bind(fd, (struct sockaddr *)&address, sizeof(address))) {
+			error = errno;
+			if(fd >= 0) {
+				close(fd);
+			}
+			errno = error;
+			return -1;
+		}
+	}
+	metrics->unixpath = strdup(path);
+	return fd;
+}
+
+/*
+ * Listen on a TCP port, the address is host:port, :port or port
+ *  (no host listens on every address, [::1]:port for IPv6)
+ */
+static int metricslistentcp(const char *address)
+{
+	char host[256] = "";
+	const char *port = strrchr(address, ':');
+	if(port) {
+		size_t length = (size_t)(port - address);
+		if((length >= 2) && (address[0] == '[') && (address[length - 1] == ']')) {
+			address += 1;
+			length -= 2;
+		}
+		if(length >= sizeof(host)) {
+			errno = EINVAL;
+			return -1;
+		}
+		memcpy(host, address, length);
+		host[length] = '\0';
+		port += 1;
+	} else {
+		port = address;
+	}
+	if(*port == '\0') {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	struct addrinfo *found = NULL;
+	if(getaddrinfo(host[0] ? host : NULL, port, &hints, &found)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	int fd = -1;
+	int error = EADDRNOTAVAIL;
+	for (struct addrinfo *each = found; each; each = each->ai_next) {
+		fd = socket(each->ai_family, each->ai_socktype, each->ai_protocol);
+		if(fd < 0) {
+			error = errno;
+			continue;
+		}
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if(!bind(fd, each->ai_addr, each->ai_addrlen)) {
+			break;
+		}
+		error = errno;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(found);
+	if(fd < 0) {
+		errno = error;
+	}
+	return fd;
+}
+
+/*
+ * Listen for scrapers on a local address (before metricsstart), returns
+ *  NULL with errno set (EINVAL for an address which cannot be parsed)
+ */
+struct metrics *metricsopen(const char *address, int topcount)
+{
+	if((address == NULL) || (*address == '\0')) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct metrics *metrics = (struct metrics *)calloc(1, sizeof(struct metrics));
+	if(metrics == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	metrics->listenfd = -1;
+	metrics->wakepipe[0] = -1;
+	metrics->wakepipe[1] = -1;
+	metrics->current = -1;
+	metrics->topcount = (topcount < 0) ? 0 : ((topcount > METRICS_TOP_MAX) ? METRICS_TOP_MAX : topcount);
+	pthread_mutex_init(&metrics->lock, NULL);
+	for (int i = 0; i < METRICS_CLIENTS_MAX; ++i) {
+		metrics->clients[i].fd = -1;
+	}
+
+	bool ready = (metrics->topcount == 0);
+	if(!ready) {
+		metrics->top = (size_t *)malloc(sizeof(size_t) * (size_t)metrics->topcount);
+		// TODO: handle memory allocation failure
+		ready = (metrics->top != NULL);
+	}
+	// the expositions come to a few kilobytes, more with many CPUs
+	for (int i = 0; ready && (i < METRICS_BUFFERS); ++i) {
+		ready = outbufinit(&metrics->buffers[i].text, -1, 16 * 1024);
+	}
+	if(ready) {
+		if((address[0] == '/') || (address[0] == '.')) {
+			metrics->listenfd = metricslistenunix(metrics, address);
+		} else {
+			metrics->listenfd = metricslistentcp(address);
+		}
+		ready = (metrics->listenfd >= 0) && !listen(metrics->listenfd, METRICS_CLIENTS_MAX) && \
+			!pipe(metrics->wakepipe);
+	}
+	if(!ready) {
+		int error = errno;
+		metricsclose(metrics);
+		errno = error;
+		return NULL;
+	}
+
+	metricsdescriptor(metrics->listenfd);
+	for (int i = 0; i < 2; ++i) {
+		fcntl(metrics->wakepipe[i], F_SETFL, fcntl(metrics->wakepipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(metrics->wakepipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	return metrics;
+}
+
+//
+// Rendering (on the sampler thread)
+//
+
+/*
+ * A label value, with the backslash, quote and newline escaped
+ */
+static void metricslabel(struct outbuf *out, const char *value)
+{
+	for (const char *each = value; *each; ++each) {
+		if(*each == '\\') {
+			outbufstring(out, "\\\\");
+		} else if(*each == '"') {
+			outbufstring(out, "\\\"");
+		} else if(*each == '\n') {
+			outbufstring(out, "\\n");
+		} else {
+			outbufchar(out, *each);
+		}
+	}
+}
+
+static void metricsfamily(struct outbuf *out, const char *name, const char *type, const char *help)
+{
+	outbufstring(out, "# TYPE ");
+	outbufstring(out, name);
+	outbufchar(out, ' ');
+	outbufstring(out, type);
+	outbufstring(out, "\n# HELP ");
+	outbufstring(out, name);
+	outbufchar(out, ' ');
+	outbufstring(out, help);
+	outbufchar(out, '\n');
+}
+
+static void metricsuint(struct outbuf *out, const char *name, unsigned long long value)
+{
+	outbufstring(out, name);
+	outbufchar(out, ' ');
+	outbufuint(out, value);
+	outbufchar(out, '\n');
+}
+
+static void metricscpu(struct outbuf *out, int cpu, const char *mode, double value)
+{
+	outbufstring(out, "nmond_cpu_percent{cpu=\"");
+	outbufint(out, cpu);
+	outbufstring(out, "\",mode=\"");
+	outbufstring(out, mode);
+	outbufstring(out, "\"} ");
+	outbuffixed(out, value, 2);
+	outbufchar(out, '\n');
+}
+
+static void metricsload(struct outbuf *out, const char *period, double value)
+{
+	outbufstring(out, "nmond_load_average{period=\"");
+	outbufstring(out, period);
+	outbufstring(out, "\"} ");
+	outbuffixed(out, value, 2);
+	outbufchar(out, '\n');
+}
+
+/*
+ * The labels of a process sample, {pid="...",name="..."}
+ */
+static void metricsprocess(struct outbuf *out, const char *name, struct sysproctable *procs, size_t row)
+{
+	outbufstring(out, name);
+	outbufstring(out, "{pid=\"");
+	outbufint(out, procs->pid[row]);
+	outbufstring(out, "\",name=\"");
+	metricslabel(out, procs->records[row]->name);
+	outbufstring(out, "\"} ");
+}
+
+/*
+ * Pick the busiest processes, by insertion into a list kept in order
+ *  (the list is short, so this beats sorting every process)
+ */
+static size_t metricstop(struct metrics *metrics, struct sysproctable *procs)
+{
+	size_t count = 0;
+	size_t most = (size_t)metrics->topcount;
+	for (size_t row = 0; row < procs->count; ++row) {
+		double percentage = procs->percentage[row];
+		if((count == most) && (percentage <= procs->percentage[metrics->top[count - 1]])) {
+			continue;
+		}
+		size_t at = (count < most) ? count++ : (count - 1);
+		while(at && (procs->percentage[metrics->top[at - 1]] < percentage)) {
+			metrics->top[at] = metrics->top[at - 1];
+			at -= 1;
+		}
+		metrics->top[at] = row;
+	}
+	return count;
+}
+
+/*
+ * Write the exposition of a sample
+ */
+static void metricsexposition(struct metrics *metrics, struct outbuf *out, struct sysdata *data)
+{
+	if(data->collected & COLLECT_RES) {
+		metricsfamily(out, "nmond_cpu_percent", "gauge", "CPU time used by each logical CPU, by mode.");
+		for (int i = 0; data->res.cpus && (i < data->res.cpucount); ++i) {
+			struct sysrescpu *cpu = &data->res.cpus[i];
+			metricscpu(out, i, "user", cpu->percentuser);
+			metricscpu(out, i, "system", cpu->percentsys);
+			metricscpu(out, i, "nice", cpu->percentnice);
+			metricscpu(out, i, "idle", cpu->percentidle);
+		}
+
+		metricsfamily(out, "nmond_load_average", "gauge", "Run queue length averaged over a period.");
+		metricsload(out, "1m", data->res.loadavg1);
+		metricsload(out, "5m", data->res.loadavg5);
+		metricsload(out, "15m", data->res.loadavg15);
+
+		metricsfamily(out, "nmond_memory_bytes", "gauge", "Physical memory.");
+		outbufstring(out, "nmond_memory_bytes{state=\"total\"} ");
+		outbufuint(out, data->hw.memorysize);
+		outbufstring(out, "\nnmond_memory_bytes{state=\"used\"} ");
+		outbufuint(out, data->res.memused);
+		outbufchar(out, '\n');
+	}
+
+	if(data->collected & COLLECT_NET) {
+		metricsfamily(out, "nmond_network_receive_bytes", "counter", "Bytes received on all interfaces.");
+		metricsuint(out, "nmond_network_receive_bytes_total", data->net.ibytes);
+		metricsfamily(out, "nmond_network_transmit_bytes", "counter", "Bytes sent on all interfaces.");
+		metricsuint(out, "nmond_network_transmit_bytes_total", data->net.obytes);
+		metricsfamily(out, "nmond_network_receive_packets", "counter", "Packets received on all interfaces.");
+		metricsuint(out, "nmond_network_receive_packets_total", data->net.ipackets);
+		metricsfamily(out, "nmond_network_transmit_packets", "counter", "Packets sent on all interfaces.");
+		metricsuint(out, "nmond_network_transmit_packets_total", data->net.opackets);
+		metricsfamily(out, "nmond_network_receive_errors", "counter", "Receive errors on all interfaces.");
+		metricsuint(out, "nmond_network_receive_errors_total", data->net.ierrors);
+		metricsfamily(out, "nmond_network_transmit_errors", "counter", "Send errors on all interfaces.");
+		metricsuint(out, "nmond_network_transmit_errors_total", data->net.oerrors);
+	}
+
+	if(data->collected & COLLECT_PROC) {
+		// the disk figures are summed over the live processes, so they drop
+		// when a process exits and cannot be exported as counters
+		metricsfamily(out, "nmond_disk_read_bytes_per_second", "gauge", "Disk reads by all processes.");
+		metricsuint(out, "nmond_disk_read_bytes_per_second", \
+			collectorrate(data, COLLECT_PROC, data->res.diskuser - data->res.diskuserlast));
+		metricsfamily(out, "nmond_disk_write_bytes_per_second", "gauge", "Disk writes by all processes.");
+		metricsuint(out, "nmond_disk_write_bytes_per_second", \
+			collectorrate(data, COLLECT_PROC, data->res.diskusew - data->res.diskusewlast));
+
+		metricsfamily(out, "nmond_processes", "gauge", "Processes running.");
+		metricsuint(out, "nmond_processes", data->procs.count);
+
+		size_t count = metrics->topcount ? metricstop(metrics, &data->procs) : 0;
+		if(count) {
+			metricsfamily(out, "nmond_process_cpu_percent", "gauge", "CPU time used by the busiest processes.");
+			for (size_t i = 0; i < count; ++i) {
+				metricsprocess(out, "nmond_process_cpu_percent", &data->procs, metrics->top[i]);
+				outbuffixed(out, data->procs.percentage[metrics->top[i]], 2);
+				outbufchar(out, '\n');
+			}
+			metricsfamily(out, "nmond_process_resident_bytes", "gauge", "Resident memory of the busiest processes.");
+			for (size_t i = 0; i < count; ++i) {
+				metricsprocess(out, "nmond_process_resident_bytes", &data->procs, metrics->top[i]);
+				outbufuint(out, data->procs.residentmem[metrics->top[i]]);
+				outbufchar(out, '\n');
+			}
+		}
+	}
+
+	if(data->collected & COLLECT_VM) {
+		metricsfamily(out, "nmond_vm_pageouts", "counter", "Pages written out to the backing store.");
+		metricsuint(out, "nmond_vm_pageouts_total", data->vms);
+	}
+
+	metricsfamily(out, "nmond_sample_time_seconds", "gauge", "Wall clock time of the sample.");
+	metricsuint(out, "nmond_sample_time_seconds", (unsigned long long)data->time);
+	outbufstring(out, "# EOF\n");
+}
+
+/*
+ * Render a sample once (on the sampler thread), every scrape until the
+ *  next sample is served from the rendered text. A buffer still being
+ *  sent to a slow scraper is never rendered into; when all of them are,
+ *  the sample is skipped and scrapers are served the previous one.
+ */
+void metricsrender(struct metrics *metrics, struct sysdata *data)
+{
+	if(metrics == NULL) {
+		return;
+	}
+
+	int target = -1;
+	pthread_mutex_lock(&metrics->lock);
+	for (int i = 0; i < METRICS_BUFFERS; ++i) {
+		if((i != metrics->current) && (metrics->buffers[i].readers == 0)) {
+			target = i;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&metrics->lock);
+	if(target < 0) {
+		metrics->skipped += 1;
+		return;
+	}
+
+	// the server only sends the current buffer, so this one is ours
+	struct outbuf *out = &metrics->buffers[target].text;
+	out->length = 0;
+	metricsexposition(metrics, out, data);
+
+	pthread_mutex_lock(&metrics->lock);
+	metrics->current = target;
+	pthread_mutex_unlock(&metrics->lock);
+}
+
+//
+// Serving (on the server thread)
+//
+
+/*
+ * Hang up on a scraper, giving back the exposition it was sent
+ */
+static void metricsdrop(struct metrics *metrics, struct metricsclient *client)
+{
+	if(client->buffer >= 0) {
+		pthread_mutex_lock(&metrics->lock);
+		metrics->buffers[client->buffer].readers -= 1;
+		pthread_mutex_unlock(&metrics->lock);
+	}
+	close(client->fd);
+	client->fd = -1;
+}
+
+/*
+ * Answer a complete request, only the request line is looked at
+ */
+static void metricsrespond(struct metrics *metrics, struct metricsclient *client)
+{
+	char *request = client->request;
+	bool head = !strncmp(request, "HEAD ", 5);
+	const char *status = NULL;
+	size_t length = 0;
+
+	if(!head && strncmp(request, "GET ", 4)) {
+		status = "405 Method Not Allowed";
+	} else {
+		char *path = request + (head ? 5 : 4);
+		size_t pathlength = strcspn(path, " ?\r\n");
+		if(((pathlength == 8) && !strncmp(path, "/metrics", 8)) || ((pathlength == 1) && (*path == '/'))) {
+			pthread_mutex_lock(&metrics->lock);
+			if(metrics->current >= 0) {
+				client->buffer = metrics->current;
+				metrics->buffers[client->buffer].readers += 1;
+				length = metrics->buffers[client->buffer].text.length;
+			}
+			pthread_mutex_unlock(&metrics->lock);
+			status = (client->buffer >= 0) ? "200 OK" : "503 Service Unavailable";
+		} else {
+			status = "404 Not Found";
+		}
+	}
+
+	int written = snprintf(client->head, sizeof(client->head), \
+		"HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", \
+		status, (client->buffer >= 0) ? METRICS_CONTENT_TYPE : "text/plain", length);
+	client->headlength = ((written > 0) && ((size_t)written < sizeof(client->head))) ? (size_t)written : 0;
+	if(head && (client->buffer >= 0)) {
+		// the length was wanted, not the text
+		pthread_mutex_lock(&metrics->lock);
+		metrics->buffers[client->buffer].readers -= 1;
+		pthread_mutex_unlock(&metrics->lock);
+		client->buffer = -1;
+	}
+	client->sent = 0;
+	metrics->scrapes += 1;
+}
+
+/*
+ * Read more of a request, returns false when the scraper is to be dropped
+ */
+static bool metricsread(struct metrics *metrics, struct metricsclient *client)
+{
+	ssize_t count = recv(client->fd, client->request + client->received, \
+		sizeof(client->request) - 1 - client->received, 0);
+	if(count <= 0) {
+		return (count < 0) && ((errno == EAGAIN) || (errno == EINTR));
+	}
+	client->received += (size_t)count;
+	client->request[client->received] = '\0';
+	if(strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")) {
+		metricsrespond(metrics, client);
+		return client->headlength > 0;
+	}
+	// requests which do not fit are not scrapes
+	return client->received < (sizeof(client->request) - 1);
+}
+
+/*
+ * Send more of a response, returns false when it is done (or failed)
+ */
+static bool metricswrite(struct metrics *metrics, struct metricsclient *client)
+{
+	while(true) {
+		const char *bytes = NULL;
+		size_t left = 0;
+		if(client->sent < client->headlength) {
+			bytes = client->head + client->sent;
+			left = client->headlength - client->sent;
+		} else if(client->buffer >= 0) {
+			// the buffer is not rendered into while it has readers
+			struct outbuf *text = &metrics->buffers[client->buffer].text;
+			size_t offset = client->sent - client->headlength;
+			bytes = text->data + offset;
+			left = text->length - offset;
+		}
+		if(left == 0) {
+			return false;
+		}
+
+		ssize_t count = send(client->fd, bytes, left, MSG_NOSIGNAL);
+		if(count < 0) {
+			return (errno == EAGAIN) || (errno == EINTR);
+		}
+		client->sent += (size_t)count;
+	}
+}
+
+/*
+ * Take new scrapers while there is room for them
+ */
+static void metricsaccept(struct metrics *metrics, unsigned long long now)
+{
+	for (int i = 0; i < METRICS_CLIENTS_MAX; ++i) {
+		struct metricsclient *client = &metrics->clients[i];
+		if(client->fd >= 0) {
+			continue;
+		}
+		int fd = accept(metrics->listenfd, NULL, NULL);
+		if(fd < 0) {
+			return;
+		}
+		metricsdescriptor(fd);
+		client->fd = fd;
+		client->received = 0;
+		client->headlength = 0;
+		client->buffer = -1;
+		client->sent = 0;
+		client->lastactive = now;
+	}
+}
+
+static void *metricsmain(void *arg)
+{
+	struct metrics *metrics = (struct metrics *)arg;
+	struct pollfd polled[METRICS_CLIENTS_MAX + 2];
+	int polledclient[METRICS_CLIENTS_MAX + 2];
+
+	while(!atomic_load(&metrics->quit)) {
+		nfds_t count = 0;
+		polled[count].fd = metrics->wakepipe[0];
+		polled[count].events = POLLIN;
+		polledclient[count++] = -1;
+
+		bool room = false;
+		for (int i = 0; i < METRICS_CLIENTS_MAX; ++i) {
+			struct metricsclient *client = &metrics->clients[i];
+			if(client->fd < 0) {
+				room = true;
+				continue;
+			}
+			polled[count].fd = client->fd;
+			polled[count].events = client->headlength ? POLLOUT : POLLIN;
+			polledclient[count++] = i;
+		}
+		// with every slot taken, new scrapers wait in the listen backlog
+		if(room) {
+			polled[count].fd = metrics->listenfd;
+			polled[count].events = POLLIN;
+			polledclient[count++] = -1;
+		}
+
+		if(poll(polled, count, 1000) < 0) {
+			continue;
+		}
+		if(atomic_load(&metrics->quit)) {
+			break;
+		}
+
+		unsigned long long now = collectorclock();
+		char drain[64];
+		if(polled[0].revents) {
+			while(read(metrics->wakepipe[0], drain, sizeof(drain)) > 0) {
+			}
+		}
+		for (nfds_t i = 1; i < count; ++i) {
+			if(!polled[i].revents) {
+				continue;
+			}
+			if(polledclient[i] < 0) {
+				metricsaccept(metrics, now);
+				continue;
+			}
+			struct metricsclient *client = &metrics->clients[polledclient[i]];
+			bool keep = client->headlength ? metricswrite(metrics, client) : metricsread(metrics, client);
+			if(keep) {
+				client->lastactive = now;
+			} else {
+				metricsdrop(metrics, client);
+			}
+		}
+
+		for (int i = 0; i < METRICS_CLIENTS_MAX; ++i) {
+			struct metricsclient *client = &metrics->clients[i];
+			if((client->fd >= 0) && ((now - client->lastactive) > (METRICS_IDLE_MS * 1000000ULL))) {
+				metricsdrop(metrics, client);
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Start serving scrapers on a thread (with every signal blocked)
+ */
+bool metricsstart(struct metrics *metrics)
+{
+	sigset_t blocked;
+	sigset_t previous;
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+	metrics->running = !pthread_create(&metrics->thread, NULL, metricsmain, metrics);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	return metrics->running;
+}
+
+void metricsclose(struct metrics *metrics)
+{
+	if(metrics == NULL) {
+		return;
+	}
+
+	if(metrics->running) {
+		atomic_store(&metrics->quit, true);
+		ssize_t written = write(metrics->wakepipe[1], "", 1);
+		(void)written;
+		pthread_join(metrics->thread, NULL);
+	}
+	for (int i = 0; i < METRICS_CLIENTS_MAX; ++i) {
+		if(metrics->clients[i].fd >= 0) {
+			close(metrics->clients[i].fd);
+		}
+	}
+	if(metrics->listenfd >= 0) {
+		close(metrics->listenfd);
+	}
+	if(metrics->unixpath) {
+		unlink(metrics->unixpath);
+		free(metrics->unixpath);
+	}
+	for (int i = 0; i < 2; ++i) {
+		if(metrics->wakepipe[i] >= 0) {
+			close(metrics->wakepipe[i]);
+		}
+	}
+	for (int i = 0; i < METRICS_BUFFERS; ++i) {
+		outbuffree(&metrics->buffers[i].text);
+	}
+	free(metrics->top);
+	pthread_mutex_destroy(&metrics->lock);
+	free(metrics);
+}
@@ -0,0 +1,102 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/**
+ * metrics.h -- serve the samples in the OpenMetrics text format
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "collector.h"
+#include "outbuf.h"
+
+// statistics which are exported, they are collected for every sample
+#define METRICS_COLLECT (COLLECT_RES | COLLECT_NET | COLLECT_PROC | COLLECT_VM)
+// busiest processes exported at most (-p)
+#define METRICS_TOP_MAX 100
+#define METRICS_CLIENTS_MAX 32
+// the sample is rendered into one of these, while scrapes send the others
+#define METRICS_BUFFERS 3
+#define METRICS_REQUEST_MAX 2048
+// a scraper which sends or reads nothing for this long is dropped
+#define METRICS_IDLE_MS 10000
+
+struct metricsbuffer {
+	struct outbuf text;
+	int readers; // scrapes sending it
+};
+
+struct metricsclient {
+	int fd; // -1 for a free slot
+	char request[METRICS_REQUEST_MAX];
+	size_t received;
+	char head[192]; // status line and headers
+	size_t headlength;
+	int buffer; // the exposition sent, -1 for none
+	size_t sent; // of the head, then of the exposition
+	unsigned long long lastactive; // monotonic ns
+};
+
+struct metrics {
+	int listenfd;
+	char *unixpath; // removed at close, NULL for TCP
+	int topcount;
+	size_t *top; // rows of the busiest processes (scratch for a render)
+
+	// guards the buffers and current (the sampler renders, the server sends)
+	pthread_mutex_t lock;
+	struct metricsbuffer buffers[METRICS_BUFFERS];
+	int current; // the newest exposition, -1 before the first
+	unsigned long skipped; // samples not rendered, all buffers were in use
+
+	// only used by the server thread
+	struct metricsclient clients[METRICS_CLIENTS_MAX];
+	unsigned long scrapes;
+
+	int wakepipe[2];
+	atomic_bool quit;
+	pthread_t thread;
+	bool running;
+};
+
+extern struct metrics *metricsopen(const char*, int);
+extern bool metricsstart(struct metrics*);
+extern void metricsrender(struct metrics*, struct sysdata*);
+extern void metricsclose(struct metrics*);
+
+#endif
@@ -41,17 +41,27 @@
  */
 
 #include "nmond.h"
+#include <errno.h>
 #include <math.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include "batch.h"
+#include "collector.h"
 #include "pidhash.h"
+#include "profile.h"
+#include "replay.h"
+#include "rollup.h"
+#include "sampler.h"
 #include "sysinfo.h"
+#include "uibytesize.h"
 #include "uicli.h"
 #include "uicurses.h"
+#include "xport.h"
 
 static inline void exitapp() __attribute__ ((noreturn));
 static inline void exitapp()
@@ -61,18 +71,48 @@ static inline void exitapp()
 	exit(0);
 }
 
+/*
+ * Write the profile as JSON, to the file named by NMONDEBUG when it is a
+ *  path (starts with / or .), otherwise to standard error (after curses
+ *  has given the terminal back, and the threads counting have stopped)
+ */
+static void dumpprofile(struct profile *profile, const char *path)
+{
+	FILE *out = stderr;
+	if(path && ((path[0] == '/') || (path[0] == '.'))) {
+		out = fopen(path, "w");
+		if(out == NULL) {
+			fprintf(stderr, "nmond: cannot write the profile to %s: %s\n", path, strerror(errno));
+			return;
+		}
+	}
+	profiledump(profile, out);
+	if(out != stderr) {
+		fclose(out);
+	}
+}
+
+// set by SIGINT, SIGUSR1 and SIGUSR2, the main loop stops the threads and exits
+static volatile sig_atomic_t quitrequested = 0;
+// set by SIGHUP, the main loop reloads the static system facts
+static volatile sig_atomic_t reloadrequested = 0;
+// set by SIGWINCH, the main loop resizes the screen and the long graphs
+static volatile sig_atomic_t resizerequested = 0;
+
 static inline void handleinterupt(int signum)
 {
 	// window size change
-	// TODO: clean up
 	if (signum == SIGWINCH) {
-		endwin();
-		refresh();
-		clear();
+		resizerequested = 1;
+		return;
+	// reload static hardware/kernel information
+	} else if (signum == SIGHUP) {
+		reloadrequested = 1;
 		return;
 	// all other interupts
 	} else {
-		exitapp();
+		quitrequested = 1;
+		return;
 	}
 }
 
@@ -82,6 +122,7 @@ static inline void setinterupthandlers()
 	signal(SIGUSR2, handleinterupt);
 	signal(SIGINT, handleinterupt);
 	signal(SIGWINCH, handleinterupt);
+	signal(SIGHUP, handleinterupt);
 }
 
 static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
@@ -208,6 +249,20 @@ static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
 			break;
 		case 'k':
 			break;
+		case 'l':
+			// the long graphs show the live samples, then each roll-up
+			if(state->rolluppath) {
+				state->resolution += 1;
+				if(state->resolution >= ROLLUP_LEVELS) {
+					state->resolution = ROLLUP_LIVE;
+				}
+			} else {
+				result = 0;
+			}
+			break;
+		case 'L':
+			state->reloadfacts = true;
+			break;
 		case 'm':
 			if(wins->memory.visible) {
 				wins->memory.visible = false;
@@ -220,6 +275,15 @@ static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
 			}
 			break;
 		case 'M':
+			if(wins->cpumap.visible) {
+				wins->cpumap.visible = false;
+				wins->visiblecount -= 1;
+				state->height -= wins->cpumap.height;
+			} else {
+				wins->cpumap.visible = true;
+				wins->visiblecount += 1;
+				state->height += wins->cpumap.height;
+			}
 			break;
 		case 'n':
 			if(wins->network.visible) {
@@ -245,9 +309,20 @@ static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
 			break;
 		case 'o':
 			break;
+		case 'p':
+			if(wins->profile.visible) {
+				wins->profile.visible = false;
+				wins->visiblecount -= 1;
+				state->height -= wins->profile.height;
+			} else {
+				wins->profile.visible = true;
+				wins->visiblecount += 1;
+				state->height += wins->profile.height;
+			}
+			break;
 		case 'q':
-			exitapp();
-			//break;
+			state->quit = true;
+			break;
 		case 'r':
 			if(state->topmode == TOP_MODE_C) {
 				state->topmode = TOP_MODE_NONE;
@@ -313,6 +388,7 @@ static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
 		case 'w':
 			break;
 		case 'z':
+			state->peaks = !state->peaks;
 			break;
 		case '0':
 			break;
@@ -327,14 +403,16 @@ static int setwinstate(struct uiwins *wins, struct nmondstate *state, int input)
 		case '5':
 			break;
 		case '+':
-			state->refresh = state->refresh * 2;
-			state->refreshms = state->refresh * 1000;
-			state->pendingchanges = true;
+			if(state->refreshms <= (MAXIMUM_REFRESH_MS / 2)) {
+				state->refreshms = state->refreshms * 2;
+				state->pendingchanges = true;
+			} else {
+				result = 0;
+			}
 			break;
 		case '-':
-			if(state->refresh > MINIMUM_REFRESH_RATE) {
-				state->refresh = state->refresh / 2;
-				state->refreshms = state->refresh * 1000;
+			if((state->refreshms / 2) >= MINIMUM_REFRESH_MS) {
+				state->refreshms = state->refreshms / 2;
 				state->pendingchanges = true;
 			} else {
 				result = 0;
@@ -391,17 +469,246 @@ static void processenvars(struct uiwins *wins, struct nmondstate *state)
 	}
 }
 
+/*
+ * Read the command line options (before curses takes over the terminal)
+ */
+static void processargs(int argc, char **argv, struct nmondstate *state)
+{
+	int option = 0;
+	// spreadsheet files default to a day of 5 minute snapshots, as in nmon
+	int xportrefreshms = 300000;
+	int xportcount = 288;
+	bool refreshset = false;
+	bool countset = false;
+	while((option = getopt(argc, argv, "Bc:fF:hm:M:n:o:p:P:r:R:s:tw:xXz:")) != -1) {
+		switch(option) {
+			case 'B':
+				state->batch = true;
+				break;
+			case 'c':
+				state->count = atoi(optarg);
+				if(state->count < 0) {
+					state->count = 0;
+				}
+				countset = true;
+				break;
+			case 'f':
+				state->xport = true;
+				break;
+			case 'F':
+				state->xport = true;
+				state->xportpath = optarg;
+				break;
+			case 'm':
+				state->xportdir = optarg;
+				break;
+			case 'r':
+				state->runname = optarg;
+				break;
+			case 't':
+				state->xporttop = true;
+				break;
+			case 'x':
+				// capacity planning, a day of 15 minute snapshots
+				state->xport = true;
+				state->xporttop = true;
+				xportrefreshms = 900000;
+				xportcount = 96;
+				break;
+			case 'X':
+				// capacity planning, a busy hour of 30 second snapshots
+				state->xport = true;
+				state->xporttop = true;
+				xportrefreshms = 30000;
+				xportcount = 120;
+				break;
+			case 'o':
+				state->recordpath = optarg;
+				break;
+			case 'P':
+				state->replaypath = optarg;
+				break;
+			case 'R':
+				state->rolluppath = optarg;
+				break;
+			case 'M':
+				state->metricsaddress = optarg;
+				break;
+			case 'p':
+				state->metricstop = atoi(optarg);
+				if(state->metricstop < 0) {
+					state->metricstop = 0;
+				}
+				if(state->metricstop > METRICS_TOP_MAX) {
+					state->metricstop = METRICS_TOP_MAX;
+				}
+				break;
+			case 's':
+				state->refreshms = (int)(atof(optarg) * 1000.0);
+				if(state->refreshms < MINIMUM_REFRESH_MS) {
+					state->refreshms = MINIMUM_REFRESH_MS;
+				}
+				refreshset = true;
+				break;
+			case 'n':
+				state->budget = atoi(optarg);
+				if(state->budget < 0) {
+					state->budget = 0;
+				}
+				break;
+			case 'w':
+				state->workers = atoi(optarg);
+				if(state->workers < 1) {
+					state->workers = 1;
+				}
+				break;
+			case 'z':
+				state->bursthz = atoi(optarg);
+				if(state->bursthz < 0) {
+					state->bursthz = 0;
+				}
+				state->peaks = (state->bursthz > 0);
+				break;
+			case 'h':
+				uiclhelp(VERSION);
+				exit(0);
+			default:
+				uiclhint();
+				exit(1);
+		}
+	}
+
+	if(state->xport) {
+		if(!refreshset) {
+			state->refreshms = xportrefreshms;
+		}
+		if(!countset) {
+			state->count = xportcount;
+		}
+	}
+}
+
+/*
+ * Wait until a key is pressed or the sampler publishes a new snapshot
+ *  (signals, such as a resize, also end the wait)
+ */
+static void waitforinput(struct sampler *sampler, int keyboard)
+{
+	struct pollfd input[2] = {
+		{ keyboard, POLLIN, 0 },
+		{ samplerreadyfd(sampler), POLLIN, 0 }
+	};
+	// a signal during the last frame would otherwise wait for the next sample
+	if(quitrequested) {
+		return;
+	}
+	poll(input, 2, -1);
+}
+
+/*
+ * Take on the new size of the terminal (after a SIGWINCH), outside of the
+ *  signal handler since curses is not safe to call from one
+ */
+static void resizescreen()
+{
+	struct winsize size;
+	if(!ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) && size.ws_row && size.ws_col) {
+		resizeterm(size.ws_row, size.ws_col);
+	}
+	clear();
+}
+
+/*
+ * Put the roll-up buckets of up to three metrics (columns apart in series)
+ *  in a time series for a long graph, the newest bucket last
+ */
+static void setrollchart(struct timeseries *chart, double *series, int columns, int channels)
+{
+	double values[3] = {0, 0, 0};
+
+	timeseriesclear(chart);
+	for (int i = 0; i < columns; ++i) {
+		for (int j = 0; j < channels; ++j) {
+			values[j] = series[(j * MAXCOLS) + i];
+		}
+		timeseriesappend(chart, values);
+	}
+}
+
+/*
+ * Combine the statistics needed by all of the visible panes
+ */
+static unsigned int collectorsneeded(struct uiwins *wins)
+{
+	unsigned int result = COLLECT_NONE;
+	struct uiwin *panes[] = {
+		&wins->welcome, &wins->help, &wins->sys,
+		&wins->cpu, &wins->cpulong, &wins->cpumap, &wins->gpu, &wins->energy, &wins->memory,
+		&wins->disks, &wins->disklong, &wins->network, &wins->netlong, &wins->top,
+		&wins->profile
+	};
+
+	for (int i = 0; i < (int)(sizeof(panes) / sizeof(panes[0])); ++i) {
+		if(panes[i]->visible) {
+			result |= panes[i]->collectors;
+		}
+	}
+	return result;
+}
+
 //~~~~~~
 // MAIN
 //~~~~~~
 
 int main(int argc, char **argv)
 {
+	// options are read before the terminal is taken over
+	struct nmondstate currentstate = NMONDSTATE_INIT;
+	processargs(argc, argv, &currentstate);
+
+	// batch mode and spreadsheet files never touch the terminal
+	if(currentstate.batch) {
+		return batchrun(&currentstate);
+	}
+	if(currentstate.xport) {
+		return xportrun(&currentstate, argc, argv);
+	}
+
+	// a recording is played back instead of sampling this machine
+	struct replay *replay = NULL;
+	int keyboard = STDIN_FILENO;
+	FILE *terminal = NULL;
+	if(currentstate.replaypath) {
+		if(currentstate.recordpath || currentstate.rolluppath || currentstate.metricsaddress) {
+			fprintf(stderr, "nmond: -o, -R and -M cannot be used with -P\n");
+			exit(1);
+		}
+		replay = replayopen(currentstate.replaypath);
+		if(replay == NULL) {
+			fprintf(stderr, "nmond: cannot play %s: %s\n", currentstate.replaypath, \
+				(errno == EINVAL) ? "not a recording" : strerror(errno));
+			exit(1);
+		}
+		// a recording piped in leaves the keys to the terminal
+		if(!strcmp(currentstate.replaypath, "-")) {
+			terminal = fopen("/dev/tty", "r");
+			if(terminal == NULL) {
+				fprintf(stderr, "nmond: cannot read keys from /dev/tty: %s\n", strerror(errno));
+				exit(1);
+			}
+			keyboard = fileno(terminal);
+		}
+	}
+
 	// first thing, prepare to be interupted
 	setinterupthandlers();
 
 	// initialize the ncurses environment
-	initscr();
+	if(terminal) {
+		newterm(NULL, stdout, terminal);
+	} else {
+		initscr();
+	}
 	// initialize color windows, if available
 	if(has_colors()) {
 		start_color();
@@ -434,46 +741,108 @@ int main(int argc, char **argv)
 	move(0, 0);
 
 	// initialize the app state
-	struct nmondstate currentstate = NMONDSTATE_INIT;
 	currentstate.color = has_colors();
-	currentstate.timenow = time(NULL);
-	currentstate.user = getlogin();
 	currentstate.rowoffset = 0;
-	// set wait time for getch()
-	timeout(currentstate.refreshms);
+	// getch() does not wait, waitforinput() waits for keys or new data
+	timeout(0);
 
 	// initialize system information data structures
-	struct syshw thishw = SYSHW_INIT;
-	getsyshwinfo(&thishw);
-	struct syskern thiskern = SYSKERN_INIT;
-	getsyskerninfo(&thiskern);
-	struct sysres thisres = SYSRES_INIT;
-	getsysresinfo(&thisres);
-	struct sysnet thisnet = SYSNET_INIT;
-	getsysnetinfo(&thisnet);
-	size_t processcount = 0;
-	struct sysproc **thisproc = NULL;
-	struct hashitem *thishash = hashtnew();
-	thisproc = getsysprocinfoall(&processcount, thisproc, &thishash, thisres.percentallcpu, &thisres);
-	unsigned long long sysvms = getsysvminfo();
+	// (everything is collected once so the panes can be sized, after
+	// that samples are collected on the sampler thread)
+	struct sampler *sampler = samplernew(currentstate.refreshms);
+	if(sampler == NULL) {
+		// TODO: handle memory allocation failure
+		exitapp();
+	}
+	struct sysdata *data = &sampler->data;
+	data->proccache.hash = hashtnew();
+	sysproccacheworkers(&data->proccache, currentstate.workers);
+	data->proccache.budget = (size_t)currentstate.budget;
+	// the top pane compares user names by their interned pointers
+	currentstate.user = uidcacheintern(&data->proccache.uids, getlogin());
+	if(replay) {
+		// the facts and first tick of the recording size the panes
+		currentstate.bursthz = 0;
+		currentstate.peaks = false;
+		if(!replayfirst(replay, sampler)) {
+			nocbreak();
+			endwin();
+			fprintf(stderr, "nmond: %s holds no samples\n", currentstate.replaypath);
+			exit(1);
+		}
+	} else {
+		collectorsreload(data);
+		collectorsrun(data, COLLECT_ALL);
+	}
+	if(currentstate.bursthz && !samplerburst(sampler, currentstate.bursthz)) {
+		currentstate.bursthz = 0;
+	}
+	if(currentstate.recordpath && !samplerrecord(sampler, currentstate.recordpath)) {
+		int error = errno;
+		nocbreak();
+		endwin();
+		fprintf(stderr, "nmond: cannot record to %s: %s\n", currentstate.recordpath, strerror(error));
+		exit(1);
+	}
+	if(currentstate.rolluppath && !samplerrollup(sampler, currentstate.rolluppath)) {
+		int error = errno;
+		nocbreak();
+		endwin();
+		fprintf(stderr, "nmond: cannot keep roll-ups in %s: %s\n", currentstate.rolluppath, \
+			(error == EINVAL) ? "not a roll-up file" : strerror(error));
+		exit(1);
+	}
+	if(currentstate.metricsaddress && \
+		!samplermetrics(sampler, currentstate.metricsaddress, currentstate.metricstop)) {
+		int error = errno;
+		nocbreak();
+		endwin();
+		fprintf(stderr, "nmond: cannot serve metrics on %s: %s\n", currentstate.metricsaddress, \
+			(error == EINVAL) ? "not a port or socket path" : strerror(error));
+		exit(1);
+	}
+	unsigned int collectmask = COLLECT_ALL;
+	bool fetchargs = false;
+	bool fetchedargs = false;
 
 	// initialize main() variables
 	char hostname[22];
-	gethostname(hostname, sizeof(hostname));
+	if(replay) {
+		snprintf(hostname, sizeof(hostname), "%s", data->kern.hostname);
+	} else {
+		gethostname(hostname, sizeof(hostname));
+	}
+	char seekto[32] = "";
 	bool pendingdata = false;
+	int samplesshown = 0;
+	unsigned long framepadcells = 0;
 	int pressedkey = 0;
-	int cpulongitter = 0;
-	int netlongitter = 0;
-	int disklongitter = 0;
+	int key = 0;
 	int	flash_on = 0;
+	char debugmessage[27] = "";
 	int	show_raw = 0;
 	int currentrow = 0;
 
-	int tempvalue = 0;
-	int graphcols = 70;
-	int *cpulongvals = calloc(graphcols * 3, sizeof(int));
-	unsigned int *disklongvals = calloc(graphcols * 2, sizeof(unsigned int));
-	unsigned long *netlongvals = calloc(graphcols * 2, sizeof(unsigned long));
+	// the long graphs are as wide as the terminal, their samples are
+	// kept whatever the width (user, system and nice; reads and writes;
+	// in and out), the aggregates in their titles are over what is shown
+	int graphcols = uichartcolumns(COLS);
+	struct timeseries *cpuseries = timeseriesnew(3, UI_CHART_HISTORY);
+	struct timeseries *diskseries = timeseriesnew(2, UI_CHART_HISTORY);
+	struct timeseries *netseries = timeseriesnew(2, UI_CHART_HISTORY);
+	timeserieswindow(cpuseries, (size_t)(graphcols - 1));
+	timeserieswindow(diskseries, (size_t)(graphcols - 1));
+	timeserieswindow(netseries, (size_t)(graphcols - 1));
+	double chartvalues[3];
+	// the same graphs drawn from the roll-ups, the newest bucket last
+	struct timeseries *rollchart = timeseriesnew(3, MAXCOLS);
+	double *rollseries = calloc(MAXCOLS * 3, sizeof(double));
+	int rollcolumns = 0;
+	struct rollupstat rollstat;
+	char rollbytes[READABLE_BYTES_LENGTH];
+	char cputitle[48] = "CPU Load";
+	char disktitle[48] = "Disk Usage";
+	char nettitle[48] = "Network Usage";
 
 	// TODO: do we want to move theses to setwinstate and create/destroy on show/hide?
 	// initialzie window data structures
@@ -481,30 +850,48 @@ int main(int argc, char **argv)
 	wins.welcome.height = 22;
 	wins.welcome.visible = true;
 	wins.welcome.win = newpad(wins.welcome.height, MAXCOLS);
+	// the static facts are read by collectorsreload, not by a collector
+	wins.welcome.collectors = COLLECT_NONE;
 	wins.help.height = 20;
 	wins.help.win = newpad(wins.help.height, MAXCOLS);
-	wins.cpu.height = thisres.cpucount + 3;
+	wins.cpu.height = data->res.cpucount + (currentstate.bursthz ? 4 : 3);
 	wins.cpu.win = newpad(wins.cpu.height, MAXCOLS);
+	wins.cpu.collectors = COLLECT_RES;
 	wins.cpulong.height = 11;
 	wins.cpulong.win = newpad(wins.cpulong.height, MAXCOLS);
+	wins.cpulong.collectors = COLLECT_RES;
+	struct uicpumap *cpumap = uicpumapnew(data->res.cpucount, (int)data->hw.packages, data->res.cpuhyperthreadmod);
+	wins.cpumap.height = cpumap ? uicpumapheight(cpumap) : 1;
+	wins.cpumap.win = newpad(wins.cpumap.height, MAXCOLS);
+	wins.cpumap.collectors = COLLECT_RES;
+	// how long nmond takes over each collector and pane, and what it costs
+	struct profile *profile = profilenew();
+	wins.profile.height = uiprofileheight();
+	wins.profile.win = newpad(wins.profile.height, MAXCOLS);
+	wins.profile.collectors = COLLECT_NONE;
 	wins.disks.height = 3;
 	wins.disks.win = newpad(wins.disks.height, MAXCOLS);
+	wins.disks.collectors = COLLECT_PROC;
 	wins.disklong.height = 11;
 	wins.disklong.win = newpad(wins.disklong.height, MAXCOLS);
+	wins.disklong.collectors = COLLECT_PROC;
 	// wins.diskgroup.height = MAXROWS;
 	// wins.diskgroup.win = newpad(wins.diskgroup.height, MAXCOLS);
 	// wins.diskmap.height = 24;
 	// wins.diskmap.win = newpad(wins.diskmap.height, MAXCOLS);
 	wins.energy.height = 2;
 	wins.energy.win = newpad(wins.energy.height, MAXCOLS);
+	wins.energy.collectors = COLLECT_RES;
 	// wins.filesys.height = MAXROWS;
 	// wins.filesys.win = newpad(wins.filesys.height, MAXCOLS);
 	wins.gpu.height = 2;
 	wins.gpu.win = newpad(wins.gpu.height, MAXCOLS);
+	wins.gpu.collectors = COLLECT_PROC;
 	// wins.kernel.height = 5;
 	// wins.kernel.win = newpad(wins.kernel.height, MAXCOLS);
 	wins.memory.height = 3;
 	wins.memory.win = newpad(wins.memory.height, MAXCOLS);
+	wins.memory.collectors = COLLECT_PROC | COLLECT_VM;
 	// wins.memlarge.height = 20;
 	// wins.memlarge.win = newpad(wins.memlarge.height, MAXCOLS);
 	// wins.memvirtual.height = 20;
@@ -513,14 +900,19 @@ int main(int argc, char **argv)
 	// wins.neterrors.win = newpad(wins.neterrors.height, MAXCOLS);
 	// wins.netfilesys.height = 25;
 	// wins.netfilesys.win = newpad(wins.netfilesys.height, MAXCOLS);
-	wins.network.height = 3;
+	wins.network.height = currentstate.bursthz ? 4 : 3;
 	wins.network.win = newpad(wins.network.height, MAXCOLS);
+	wins.network.collectors = COLLECT_NET;
 	wins.netlong.height = 11;
 	wins.netlong.win = newpad(wins.netlong.height, MAXCOLS);
+	wins.netlong.collectors = COLLECT_NET;
 	wins.top.height = LINES - 2;
 	wins.top.win = newpad(wins.top.height, MAXCOLS);
-	wins.sys.height = 10;
+	wins.top.collectors = COLLECT_PROC;
+	wins.sys.height = 12;
 	wins.sys.win = newpad(wins.sys.height, MAXCOLS);
+	// uptime, active CPUs and thermal levels (the rest is static)
+	wins.sys.collectors = COLLECT_HW | COLLECT_KERN;
 	// wins.warn.height = 8;
 	// wins.warn.win = newpad(wins.warn.height, MAXCOLS);
 
@@ -531,103 +923,218 @@ int main(int argc, char **argv)
 	// refresh the display
 	refresh();
 
+	// the UI thread only reads the snapshots from here on
+	if(replay ? !replaystart(replay) : !samplerstart(sampler)) {
+		exitapp();
+	}
+
 	// Main program loop
-	for(;;) {
+	while(!quitrequested && !currentstate.quit) {
 		// Reset the cursor position to top left
 		currentrow = 0 - currentstate.rowoffset;
 
-		// don't update too much (not every keypress)
-		currentstate.timenow = time(NULL);
-		currentstate.elapsed = currentstate.timenow - currentstate.timelast;
-		if (pressedkey || (currentstate.elapsed >= currentstate.refresh) || (currentstate.timelast <= 0)) {
-			// update the header
-			uiheader(&stdscr, 0, currentstate.color, flash_on, hostname, "", currentstate.refresh, time(0));
+		// render the newest complete sample, a slow sample never holds up
+		// the keyboard and a slow terminal never holds up sampling
+		data = samplerlatest(sampler, &pendingdata);
 
-			if((currentstate.elapsed >= currentstate.refresh) || (currentstate.timelast <= 0)) {
-				currentstate.timelast = time(NULL);
+		// static facts are only re-read on request (L key or SIGHUP)
+		if(reloadrequested || currentstate.reloadfacts) {
+			reloadrequested = 0;
+			currentstate.reloadfacts = false;
+			samplerreload(sampler);
+		}
 
-				// TODO: only check statistics which are used
-				// update system information data structures
-				getsyshwinfo(&thishw);
-				getsyskerninfo(&thiskern);
-				getsysresinfo(&thisres);
-				getsysnetinfo(&thisnet);
-				processcount = 0;
-				thisproc = getsysprocinfoall(&processcount, thisproc, &thishash, thisres.percentallcpu, &thisres);
-				sysvms = getsysvminfo();
+		// the terminal changed size, the long graphs follow its width (the
+		// samples behind them are kept) and every pane is drawn again
+		if(resizerequested) {
+			resizerequested = 0;
+			resizescreen();
+			graphcols = uichartcolumns(COLS);
+			timeserieswindow(cpuseries, (size_t)(graphcols - 1));
+			timeserieswindow(diskseries, (size_t)(graphcols - 1));
+			timeserieswindow(netseries, (size_t)(graphcols - 1));
+			pressedkey = 1;
+		}
+
+		// only check statistics which are used by the visible panes
+		// (command lines are only read while a top mode shows them)
+		collectmask = collectorsneeded(&wins);
+		// the roll-ups are fed by every sample
+		if(sampler->rollup) {
+			collectmask |= ROLLUP_COLLECT;
+		}
+		// and so are the scrapers
+		if(sampler->metrics) {
+			collectmask |= METRICS_COLLECT;
+		}
+		fetchargs = wins.top.visible && ((currentstate.topmode == TOP_MODE_B) || (currentstate.topmode == TOP_MODE_D));
+		samplerconfigure(sampler, collectmask, fetchargs);
+		// only the records of the rows the top pane can show are published
+		// (uitop shows at most LINES, see uitoprows)
+		if(wins.top.visible && uitopcompare(currentstate.topmode)) {
+			samplershow(sampler, (size_t)LINES, uitopcompare(currentstate.topmode));
+		} else {
+			samplershow(sampler, 0, NULL);
+		}
+		// a newly shown pane should not wait a full refresh for its data
+		if((collectmask & ~data->collected) || (fetchargs && !fetchedargs)) {
+			samplerforce(sampler);
+		}
+		fetchedargs = fetchargs;
 
-				// data changes are pending gui update
-				pendingdata = true;
+		if (pressedkey || pendingdata) {
+			profileframe(profile);
+			// update the header
+			if(replay) {
+				// the time and host shown are the recorded ones
+				replaystatus(replay, debugmessage, sizeof(debugmessage));
+				uiheader(&stdscr, 0, currentstate.color, true, hostname, debugmessage, currentstate.refreshms / 1000.0, data->time);
+			} else if(currentstate.debug) {
+				// processes sampled by the last walk, hot and cold (of all cold),
+				// padded so that a shorter message covers the last one
+				snprintf(debugmessage, sizeof(debugmessage), "hot %-5zu cold %-4zu/%-6zu", \
+					data->proccache.sampledhot, data->proccache.sampledcold, data->proccache.cold);
+				uiheader(&stdscr, 0, currentstate.color, true, hostname, debugmessage, currentstate.refreshms / 1000.0, time(0));
+				// pad cells written by the last frame's panes, on the bottom border
+				mvwprintw(stdscr, LINES-1, COLS-20, " pad cells %-7lu ", framepadcells);
+				wnoutrefresh(stdscr);
+			} else {
+				uiheader(&stdscr, 0, currentstate.color, flash_on, hostname, "", currentstate.refreshms / 1000.0, time(0));
 			}
 
 			// update the in-use panes
 			if(wins.welcome.visible) {
-				uiwelcome(&wins.welcome.win, wins.welcome.height, &currentrow, COLS, LINES, currentstate.color, thishw);
+				profilestart(profile);
+				uiwelcome(&wins.welcome.win, wins.welcome.height, &currentrow, COLS, LINES, currentstate.color, data->hw);
+				profilestop(profile, PROFILE_WELCOME);
 			}
 			if (wins.help.visible) {
+				profilestart(profile);
 				uihelp(&wins.help.win, wins.help.height, &currentrow, COLS, LINES);
+				profilestop(profile, PROFILE_HELP);
 			}
 			if (wins.sys.visible) {
-				uisys(&wins.sys.win, wins.sys.height, &currentrow, COLS, LINES, thishw, thiskern);
+				profilestart(profile);
+				uisys(&wins.sys.win, wins.sys.height, &currentrow, COLS, LINES, data->hw, data->kern, data->hwdyn, data->kerndyn);
+				profilestop(profile, PROFILE_SYS);
 			}
 			if (wins.cpulong.visible) {
+				profilestart(profile);
 				if(pendingdata) {
-					tempvalue = cpulongitter * 3;
-					cpulongvals[tempvalue]   = (int)(round(thisres.avgpercentuser) / 10);
-					cpulongvals[tempvalue+1] = (int)(round(thisres.avgpercentsys) / 10);
-					cpulongvals[tempvalue+2] = (int)(round(thisres.avgpercentnice) / 10);
-
-					cpulongitter += 1;
-					if(cpulongitter > graphcols) {
-						cpulongitter = 0;
+					chartvalues[0] = data->res.avgpercentuser;
+					chartvalues[1] = data->res.avgpercentsys;
+					chartvalues[2] = data->res.avgpercentnice;
+					timeseriesappend(cpuseries, chartvalues);
+				}
+				if(sampler->rollup && (currentstate.resolution != ROLLUP_LIVE)) {
+					// one column per bucket, the cursor is after the newest
+					rollcolumns = (int)rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_CPUUSER, rollseries, (size_t)(graphcols - 1));
+					rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_CPUSYS, rollseries + MAXCOLS, (size_t)(graphcols - 1));
+					rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_CPUNICE, rollseries + (MAXCOLS * 2), (size_t)(graphcols - 1));
+					setrollchart(rollchart, rollseries, rollcolumns, 3);
+					rollupsummary(sampler->rollup, currentstate.resolution, (size_t)rollcolumns, ROLLUP_CPUUSER, &rollstat);
+					snprintf(cputitle, sizeof(cputitle), "CPU Load (%s, p99 user %.0f%%)", rollupname(currentstate.resolution), rollstat.p99);
+					uichart(&wins.cpulong.win, &wins.cpulong.damage, wins.cpulong.height, &currentrow, COLS, LINES, currentstate.color, rollchart, graphcols, UI_SCALE_PERCENT, cputitle);
+				} else {
+					if(timeserieswindowcount(cpuseries)) {
+						snprintf(cputitle, sizeof(cputitle), "CPU Load (avg user %.0f%%, max %.0f%%)", \
+							timeseriessum(cpuseries, 0) / timeserieswindowcount(cpuseries), timeseriesmax(cpuseries, 0));
+					} else {
+						snprintf(cputitle, sizeof(cputitle), "CPU Load");
 					}
+					uichart(&wins.cpulong.win, &wins.cpulong.damage, wins.cpulong.height, &currentrow, COLS, LINES, currentstate.color, cpuseries, graphcols, UI_SCALE_PERCENT, cputitle);
 				}
-				uicpulong(&wins.cpulong.win, wins.cpulong.height, &currentrow, COLS, LINES, cpulongitter, currentstate.color, cpulongvals, graphcols);
+				profilestop(profile, PROFILE_CPULONG);
 			}
 			if (wins.disklong.visible) {
+				profilestart(profile);
 				if(pendingdata) {
-					tempvalue = disklongitter * 2;
-					disklongvals[tempvalue]   = (unsigned int)(thisres.diskuser - thisres.diskuserlast);
-					disklongvals[tempvalue+1] = (unsigned int)(thisres.diskusew - thisres.diskusewlast);
-
-					disklongitter += 1;
-					if(disklongitter > graphcols) {
-						disklongitter = 0;
+					chartvalues[0] = collectorrate(data, COLLECT_PROC, data->res.diskuser - data->res.diskuserlast);
+					chartvalues[1] = collectorrate(data, COLLECT_PROC, data->res.diskusew - data->res.diskusewlast);
+					timeseriesappend(diskseries, chartvalues);
+				}
+				if(sampler->rollup && (currentstate.resolution != ROLLUP_LIVE)) {
+					rollcolumns = (int)rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_DISKREAD, rollseries, (size_t)(graphcols - 1));
+					rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_DISKWRITE, rollseries + MAXCOLS, (size_t)(graphcols - 1));
+					setrollchart(rollchart, rollseries, rollcolumns, 2);
+					rollupsummary(sampler->rollup, currentstate.resolution, (size_t)rollcolumns, ROLLUP_DISKREAD, &rollstat);
+					snprintf(disktitle, sizeof(disktitle), "Disk Usage (%s, p99 read %s/s)", rollupname(currentstate.resolution), \
+						uireadablebytes(rollbytes, (unsigned long long)rollstat.p99));
+					uichart(&wins.disklong.win, &wins.disklong.damage, wins.disklong.height, &currentrow, COLS, LINES, currentstate.color, rollchart, graphcols, UI_SCALE_LOG_BYTES, disktitle);
+				} else {
+					if(timeseriesmax(diskseries, 0) > 0) {
+						snprintf(disktitle, sizeof(disktitle), "Disk Usage (max read %s/s)", \
+							uireadablebytes(rollbytes, (unsigned long long)timeseriesmax(diskseries, 0)));
+					} else {
+						snprintf(disktitle, sizeof(disktitle), "Disk Usage");
 					}
+					uichart(&wins.disklong.win, &wins.disklong.damage, wins.disklong.height, &currentrow, COLS, LINES, currentstate.color, diskseries, graphcols, UI_SCALE_LOG_BYTES, disktitle);
 				}
-				uidisklong(&wins.disklong.win, wins.disklong.height, &currentrow, COLS, LINES, disklongitter, currentstate.color, disklongvals, graphcols);
+				profilestop(profile, PROFILE_DISKLONG);
 			}
 			if (wins.netlong.visible) {
+				profilestart(profile);
 				if(pendingdata) {
-					tempvalue = netlongitter * 2;
-					netlongvals[tempvalue]   = (thisnet.ibytes - thisnet.oldibytes);
-					netlongvals[tempvalue+1] = (thisnet.obytes - thisnet.oldobytes);
-
-					netlongitter += 1;
-					if(netlongitter > graphcols) {
-						netlongitter = 0;
+					chartvalues[0] = collectorrate(data, COLLECT_NET, data->net.ibytes - data->net.oldibytes);
+					chartvalues[1] = collectorrate(data, COLLECT_NET, data->net.obytes - data->net.oldobytes);
+					timeseriesappend(netseries, chartvalues);
+				}
+				if(sampler->rollup && (currentstate.resolution != ROLLUP_LIVE)) {
+					rollcolumns = (int)rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_NETIN, rollseries, (size_t)(graphcols - 1));
+					rollupseries(sampler->rollup, currentstate.resolution, ROLLUP_NETOUT, rollseries + MAXCOLS, (size_t)(graphcols - 1));
+					setrollchart(rollchart, rollseries, rollcolumns, 2);
+					rollupsummary(sampler->rollup, currentstate.resolution, (size_t)rollcolumns, ROLLUP_NETIN, &rollstat);
+					snprintf(nettitle, sizeof(nettitle), "Network Usage (%s, p99 in %s/s)", rollupname(currentstate.resolution), \
+						uireadablebytes(rollbytes, (unsigned long long)rollstat.p99));
+					uichart(&wins.netlong.win, &wins.netlong.damage, wins.netlong.height, &currentrow, COLS, LINES, currentstate.color, rollchart, graphcols, UI_SCALE_LOG_BYTES, nettitle);
+				} else {
+					if(timeseriesmax(netseries, 0) > 0) {
+						snprintf(nettitle, sizeof(nettitle), "Network Usage (max in %s/s)", \
+							uireadablebytes(rollbytes, (unsigned long long)timeseriesmax(netseries, 0)));
+					} else {
+						snprintf(nettitle, sizeof(nettitle), "Network Usage");
 					}
+					uichart(&wins.netlong.win, &wins.netlong.damage, wins.netlong.height, &currentrow, COLS, LINES, currentstate.color, netseries, graphcols, UI_SCALE_LOG_BYTES, nettitle);
 				}
-				uinetlong(&wins.netlong.win, wins.netlong.height, &currentrow, COLS, LINES, netlongitter, currentstate.color, netlongvals, graphcols);
+				profilestop(profile, PROFILE_NETLONG);
 			}
 			if (wins.cpu.visible) {
-				uicpu(&wins.cpu.win, wins.cpu.height, &currentrow, COLS, LINES, currentstate.color, thisres, show_raw);
+				profilestart(profile);
+				uicpu(&wins.cpu.win, &wins.cpu.damage, wins.cpu.height, &currentrow, COLS, LINES, currentstate.color, data->res, &data->burst, currentstate.peaks, show_raw);
+				profilestop(profile, PROFILE_CPU);
+			}
+			if (wins.cpumap.visible) {
+				profilestart(profile);
+				if(pendingdata) {
+					uicpumapsample(cpumap, data->res);
+				}
+				uicpumap(&wins.cpumap.win, wins.cpumap.height, &currentrow, COLS, LINES, currentstate.color, cpumap, data->res);
+				profilestop(profile, PROFILE_CPUMAP);
 			}
 			if (wins.gpu.visible) {
-				uigpu(&wins.gpu.win, wins.gpu.height, &currentrow, COLS, LINES, currentstate.color, (thisres.gpuuse - thisres.gpuuselast));
+				profilestart(profile);
+				uigpu(&wins.gpu.win, wins.gpu.height, &currentrow, COLS, LINES, currentstate.color, \
+					collectorrate(data, COLLECT_PROC, data->res.gpuuse - data->res.gpuuselast));
+				profilestop(profile, PROFILE_GPU);
 			}
 			if (wins.energy.visible) {
+				profilestart(profile);
 				uienergy(&wins.energy.win, wins.energy.height, &currentrow, COLS, LINES, currentstate.color, \
-					(unsigned int)(thisres.energyuser - thisres.energyuserlast), \
-					(unsigned int)(thisres.energysystem - thisres.energysystemlast));
+					(unsigned int)collectorrate(data, COLLECT_RES, data->res.energyuser - data->res.energyuserlast), \
+					(unsigned int)collectorrate(data, COLLECT_RES, data->res.energysystem - data->res.energysystemlast));
+				profilestop(profile, PROFILE_ENERGY);
 			}
 			if (wins.memory.visible) {
-				uimemory(&wins.memory.win, wins.memory.height, &currentrow, COLS, LINES, currentstate.color, thisres.memused, thishw.memorysize, sysvms);
+				profilestart(profile);
+				uimemory(&wins.memory.win, wins.memory.height, &currentrow, COLS, LINES, currentstate.color, data->res.memused, data->hw.memorysize, data->vms);
+				profilestop(profile, PROFILE_MEMORY);
 			}
 			if (wins.disks.visible) {
+				profilestart(profile);
 				uidisks(&wins.disks.win, wins.disks.height, &currentrow, COLS, LINES, currentstate.color, \
-					(unsigned int)(thisres.diskuser - thisres.diskuserlast), \
-					(unsigned int)(thisres.diskusew - thisres.diskusewlast));
+					(unsigned int)collectorrate(data, COLLECT_PROC, data->res.diskuser - data->res.diskuserlast), \
+					(unsigned int)collectorrate(data, COLLECT_PROC, data->res.diskusew - data->res.diskusewlast));
+				profilestop(profile, PROFILE_DISKS);
 			}
 			if (wins.diskgroup.visible) {
 				uidiskgroup(&wins.diskgroup.win, wins.diskgroup.height, &currentrow, COLS, LINES);
@@ -651,7 +1158,11 @@ int main(int argc, char **argv)
 				uinetfilesys(&wins.netfilesys.win, wins.netfilesys.height, &currentrow, COLS, LINES);
 			}
 			if (wins.network.visible) {
-				uinetwork(&wins.network.win, wins.network.height, &currentrow, COLS, LINES, currentstate.color, thisnet);
+				profilestart(profile);
+				uinetwork(&wins.network.win, wins.network.height, &currentrow, COLS, LINES, currentstate.color, \
+					(unsigned long)collectorrate(data, COLLECT_NET, data->net.ibytes - data->net.oldibytes), \
+					(unsigned long)collectorrate(data, COLLECT_NET, data->net.obytes - data->net.oldobytes), &data->burst);
+				profilestop(profile, PROFILE_NETWORK);
 				/*
 				int errors = 0;
 				for (int i = 0; i < networks; i++) {
@@ -669,12 +1180,26 @@ int main(int argc, char **argv)
 				*/
 			}
 			if (wins.top.visible) {
-				uitop(&wins.top.win, wins.top.height, &currentrow, COLS, LINES, currentstate.color, thisproc, \
-					(int)processcount, currentstate.topmode, pendingdata, currentstate.user);
+				profilestart(profile);
+				uitop(&wins.top.win, wins.top.height, &currentrow, COLS, LINES, currentstate.color, &data->procs, \
+					currentstate.topmode, pendingdata, currentstate.user);
+				// the processes shown (sorted first) are sampled every refresh
+				if(pendingdata) {
+					samplerpin(sampler, &data->procs, (size_t)uitoprows((int)data->procs.count, LINES));
+				}
+				profilestop(profile, PROFILE_TOP);
+			} else {
+				samplerpin(sampler, &data->procs, 0);
 			}
 			if (wins.warn.visible) {
 				uiwarn(&wins.warn.win, wins.warn.height, &currentrow, COLS, LINES);
 			}
+			// the profile pane shows the ticks before this one
+			if (wins.profile.visible) {
+				profilestart(profile);
+				uiprofile(&wins.profile.win, wins.profile.height, &currentrow, COLS, LINES, currentstate.color, profile);
+				profilestop(profile, PROFILE_PROFILE);
+			}
 
 
 			// underline the end of the stats area border
@@ -682,7 +1207,19 @@ int main(int argc, char **argv)
 				mvwhline(stdscr, currentrow+1, 1, ACS_HLINE, COLS-2);
 			}
 			// commit screen updates
+			profilestart(profile);
 			doupdate();
+			profilestop(profile, PROFILE_OUTPUT);
+			framepadcells = uipadcells;
+			uipadcells = 0;
+			if(pendingdata) {
+				profiletick(profile, data);
+			}
+
+			// stop after the requested number of samples (-c)
+			if(pendingdata && currentstate.count && (++samplesshown >= currentstate.count)) {
+				break;
+			}
 
 			// all data changes posted by here
 			pendingdata = false;
@@ -690,28 +1227,67 @@ int main(int argc, char **argv)
 			pressedkey = 0;
 		}
 
-		// handle input
-		pressedkey = getch();
-		if(pressedkey) {
-			if(pressedkey != ERR) {
-				// update app state
-				if(!setwinstate(&wins, &currentstate, pressedkey)) {
-					pressedkey = 0;
+		// handle input (curses may have read several keys ahead of poll())
+		waitforinput(sampler, keyboard);
+		while((key = getch()) != ERR) {
+			// playback keys, the rest update app state
+			if(replay && ((key == ' ') || (key == '.') || (key == '<') || (key == '>') || (key == '/'))) {
+				if(key == ' ') {
+					replaypause(replay);
+				} else if(key == '.') {
+					replaystep(replay);
+				} else if(key == '/') {
+					// read the time to seek to on the bottom line
+					mvwhline(stdscr, LINES-1, 1, ' ', COLS-2);
+					mvprintw(LINES-1, 2, "seek to (+/-seconds, HH:MM:SS or YYYY-MM-DD HH:MM:SS): ");
+					echo();
+					curs_set(1);
+					timeout(-1);
+					getnstr(seekto, sizeof(seekto) - 1);
+					timeout(0);
+					curs_set(0);
+					noecho();
+					mvwhline(stdscr, LINES-1, 0, ACS_HLINE, COLS);
+					replayseek(replay, seekto);
+				} else {
+					replayspeed(replay, key == '>');
 				}
+				pressedkey = key;
+			} else if(setwinstate(&wins, &currentstate, key)) {
+				pressedkey = key;
+			}
 
-				// un-underline the end of the stats area border
-				if((currentrow > 0) && (currentrow < LINES-2)) {
-					mvwhline(stdscr, currentrow+1, 1, ' ', COLS-2);
-				}
-			} else {
-				pressedkey = 0;
+			// un-underline the end of the stats area border
+			if((currentrow > 0) && (currentrow < LINES-2)) {
+				mvwhline(stdscr, currentrow+1, 1, ' ', COLS-2);
 			}
 		}
 
 		// handle app state changes
 		if(currentstate.pendingchanges) {
-			timeout(currentstate.refreshms);
+			samplerrefresh(sampler, currentstate.refreshms);
 			currentstate.pendingchanges = false;
 		}
 	}
+
+	// the threads are stopped before the profile they count into is read
+	replayfree(replay);
+	samplerfree(sampler);
+	nocbreak();
+	endwin();
+	if(currentstate.debug) {
+		dumpprofile(profile, getenv("NMONDEBUG"));
+	}
+	profilefree(profile);
+	uidamagefree(&wins.cpu.damage);
+	uidamagefree(&wins.cpulong.damage);
+	uidamagefree(&wins.disklong.damage);
+	uidamagefree(&wins.netlong.damage);
+	uicpumapfree(cpumap);
+	timeseriesfree(cpuseries);
+	timeseriesfree(diskseries);
+	timeseriesfree(netseries);
+	timeseriesfree(rollchart);
+	free(rollseries);
+	return 0;
 }
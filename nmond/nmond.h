@@ -44,30 +44,49 @@
  */
 
 #include <stdbool.h>
+#include "rollup.h"
 
-#define MINIMUM_REFRESH_RATE 1
+// shortest time between samples (milliseconds)
+#define MINIMUM_REFRESH_MS 100
+// longest the + key goes to (milliseconds, -s may ask for more)
+#define MAXIMUM_REFRESH_MS 60000
 
 struct nmondstate {
 	int color;
 	int height;
 
-	int refresh;
-	int refreshms;
+	int refreshms; // time between samples (-s)
+	int count; // samples before exiting, 0 for no limit (-c)
 
 	int neterrors;
 
-	double timenow;
-	double timelast;
-	double elapsed;
-
 	int rowoffset;
 	int topmode;
 
+	int workers; // threads sampling processes (-w)
+	int budget; // processes sampled per refresh, 0 for no limit (-n)
+	int bursthz; // cheap counters sampled per second, 0 for off (-z)
+	int resolution; // of the long graphs, ROLLUP_LIVE or a roll-up level (l key)
+	int metricstop; // busiest processes served to scrapers (-p)
+
 	bool pendingchanges;
+	bool reloadfacts;
+	bool quit; // q key, the main loop exits
 	bool debug;
+	bool batch; // no terminal, records are written to stdout (-B)
+	bool peaks; // burst peak markers on the CPU bars
+	bool xport; // nmon spreadsheet files instead of the screen (-f)
+	bool xporttop; // with the busiest processes (-t)
 
+	char *recordpath; // file the samples are recorded to (-o)
+	char *replaypath; // recording played back instead of sampling (-P)
+	char *rolluppath; // file the long-term summaries are kept in (-R)
+	char *metricsaddress; // port or socket OpenMetrics are served on (-M)
+	char *xportpath; // the one spreadsheet file, instead of one a day (-F)
+	char *xportdir; // directory the spreadsheet files are written to (-m)
+	char *runname; // in the spreadsheet files, the host name by default (-r)
 	char *user;
 };
-#define NMONDSTATE_INIT { 0, 0, 2, 2000, 0, 0.0, 0.0, 0.0, 0, 0, false, false, NULL }
+#define NMONDSTATE_INIT { 0, 0, 2000, 0, 0, 0, 0, 1, 0, 0, ROLLUP_LIVE, 0, false, false, false, false, false, false, false, false, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
 
 #endif
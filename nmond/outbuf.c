@@ -0,0 +1,204 @@
+/**
+ * outbuf.c -- reusable buffer for formatted output
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "outbuf.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+bool outbufinit(struct outbuf *buf, int fd, size_t capacity)
+{
+	buf->fd = fd;
+	buf->length = 0;
+	buf->failed = false;
+	buf->capacity = capacity ? capacity : 1024;
+	buf->data = (char *)malloc(buf->capacity);
+	if(buf->data == NULL) {
+		// TODO: handle memory allocation failure
+		buf->capacity = 0;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Make room for more bytes, the buffer only grows (records are alike,
+ *  so after the first few it has its final size)
+ */
+static bool outbufreserve(struct outbuf *buf, size_t more)
+{
+	if((buf->length + more) <= buf->capacity) {
+		return true;
+	}
+
+	size_t capacity = buf->capacity ? buf->capacity : 1024;
+	while(capacity < (buf->length + more)) {
+		capacity *= 2;
+	}
+	char *data = (char *)realloc(buf->data, capacity);
+	if(data == NULL) {
+		// TODO: handle memory allocation failure
+		return false;
+	}
+	buf->data = data;
+	buf->capacity = capacity;
+	return true;
+}
+
+void outbufbytes(struct outbuf *buf, const void *bytes, size_t length)
+{
+	if(outbufreserve(buf, length)) {
+		memcpy(buf->data + buf->length, bytes, length);
+		buf->length += length;
+	}
+}
+
+void outbufstring(struct outbuf *buf, const char *string)
+{
+	outbufbytes(buf, string, strlen(string));
+}
+
+void outbufchar(struct outbuf *buf, char character)
+{
+	if(outbufreserve(buf, 1)) {
+		buf->data[buf->length++] = character;
+	}
+}
+
+void outbufuint(struct outbuf *buf, unsigned long long value)
+{
+	// digits come out backwards, 20 is enough for 2^64
+	char digits[20];
+	int count = 0;
+	do {
+		digits[count++] = (char)('0' + (value % 10));
+		value /= 10;
+	} while(value);
+
+	if(outbufreserve(buf, (size_t)count)) {
+		while(count) {
+			buf->data[buf->length++] = digits[--count];
+		}
+	}
+}
+
+void outbufint(struct outbuf *buf, long long value)
+{
+	if(value < 0) {
+		outbufchar(buf, '-');
+		outbufuint(buf, (unsigned long long)(-(value + 1)) + 1);
+	} else {
+		outbufuint(buf, (unsigned long long)value);
+	}
+}
+
+/*
+ * Append a number with a fixed count of decimals (at most 6), rounded
+ */
+void outbuffixed(struct outbuf *buf, double value, int decimals)
+{
+	static const unsigned long long scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+	if(decimals < 0) {
+		decimals = 0;
+	}
+	if(decimals > 6) {
+		decimals = 6;
+	}
+
+	if(isnan(value) || isinf(value)) {
+		outbufchar(buf, '0');
+		return;
+	}
+	if(value < 0) {
+		outbufchar(buf, '-');
+		value = -value;
+	}
+
+	// the whole part is split off first (exactly), so that scaling the
+	//  fraction does not lose digits of large values
+	double whole = floor(value);
+	unsigned long long integer = (unsigned long long)whole;
+	unsigned long long fraction = (unsigned long long)llround((value - whole) * (double)scales[decimals]);
+	if(fraction >= scales[decimals]) {
+		integer += 1;
+		fraction -= scales[decimals];
+	}
+	outbufuint(buf, integer);
+	if(decimals) {
+		if(outbufreserve(buf, (size_t)decimals + 1)) {
+			buf->data[buf->length++] = '.';
+			for (int i = decimals - 1; i >= 0; --i) {
+				buf->data[buf->length + (size_t)i] = (char)('0' + (fraction % 10));
+				fraction /= 10;
+			}
+			buf->length += (size_t)decimals;
+		}
+	}
+}
+
+/*
+ * Write out the buffer (all of it, retrying partial writes) and empty it
+ */
+bool outbufflush(struct outbuf *buf)
+{
+	size_t written = 0;
+	ssize_t result = 0;
+
+	while(!buf->failed && (written < buf->length)) {
+		result = write(buf->fd, buf->data + written, buf->length - written);
+		if(result < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			buf->failed = true;
+			break;
+		}
+		written += (size_t)result;
+	}
+	buf->length = 0;
+	return !buf->failed;
+}
+
+void outbuffree(struct outbuf *buf)
+{
+	free(buf->data);
+	buf->data = NULL;
+	buf->length = 0;
+	buf->capacity = 0;
+}
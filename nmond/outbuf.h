@@ -0,0 +1,65 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/**
+ * outbuf.h -- reusable buffer for formatted output
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fields are formatted straight into one buffer which is written out with
+// a single write() per record, it is allocated once and then reused.
+struct outbuf {
+	int fd;
+	char *data;
+	size_t length;
+	size_t capacity;
+	bool failed; // a write failed (the reader went away), nothing more is written
+};
+#define OUTBUF_INIT { -1, NULL, 0, 0, false }
+
+extern bool outbufinit(struct outbuf*, int, size_t);
+extern void outbufbytes(struct outbuf*, const void*, size_t);
+extern void outbufstring(struct outbuf*, const char*);
+extern void outbufchar(struct outbuf*, char);
+extern void outbufuint(struct outbuf*, unsigned long long);
+extern void outbufint(struct outbuf*, long long);
+extern void outbuffixed(struct outbuf*, double, int);
+extern bool outbufflush(struct outbuf*);
+extern void outbuffree(struct outbuf*);
+
+#endif
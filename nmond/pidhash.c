@@ -38,92 +38,177 @@
 #include "pidhash.h"
 #include <stdlib.h>
 
-static int hash(int value)
+/*
+ * Mix the bits of a PID so sequential and strided PIDs spread out
+ *  (the finalizer from MurmurHash3)
+ */
+static inline size_t hash(int key)
+{
+	unsigned int value = (unsigned int)key;
+	value ^= value >> 16;
+	value *= 0x85ebca6b;
+	value ^= value >> 13;
+	value *= 0xc2b2ae35;
+	value ^= value >> 16;
+	return (size_t)value;
+}
+
+/*
+ * Find the slot holding key, or the empty slot where it would go
+ */
+static inline size_t hashtfind(struct hashtable *hashtable, int key)
 {
-	// PIDs 0 - 999
-	if(value < HASH_TABLE_SIZE) {
-		return value;
+	size_t index = hash(key) & hashtable->mask;
+	while(hashtable->items[index].valoc && (hashtable->items[index].key != key)) {
+		index = (index + 1) & hashtable->mask;
 	}
+	return index;
+}
 
-	// PIDs 1,000 - infinity
-	while(value >= HASH_TABLE_SIZE) {
-		if(value < HASH_TABLE_SIZE_X10) {
-			value = value - HASH_TABLE_SIZE;
-		// PIDs 10,000 - infinity
-		} else {
-			if(value < HASH_TABLE_SIZE_X100) {
-				value = value - HASH_TABLE_SIZE_X10;
-			// PIDs 100,000 - infinity
-			} else {
-				value = value - HASH_TABLE_SIZE_X100;
-			}
+/*
+ * Move every item into a newly allocated table of the given size
+ */
+static void hashtresize(struct hashtable *hashtable, size_t size)
+{
+	struct hashitem *newitems = (struct hashitem *)calloc(size, sizeof(struct hashitem));
+	if(newitems == NULL) {
+		// TODO: handle memory allocation failure
+		return;
+	}
+
+	struct hashitem *olditems = hashtable->items;
+	size_t oldsize = hashtable->size;
+	hashtable->items = newitems;
+	hashtable->size = size;
+	hashtable->mask = size - 1;
+
+	for (size_t i = 0; i < oldsize; ++i) {
+		if(olditems[i].valoc) {
+			hashtable->items[hashtfind(hashtable, olditems[i].key)] = olditems[i];
 		}
 	}
-	return value;
+	free(olditems);
+}
+
+struct hashtable *hashtnew()
+{
+	struct hashtable *hashtable = (struct hashtable *)malloc(sizeof(struct hashtable));
+	if(hashtable == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+
+	hashtable->size = HASH_TABLE_MIN_SIZE;
+	hashtable->mask = HASH_TABLE_MIN_SIZE - 1;
+	hashtable->count = 0;
+	hashtable->items = (struct hashitem *)calloc(HASH_TABLE_MIN_SIZE, sizeof(struct hashitem));
+	if(hashtable->items == NULL) {
+		// TODO: handle memory allocation failure
+		free(hashtable);
+		return NULL;
+	}
+	return hashtable;
+}
+
+void hashtfree(struct hashtable *hashtable)
+{
+	if(hashtable) {
+		free(hashtable->items);
+		free(hashtable);
+	}
 }
 
-struct hashitem *hashtnew()
+/*
+ * Add a key to the table (an existing key has its value replaced)
+ */
+void hashtadd(struct hashtable *hashtable, int key, void *valoc)
 {
-	return (struct hashitem *)calloc(sizeof(struct hashitem), HASH_TABLE_SIZE);
+	hashtset(hashtable, key, valoc);
 }
 
-void hashtadd(struct hashitem *hashtable, int key, void *valoc)
+/*
+ * Insert or replace the value for a key (a NULL value removes the key)
+ */
+void hashtset(struct hashtable *hashtable, int key, void *valoc)
 {
-	struct hashitem *thishashitem = (struct hashitem *)malloc(sizeof(struct hashitem));
-	thishashitem->next = NULL;
-	thishashitem->keyhash = hash(key);
-	thishashitem->key = key;
-	thishashitem->valoc = valoc;
-
-	struct hashitem *hitem = &hashtable[thishashitem->keyhash];
-	// go to the last linked list item
-	while(hitem->next) {
-		hitem = hitem->next;
+	if(valoc == NULL) {
+		hashtdel(hashtable, key);
+		return;
+	}
+
+	size_t index = hashtfind(hashtable, key);
+	if(hashtable->items[index].valoc) {
+		hashtable->items[index].valoc = valoc;
+		return;
 	}
-	// this linked list item is already assigned
-	if(hitem->valoc) {
-		hitem->next = thishashitem;
-	// the head of the linked list
-	} else {
-		hashtable[thishashitem->keyhash] = *thishashitem;
+
+	if(((hashtable->count + 1) * HASH_TABLE_GROW_DEN) > (hashtable->size * HASH_TABLE_GROW_NUM)) {
+		hashtresize(hashtable, hashtable->size * 2);
+		// the table could not grow, never fill the last slot (lookups would not end)
+		if((hashtable->count + 1) >= hashtable->size) {
+			return;
+		}
+		index = hashtfind(hashtable, key);
 	}
+
+	hashtable->items[index].key = key;
+	hashtable->items[index].valoc = valoc;
+	hashtable->count += 1;
 }
 
-void hashtset(struct hashitem *hashtable, int key, void *valoc)
+void *hashtget(struct hashtable *hashtable, int key)
 {
-	int keyhash = hash(key);
-
-	struct hashitem *hitem = &hashtable[keyhash];
-	if(hitem->key != key) {
-		while(hitem->next) {
-			hitem = hitem->next;
-			if(hitem->key == key) {
-				hitem->valoc = valoc;
-				break;
-			}
+	return hashtable->items[hashtfind(hashtable, key)].valoc;
+}
+
+/*
+ * Remove a key, returning its value (or NULL when it was not found)
+ */
+void *hashtdel(struct hashtable *hashtable, int key)
+{
+	size_t index = hashtfind(hashtable, key);
+	void *result = hashtable->items[index].valoc;
+	if(result == NULL) {
+		return NULL;
+	}
+
+	// shift following items of the probe run back into the hole,
+	// unless doing so would move them before their home slot
+	size_t hole = index;
+	size_t next = (index + 1) & hashtable->mask;
+	while(hashtable->items[next].valoc) {
+		size_t home = hash(hashtable->items[next].key) & hashtable->mask;
+		if(((next - home) & hashtable->mask) >= ((next - hole) & hashtable->mask)) {
+			hashtable->items[hole] = hashtable->items[next];
+			hole = next;
 		}
-		// automatically jump to add it when not found
-		hashtadd(hashtable, key, valoc);
-	} else {
-		hitem->valoc = valoc;
+		next = (next + 1) & hashtable->mask;
+	}
+	hashtable->items[hole].key = 0;
+	hashtable->items[hole].valoc = NULL;
+	hashtable->count -= 1;
+
+	if((hashtable->size > HASH_TABLE_MIN_SIZE) && ((hashtable->count * HASH_TABLE_SHRINK_DEN) < hashtable->size)) {
+		hashtresize(hashtable, hashtable->size / 2);
 	}
+	return result;
 }
 
-void *hashtget(struct hashitem *hashtable, int key)
+/*
+ * Iterate over the table, start with *iter = 0, returns NULL when done
+ *  (the table must not be changed while iterating)
+ */
+void *hashtnext(struct hashtable *hashtable, size_t *iter, int *key)
 {
-	int keyhash = hash(key);
-
-	struct hashitem *hitem = &hashtable[keyhash];
-	if(hitem->key != key) {
-		while(hitem->next) {
-			hitem = hitem->next;
-			if(hitem->key == key) {
-				break;
+	while(*iter < hashtable->size) {
+		struct hashitem *hitem = &hashtable->items[*iter];
+		*iter += 1;
+		if(hitem->valoc) {
+			if(key) {
+				*key = hitem->key;
 			}
-		}
-		if(hitem->key != key) {
-			return NULL;
+			return hitem->valoc;
 		}
 	}
-	return hitem->valoc;
+	return NULL;
 }
@@ -38,23 +38,36 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-// you cannot change this without modifing the hashing algorithm
-#define HASH_TABLE_MIN 0
-#define HASH_TABLE_MAX 999
-#define HASH_TABLE_SIZE 1000
-#define HASH_TABLE_SIZE_X10 10000
-#define HASH_TABLE_SIZE_X100 100000
+#include <stddef.h>
 
+// table sizes must be a power of two (the hash is masked, not divided)
+#define HASH_TABLE_MIN_SIZE 256
+// grow past 3/4 full, shrink below 1/8 full
+#define HASH_TABLE_GROW_NUM 3
+#define HASH_TABLE_GROW_DEN 4
+#define HASH_TABLE_SHRINK_DEN 8
+
+// a slot is empty when valoc is NULL (NULL values cannot be stored)
 struct hashitem {
 	int key;
-	int keyhash;
 	void *valoc;
-	struct hashitem *next;
 };
 
-extern struct hashitem *hashtnew(void);
-extern void hashtadd(struct hashitem*, int, void*);
-extern void hashtset(struct hashitem*, int, void*);
-extern void *hashtget(struct hashitem*, int);
+// open addressing with linear probing, deletion shifts items back
+// so there are no tombstones and probe lengths stay short
+struct hashtable {
+	size_t size;
+	size_t mask;
+	size_t count;
+	struct hashitem *items;
+};
+
+extern struct hashtable *hashtnew(void);
+extern void hashtfree(struct hashtable*);
+extern void hashtadd(struct hashtable*, int, void*);
+extern void hashtset(struct hashtable*, int, void*);
+extern void *hashtget(struct hashtable*, int);
+extern void *hashtdel(struct hashtable*, int);
+extern void *hashtnext(struct hashtable*, size_t*, int*);
 
 #endif
@@ -0,0 +1,131 @@
+/**
+ * procargs.c -- Format process arguments for display
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "procargs.h"
+#include <string.h>
+
+/*
+ * Reverse characters in place (used to rotate the result ring)
+ */
+static void procargsreverse(char *string, size_t begin, size_t end)
+{
+	char temp = 0;
+	while((begin + 1) < end) {
+		--end;
+		temp = string[begin];
+		string[begin] = string[end];
+		string[end] = temp;
+		++begin;
+	}
+}
+
+/*
+ * Format the arguments in a KERN_PROCARGS2 buffer as one display string
+ *
+ * The buffer holds argc (int), the executable path, NUL padding, then
+ *  argc NUL terminated arguments (followed by the environment). The
+ *  arguments are joined with spaces; when that does not fit in
+ *  resultsize - 1 characters the tail is kept behind a "..." prefix.
+ *
+ * Single pass and no state outside the arguments (safe to call from
+ *  any thread), the buffer is never read past length. Returns the
+ *  length of the string written to result.
+ */
+size_t procargsformat(const char *args, size_t length, char *result, size_t resultsize)
+{
+	if(resultsize == 0) {
+		return 0;
+	}
+	result[0] = '\0';
+	if((resultsize <= (PROCARGS_TRUNC_LENGTH + 1)) || (length < sizeof(int))) {
+		return 0;
+	}
+
+	int argc = 0;
+	memcpy(&argc, args, sizeof(int));
+	size_t pos = sizeof(int);
+
+	// skip the executable path and the padding after it
+	while((pos < length) && (args[pos] != '\0')) {
+		++pos;
+	}
+	while((pos < length) && (args[pos] == '\0')) {
+		++pos;
+	}
+
+	// result is used as a ring until we know whether everything fits
+	size_t capacity = resultsize - 1;
+	size_t ringpos = 0;
+	size_t written = 0;
+	for (int argno = 0; (argno < argc) && (pos < length); ++argno) {
+		// empty arguments are skipped (as is their separator)
+		if(args[pos] == '\0') {
+			++pos;
+			continue;
+		}
+
+		if(written) {
+			result[ringpos] = ' ';
+			++written;
+			if(++ringpos == capacity) {
+				ringpos = 0;
+			}
+		}
+		while((pos < length) && (args[pos] != '\0')) {
+			result[ringpos] = args[pos];
+			++written;
+			if(++ringpos == capacity) {
+				ringpos = 0;
+			}
+			++pos;
+		}
+		++pos;
+	}
+
+	if(written <= capacity) {
+		result[written] = '\0';
+		return written;
+	}
+
+	// rotate the oldest character to the front, then mark the truncation
+	procargsreverse(result, 0, ringpos);
+	procargsreverse(result, ringpos, capacity);
+	procargsreverse(result, 0, capacity);
+	memset(result, PROCARGS_TRUNC_CHAR, PROCARGS_TRUNC_LENGTH);
+	result[capacity] = '\0';
+	return capacity;
+}
@@ -0,0 +1,239 @@
+/**
+ * profile.c -- Timings and counts of nmond itself, per tick
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "profile.h"
+#include <math.h>
+#include <stdlib.h>
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+
+// the panes, as numbered in profile.h
+static char *profilepanes[] = {
+	"welcome", "help", "sys", "cpulong", "disklong", "netlong", "cpu", "cpumap",
+	"gpu", "energy", "memory", "disks", "network", "top", "profile"
+};
+
+static char *profileothers[] = {
+	"output", "frame", "syscalls", "heap blocks", "heap bytes", "evictions",
+	"uid hit %"
+};
+
+struct profile *profilenew()
+{
+	struct profile *profile = (struct profile *)calloc(1, sizeof(struct profile));
+	if(profile == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	profile->ticks = timeseriesnew(PROFILE_CHANNELS, PROFILE_TICKS);
+	if(profile->ticks == NULL) {
+		// TODO: handle memory allocation failure
+		free(profile);
+		return NULL;
+	}
+	return profile;
+}
+
+/*
+ * The name of a measure (collectors are named as in collector.c)
+ */
+char *profilename(int channel)
+{
+	if(channel < COLLECTOR_COUNT) {
+		return collectorsget()[channel].name;
+	}
+	if(channel < PROFILE_OUTPUT) {
+		return profilepanes[channel - COLLECTOR_COUNT];
+	}
+	return profileothers[channel - PROFILE_OUTPUT];
+}
+
+/*
+ * Start measuring a frame, the panes drawn are timed from here
+ */
+void profileframe(struct profile *profile)
+{
+	for (int i = 0; i < PROFILE_CHANNELS; ++i) {
+		profile->current[i] = 0;
+	}
+	profile->framestarted = collectorclock();
+}
+
+void profilestart(struct profile *profile)
+{
+	profile->started = collectorclock();
+}
+
+/*
+ * Add the time since profilestart to a measure of this frame
+ */
+void profilestop(struct profile *profile, int channel)
+{
+	profile->current[channel] += (double)(collectorclock() - profile->started);
+}
+
+/*
+ * System calls made by the process so far, and the heap blocks and bytes
+ *  in use now
+ */
+static void profilecounts(unsigned long long *syscalls, unsigned long long *heapblocks, unsigned long long *heapbytes)
+{
+	task_events_info_data_t events;
+	mach_msg_type_number_t count = TASK_EVENTS_INFO_COUNT;
+	*syscalls = 0;
+	if(task_info(mach_task_self(), TASK_EVENTS_INFO, (task_info_t)&events, &count) == KERN_SUCCESS) {
+		*syscalls = (unsigned int)events.syscalls_unix + (unsigned long long)(unsigned int)events.syscalls_mach;
+	}
+
+	malloc_statistics_t heap;
+	malloc_zone_statistics(NULL, &heap);
+	*heapblocks = heap.blocks_in_use;
+	*heapbytes = heap.size_in_use;
+}
+
+/*
+ * End a frame drawn for a new sample, it takes the collector times of
+ *  that sample and the counts since the last tick (frames drawn for a
+ *  key press only are not ticks, their times are dropped)
+ */
+void profiletick(struct profile *profile, struct sysdata *data)
+{
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		profile->current[i] = (double)data->collectns[i];
+	}
+	profile->current[PROFILE_FRAME] = (double)(collectorclock() - profile->framestarted);
+
+	unsigned long long syscalls = 0;
+	unsigned long long heapblocks = 0;
+	unsigned long long heapbytes = 0;
+	profilecounts(&syscalls, &heapblocks, &heapbytes);
+	if(profile->counted) {
+		profile->current[PROFILE_SYSCALLS] = (double)(syscalls - profile->syscalls);
+		profile->current[PROFILE_HEAPBLOCKS] = (double)heapblocks - (double)profile->heapblocks;
+		profile->current[PROFILE_HEAPBYTES] = (double)heapbytes - (double)profile->heapbytes;
+	}
+	profile->counted = true;
+	profile->syscalls = syscalls;
+	profile->heapblocks = heapblocks;
+	profile->heapbytes = heapbytes;
+
+	// records of exited processes reclaimed by the last process walk, a
+	// sample without a walk repeats it rather than counting none
+	if(data->collected & COLLECT_PROC) {
+		profile->evictions = data->proccache.evictions;
+	}
+	profile->current[PROFILE_EVICTIONS] = (double)profile->evictions;
+	profile->current[PROFILE_UIDHITS] = uidcachehitrate(&data->proccache.uids);
+
+	timeseriesappend(profile->ticks, profile->current);
+}
+
+/*
+ * A measure of the last tick
+ */
+double profilelast(struct profile *profile, int channel)
+{
+	if(!profile->ticks->count) {
+		return 0;
+	}
+	return timeseriesvalue(profile->ticks, profile->ticks->count - 1, channel);
+}
+
+static int profilecompare(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * A percentile of a measure over the last PROFILE_TICKS ticks (the
+ *  nearest rank, as burst.c does)
+ */
+double profilepercentile(struct profile *profile, int channel, double percent)
+{
+	struct timeseries *ticks = profile->ticks;
+	size_t count = timeserieswindowcount(ticks);
+	if(!count) {
+		return 0;
+	}
+
+	double values[PROFILE_TICKS];
+	for (size_t i = 0; i < count; ++i) {
+		values[i] = timeseriesvalue(ticks, ticks->count - count + i, channel);
+	}
+	qsort(values, count, sizeof(double), profilecompare);
+
+	size_t rank = (size_t)ceil((percent / 100.0) * (double)count);
+	if(rank < 1) {
+		rank = 1;
+	}
+	return values[rank - 1];
+}
+
+/*
+ * Write the measures over the last ticks as JSON (times in ns)
+ */
+void profiledump(struct profile *profile, FILE *out)
+{
+	struct timeseries *ticks = profile->ticks;
+	size_t count = timeserieswindowcount(ticks);
+
+	fprintf(out, "{\"ticks\":%llu,\"window\":%zu,\"measures\":[", ticks->count, count);
+	for (int i = 0; i < PROFILE_CHANNELS; ++i) {
+		fprintf(out, "%s\n {\"name\":\"%s\",\"kind\":\"%s\",\"unit\":\"%s\",\"last\":%.0f,\"mean\":%.0f,\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f}",
+			i ? "," : "",
+			profilename(i),
+			(i < COLLECTOR_COUNT) ? "collector" : ((i < PROFILE_OUTPUT) ? "pane" : ((i < PROFILE_COUNTS) ? "frame" : "process")),
+			(i < PROFILE_COUNTS) ? "ns" : (i == PROFILE_HEAPBYTES ? "bytes" : (i == PROFILE_UIDHITS ? "percent" : "count")),
+			profilelast(profile, i),
+			count ? (timeseriessum(ticks, i) / (double)count) : 0,
+			profilepercentile(profile, i, 50),
+			profilepercentile(profile, i, 99),
+			timeseriesmax(ticks, i));
+	}
+	fprintf(out, "\n]}\n");
+}
+
+void profilefree(struct profile *profile)
+{
+	if(profile == NULL) {
+		return;
+	}
+	timeseriesfree(profile->ticks);
+	free(profile);
+}
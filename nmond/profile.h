@@ -0,0 +1,106 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/**
+ * profile.h -- Timings and counts of nmond itself, per tick
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "collector.h"
+#include "timeseries.h"
+
+// ticks (frames drawn for a new sample) the percentiles are over
+#define PROFILE_TICKS 128
+
+// what is measured each tick, a channel each: the collectors (in the
+// order of collector.c) and the panes (ns), the output and the whole
+// frame (ns), then the system calls made, the change in the number
+// and size of heap blocks in use, the process records evicted by the
+// last process walk (carried over the ticks without one, so it is not
+// diluted by them) and the percent of user names found in the uid cache
+#define PROFILE_WELCOME (COLLECTOR_COUNT + 0)
+#define PROFILE_HELP (COLLECTOR_COUNT + 1)
+#define PROFILE_SYS (COLLECTOR_COUNT + 2)
+#define PROFILE_CPULONG (COLLECTOR_COUNT + 3)
+#define PROFILE_DISKLONG (COLLECTOR_COUNT + 4)
+#define PROFILE_NETLONG (COLLECTOR_COUNT + 5)
+#define PROFILE_CPU (COLLECTOR_COUNT + 6)
+#define PROFILE_CPUMAP (COLLECTOR_COUNT + 7)
+#define PROFILE_GPU (COLLECTOR_COUNT + 8)
+#define PROFILE_ENERGY (COLLECTOR_COUNT + 9)
+#define PROFILE_MEMORY (COLLECTOR_COUNT + 10)
+#define PROFILE_DISKS (COLLECTOR_COUNT + 11)
+#define PROFILE_NETWORK (COLLECTOR_COUNT + 12)
+#define PROFILE_TOP (COLLECTOR_COUNT + 13)
+#define PROFILE_PROFILE (COLLECTOR_COUNT + 14)
+#define PROFILE_OUTPUT (COLLECTOR_COUNT + 15)
+#define PROFILE_FRAME (COLLECTOR_COUNT + 16)
+#define PROFILE_SYSCALLS (COLLECTOR_COUNT + 17)
+#define PROFILE_HEAPBLOCKS (COLLECTOR_COUNT + 18)
+#define PROFILE_HEAPBYTES (COLLECTOR_COUNT + 19)
+#define PROFILE_EVICTIONS (COLLECTOR_COUNT + 20)
+#define PROFILE_UIDHITS (COLLECTOR_COUNT + 21)
+#define PROFILE_CHANNELS (COLLECTOR_COUNT + 22)
+// channels before this one are times
+#define PROFILE_COUNTS PROFILE_SYSCALLS
+
+struct profile {
+	struct timeseries *ticks; // a channel per measure
+	double current[PROFILE_CHANNELS]; // the tick being measured
+	unsigned long long framestarted; // monotonic clock (ns)
+	unsigned long long started; // of the pane being timed
+
+	// the process as a whole at the last tick
+	bool counted;
+	unsigned long long syscalls;
+	unsigned long long heapblocks;
+	unsigned long long heapbytes;
+	unsigned long long evictions; // by the last process walk
+};
+
+extern struct profile *profilenew(void);
+extern char *profilename(int);
+extern void profileframe(struct profile*);
+extern void profilestart(struct profile*);
+extern void profilestop(struct profile*, int);
+extern void profiletick(struct profile*, struct sysdata*);
+extern double profilelast(struct profile*, int);
+extern double profilepercentile(struct profile*, int, double);
+extern void profiledump(struct profile*, FILE*);
+extern void profilefree(struct profile*);
+
+#endif
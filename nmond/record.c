@@ -0,0 +1,409 @@
+/**
+ * record.c -- binary recordings of the samples
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "record.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void recordstring(char *to, size_t size, const char *from)
+{
+	memset(to, 0, size);
+	if(from) {
+		strncpy(to, from, size - 1);
+	}
+}
+
+static uint64_t recordclock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+static void recordheaderfill(struct recordheader *header, struct sysdata *data, int intervalms)
+{
+	memset(header, 0, sizeof(struct recordheader));
+	memcpy(header->magic, RECORD_MAGIC, sizeof(header->magic));
+	header->version = RECORD_VERSION;
+	header->byteorder = RECORD_BYTEORDER;
+	header->headersize = sizeof(struct recordheader);
+	header->ticksize = sizeof(struct recordtick);
+	header->cpusize = sizeof(struct recordcpu);
+	header->procsize = sizeof(struct recordproc);
+	header->cpucount = (uint32_t)data->res.cpucount;
+	header->intervalms = (uint32_t)intervalms;
+	header->started = recordclock();
+	header->memorysize = data->hw.memorysize;
+	header->boottime = (uint64_t)data->kern.boottime.tv_sec;
+	recordstring(header->hostname, sizeof(header->hostname), data->kern.hostname);
+	recordstring(header->model, sizeof(header->model), data->hw.model);
+	recordstring(header->cpubrand, sizeof(header->cpubrand), data->hw.cpubrand);
+	recordstring(header->osrelease, sizeof(header->osrelease), data->kern.osrelease);
+	recordstring(header->osversion, sizeof(header->osversion), data->kern.osversion);
+}
+
+/*
+ * Whether a recording can be read by this build (and appended to, when
+ *  it has the same layout as the ticks this machine writes)
+ */
+bool recordreadable(struct recordheader *header)
+{
+	return !memcmp(header->magic, RECORD_MAGIC, sizeof(header->magic)) &&
+		(header->version == RECORD_VERSION) &&
+		(header->byteorder == RECORD_BYTEORDER) &&
+		(header->headersize >= sizeof(struct recordheader)) &&
+		(header->ticksize >= sizeof(struct recordtick)) &&
+		(header->cpusize >= sizeof(struct recordcpu)) &&
+		(header->procsize >= sizeof(struct recordproc));
+}
+
+static bool recordappendable(struct recordheader *existing, struct recordheader *header)
+{
+	return recordreadable(existing) &&
+		(existing->headersize == header->headersize) &&
+		(existing->ticksize == header->ticksize) &&
+		(existing->cpusize == header->cpusize) &&
+		(existing->procsize == header->procsize) &&
+		(existing->cpucount == header->cpucount);
+}
+
+/*
+ * Pick the busiest processes of the last walk (at most RECORD_PROC_MAX,
+ *  busiest first), processes which used no CPU are left out
+ */
+static int recordbusiest(struct sysproctable *table, int *rows)
+{
+	int count = 0;
+	int slot = 0;
+	for (size_t i = 0; i < table->count; ++i) {
+		if(table->percentage[i] <= 0) {
+			continue;
+		}
+		if((count == RECORD_PROC_MAX) && (table->percentage[i] <= table->percentage[rows[count - 1]])) {
+			continue;
+		}
+
+		// insertion into the short sorted list
+		slot = (count < RECORD_PROC_MAX) ? count++ : (count - 1);
+		while((slot > 0) && (table->percentage[rows[slot - 1]] < table->percentage[i])) {
+			rows[slot] = rows[slot - 1];
+			--slot;
+		}
+		rows[slot] = (int)i;
+	}
+	return count;
+}
+
+/*
+ * Start (or continue) a recording, writes the header of a new file
+ *  (returns NULL with errno set, EINVAL when the file is not a
+ *  recording this machine can append to)
+ */
+struct recorder *recordopen(const char *path, struct sysdata *data, int intervalms)
+{
+	struct recordheader header;
+	recordheaderfill(&header, data, intervalms);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if(fstat(fd, &info)) {
+		close(fd);
+		return NULL;
+	}
+	if(info.st_size > 0) {
+		struct recordheader existing;
+		if((pread(fd, &existing, sizeof(existing), 0) != (ssize_t)sizeof(existing)) || !recordappendable(&existing, &header)) {
+			close(fd);
+			errno = EINVAL;
+			return NULL;
+		}
+
+		// a tick torn by a crash would hide every tick appended after it
+		struct recording *recording = recordingopen(path);
+		if(recording == NULL) {
+			close(fd);
+			return NULL;
+		}
+		off_t end = (off_t)header.headersize;
+		if(recording->count) {
+			struct recordtick *last = recordingtick(recording, recording->count - 1);
+			end = (off_t)(recording->offsets[recording->count - 1] + last->size);
+		}
+		recordingclose(recording);
+		if((end < info.st_size) && ftruncate(fd, end)) {
+			close(fd);
+			return NULL;
+		}
+	} else {
+		if(write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+			close(fd);
+			return NULL;
+		}
+	}
+
+	struct recorder *recorder = (struct recorder *)calloc(1, sizeof(struct recorder));
+	if(recorder == NULL) {
+		// TODO: handle memory allocation failure
+		close(fd);
+		return NULL;
+	}
+	recorder->fd = fd;
+	recorder->cpucount = data->res.cpucount;
+	size_t maxtick = sizeof(struct recordtick) + (sizeof(struct recordcpu) * (size_t)recorder->cpucount) + (sizeof(struct recordproc) * RECORD_PROC_MAX);
+	if(!outbufinit(&recorder->out, fd, maxtick)) {
+		close(fd);
+		free(recorder);
+		return NULL;
+	}
+	return recorder;
+}
+
+/*
+ * Append one sample (a single write, a reader never sees half a tick
+ *  unless the disk filled up or the machine crashed during it)
+ */
+bool recordtick(struct recorder *recorder, struct sysdata *data)
+{
+	if(recorder->failed) {
+		return false;
+	}
+
+	int rows[RECORD_PROC_MAX];
+	int proccount = 0;
+	if(data->collected & COLLECT_PROC) {
+		proccount = recordbusiest(&data->procs, rows);
+	}
+
+	struct recordtick tick;
+	memset(&tick, 0, sizeof(tick));
+	tick.size = (uint32_t)(sizeof(struct recordtick) + (sizeof(struct recordcpu) * (size_t)recorder->cpucount) + (sizeof(struct recordproc) * (size_t)proccount));
+	tick.proccount = (uint32_t)proccount;
+	tick.time = recordclock();
+	tick.intervalns = (data->collected & COLLECT_RES) ? collectorinterval(data, COLLECT_RES) : 0;
+	tick.collected = data->collected;
+	tick.loadavg[0] = (uint32_t)(data->res.loadavg1 * 100.0 + 0.5);
+	tick.loadavg[1] = (uint32_t)(data->res.loadavg5 * 100.0 + 0.5);
+	tick.loadavg[2] = (uint32_t)(data->res.loadavg15 * 100.0 + 0.5);
+	tick.memused = data->res.memused;
+	tick.vmpageouts = data->vms;
+	tick.netibytes = data->net.ibytes;
+	tick.netobytes = data->net.obytes;
+	tick.netipackets = data->net.ipackets;
+	tick.netopackets = data->net.opackets;
+	tick.netierrors = data->net.ierrors;
+	tick.netoerrors = data->net.oerrors;
+	tick.diskread = data->res.diskuser;
+	tick.diskwrite = data->res.diskusew;
+	tick.gpuuse = data->res.gpuuse;
+	tick.energyuser = data->res.energyuser;
+	tick.energysystem = data->res.energysystem;
+	outbufbytes(&recorder->out, &tick, sizeof(tick));
+
+	struct recordcpu cpu;
+	for (int cpuno = 0; cpuno < recorder->cpucount; ++cpuno) {
+		memset(&cpu, 0, sizeof(cpu));
+		if((cpuno < data->res.cpucount) && data->res.cpus) {
+			cpu.user = (uint32_t)data->res.cpus[cpuno].user;
+			cpu.sys = (uint32_t)data->res.cpus[cpuno].sys;
+			cpu.idle = (uint32_t)data->res.cpus[cpuno].idle;
+			cpu.nice = (uint32_t)data->res.cpus[cpuno].nice;
+		}
+		outbufbytes(&recorder->out, &cpu, sizeof(cpu));
+	}
+
+	struct recordproc proc;
+	struct sysproctable *table = &data->procs;
+	for (int i = 0; i < proccount; ++i) {
+		memset(&proc, 0, sizeof(proc));
+		proc.pid = table->pid[rows[i]];
+		proc.uid = table->uid[rows[i]];
+		proc.percentage = (uint32_t)(table->percentage[rows[i]] * 100.0 + 0.5);
+		proc.status = table->status[rows[i]];
+		proc.residentmem = table->residentmem[rows[i]];
+		proc.diskread = table->diskior[rows[i]];
+		proc.diskwrite = table->diskiow[rows[i]];
+		memcpy(proc.name, table->records[rows[i]]->name, RECORD_NAME_LENGTH);
+		outbufbytes(&recorder->out, &proc, sizeof(proc));
+	}
+
+	if(!outbufflush(&recorder->out)) {
+		recorder->failed = true;
+		return false;
+	}
+	recorder->ticks += 1;
+	return true;
+}
+
+void recordclose(struct recorder *recorder)
+{
+	if(recorder == NULL) {
+		return;
+	}
+	close(recorder->fd);
+	outbuffree(&recorder->out);
+	free(recorder);
+}
+
+static struct recording *recordingfail(struct recording *recording, int error)
+{
+	recordingclose(recording);
+	errno = error;
+	return NULL;
+}
+
+/*
+ * Map a recording and index its complete ticks (a torn last tick, or
+ *  anything after a damaged one, is left out)
+ */
+struct recording *recordingopen(const char *path)
+{
+	struct recording *recording = (struct recording *)calloc(1, sizeof(struct recording));
+	if(recording == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+
+	struct stat info;
+	recording->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if((recording->fd < 0) || fstat(recording->fd, &info)) {
+		return recordingfail(recording, errno);
+	}
+	if((size_t)info.st_size < sizeof(struct recordheader)) {
+		return recordingfail(recording, EINVAL);
+	}
+
+	recording->size = (size_t)info.st_size;
+	recording->base = (unsigned char *)mmap(NULL, recording->size, PROT_READ, MAP_PRIVATE, recording->fd, 0);
+	if(recording->base == MAP_FAILED) {
+		recording->base = NULL;
+		return recordingfail(recording, errno);
+	}
+	recording->header = (struct recordheader *)recording->base;
+	if(!recordreadable(recording->header)) {
+		return recordingfail(recording, EINVAL);
+	}
+
+	// the ticks are as long as the header says, so a reader of this
+	//  version can step over fields added to them later
+	struct recordheader *header = recording->header;
+	size_t capacity = 0;
+	size_t offset = header->headersize;
+	size_t expected = 0;
+	struct recordtick *tick = NULL;
+	while((offset + header->ticksize) <= recording->size) {
+		tick = (struct recordtick *)(recording->base + offset);
+		expected = header->ticksize + ((size_t)header->cpucount * header->cpusize) + ((size_t)tick->proccount * header->procsize);
+		if((tick->proccount > RECORD_PROC_MAX) || (tick->size != expected) || ((offset + expected) > recording->size)) {
+			break;
+		}
+
+		if(recording->count == capacity) {
+			capacity = capacity ? (capacity * 2) : 1024;
+			size_t *offsets = (size_t *)realloc(recording->offsets, sizeof(size_t) * capacity);
+			if(offsets == NULL) {
+				// TODO: handle memory allocation failure
+				break;
+			}
+			recording->offsets = offsets;
+		}
+		recording->offsets[recording->count++] = offset;
+		offset += expected;
+	}
+	return recording;
+}
+
+struct recordtick *recordingtick(struct recording *recording, size_t index)
+{
+	if(index >= recording->count) {
+		return NULL;
+	}
+	return (struct recordtick *)(recording->base + recording->offsets[index]);
+}
+
+struct recordcpu *recordingcpus(struct recording *recording, struct recordtick *tick)
+{
+	return (struct recordcpu *)((unsigned char *)tick + recording->header->ticksize);
+}
+
+struct recordproc *recordingprocs(struct recording *recording, struct recordtick *tick)
+{
+	return (struct recordproc *)((unsigned char *)tick + recording->header->ticksize + ((size_t)recording->header->cpucount * recording->header->cpusize));
+}
+
+/*
+ * Index of the first tick at or after a time (count when there is none)
+ */
+size_t recordingfind(struct recording *recording, uint64_t time)
+{
+	size_t low = 0;
+	size_t high = recording->count;
+	size_t middle = 0;
+	while(low < high) {
+		middle = low + ((high - low) / 2);
+		if(recordingtick(recording, middle)->time < time) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+void recordingclose(struct recording *recording)
+{
+	if(recording == NULL) {
+		return;
+	}
+	if(recording->base) {
+		munmap(recording->base, recording->size);
+	}
+	if(recording->fd >= 0) {
+		close(recording->fd);
+	}
+	free(recording->offsets);
+	free(recording);
+}
@@ -0,0 +1,157 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+/**
+ * record.h -- binary recordings of the samples
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "collector.h"
+#include "outbuf.h"
+
+// A recording is a header followed by one tick per sample, appended with
+// a single write() each. A tick is a fixed part, one recordcpu for each
+// CPU and then up to RECORD_PROC_MAX recordproc (the busiest processes).
+// Counters are stored as read (totals since boot), readers take the
+// differences between ticks. Numbers are in the byte order of the writer.
+#define RECORD_MAGIC "NMONDREC"
+#define RECORD_VERSION 1
+#define RECORD_BYTEORDER 0x01020304
+#define RECORD_PROC_MAX 10
+#define RECORD_NAME_LENGTH 16
+
+struct recordheader {
+	char magic[8]; // RECORD_MAGIC, without a terminator
+	uint32_t version;
+	uint32_t byteorder; // RECORD_BYTEORDER as the writer stored it
+	uint32_t headersize;
+	uint32_t ticksize; // the fixed part of a tick
+	uint32_t cpusize;
+	uint32_t procsize;
+	uint32_t cpucount;
+	uint32_t intervalms; // when the recording started
+	uint64_t started; // wall clock (ns since the epoch)
+	uint64_t memorysize;
+	uint64_t boottime; // seconds since the epoch
+	char hostname[64];
+	char model[64];
+	char cpubrand[64];
+	char osrelease[32];
+	char osversion[32];
+};
+
+struct recordtick {
+	uint32_t size; // the whole tick, with its CPUs and processes
+	uint32_t proccount;
+	uint64_t time; // wall clock (ns since the epoch)
+	uint64_t intervalns; // since the resource counters were read before (0 when not read for this tick)
+	uint32_t collected; // COLLECT_ mask, what this sample holds
+	uint32_t loadavg[3]; // hundredths
+	uint64_t memused;
+	uint64_t vmpageouts;
+	uint64_t netibytes;
+	uint64_t netobytes;
+	uint64_t netipackets;
+	uint64_t netopackets;
+	uint64_t netierrors;
+	uint64_t netoerrors;
+	uint64_t diskread;
+	uint64_t diskwrite;
+	uint64_t gpuuse;
+	uint64_t energyuser;
+	uint64_t energysystem;
+};
+
+struct recordcpu {
+	uint32_t user; // ticks
+	uint32_t sys;
+	uint32_t idle;
+	uint32_t nice;
+};
+
+struct recordproc {
+	int32_t pid;
+	uint32_t uid;
+	uint32_t percentage; // hundredths of a percent (of one CPU)
+	char status;
+	char pad[3];
+	uint64_t residentmem;
+	uint64_t diskread;
+	uint64_t diskwrite;
+	char name[RECORD_NAME_LENGTH]; // not terminated when it is full
+};
+
+extern bool recordreadable(struct recordheader*);
+
+//
+// Writing
+//
+
+struct recorder {
+	int fd;
+	struct outbuf out;
+	int cpucount;
+	unsigned long ticks;
+	bool failed; // a write failed (disk full?), nothing more is written
+};
+
+extern struct recorder *recordopen(const char*, struct sysdata*, int);
+extern bool recordtick(struct recorder*, struct sysdata*);
+extern void recordclose(struct recorder*);
+
+//
+// Reading (the file is mapped, the ticks are found through an index)
+//
+
+struct recording {
+	int fd;
+	unsigned char *base;
+	size_t size;
+	struct recordheader *header;
+	size_t count;
+	size_t *offsets; // of each complete tick
+};
+
+extern struct recording *recordingopen(const char*);
+extern struct recordtick *recordingtick(struct recording*, size_t);
+extern struct recordcpu *recordingcpus(struct recording*, struct recordtick*);
+extern struct recordproc *recordingprocs(struct recording*, struct recordtick*);
+extern size_t recordingfind(struct recording*, uint64_t);
+extern void recordingclose(struct recording*);
+
+#endif
@@ -0,0 +1,794 @@
+/**
+ * replay.c -- play recordings back through the panes
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "replay.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static void replaypoke(struct replay *replay)
+{
+	// a full pipe already has a wakeup pending
+	ssize_t written = write(replay->wakepipe[1], "", 1);
+	(void)written;
+}
+
+static void replaydrain(int fd)
+{
+	char buffer[64];
+	while(read(fd, buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+/*
+ * Read exactly length bytes (false at the end of the input)
+ */
+static bool replayreadall(int fd, void *buffer, size_t length)
+{
+	size_t done = 0;
+	ssize_t result = 0;
+	while(done < length) {
+		result = read(fd, (unsigned char *)buffer + done, length - done);
+		if(result < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		if(result == 0) {
+			return false;
+		}
+		done += (size_t)result;
+	}
+	return true;
+}
+
+/*
+ * The tick at an index, NULL when it was not read (yet)
+ *  (for a pipe, call with the lock held)
+ */
+static struct recordtick *replaytick(struct replay *replay, size_t index)
+{
+	if(replay->recording) {
+		return recordingtick(replay->recording, index);
+	}
+	if(index >= replay->tickcount) {
+		return NULL;
+	}
+	return (struct recordtick *)replay->ticks[index];
+}
+
+static size_t replaytickcount(struct replay *replay)
+{
+	return replay->recording ? replay->recording->count : replay->tickcount;
+}
+
+static struct recordcpu *replaycpus(struct replay *replay, struct recordtick *tick)
+{
+	return (struct recordcpu *)((unsigned char *)tick + replay->header.ticksize);
+}
+
+static struct recordproc *replayprocs(struct replay *replay, struct recordtick *tick)
+{
+	return (struct recordproc *)((unsigned char *)tick + replay->header.ticksize + ((size_t)replay->header.cpucount * replay->header.cpusize));
+}
+
+/*
+ * Copy the ticks of a piped recording into memory as they arrive (all of
+ *  them are kept, so that the replay can seek back)
+ */
+static void *replayreadmain(void *arg)
+{
+	struct replay *replay = (struct replay *)arg;
+	struct recordheader *header = &replay->header;
+	unsigned char *tick = NULL;
+	unsigned char *grown = NULL;
+	size_t size = 0;
+
+	for(;;) {
+		// the fixed part comes first, it says how long the rest is
+		tick = (unsigned char *)malloc(header->ticksize);
+		if(tick == NULL) {
+			// TODO: handle memory allocation failure
+			break;
+		}
+		if(!replayreadall(replay->fd, tick, header->ticksize)) {
+			free(tick);
+			break;
+		}
+		struct recordtick *fixed = (struct recordtick *)tick;
+		size = header->ticksize + ((size_t)header->cpucount * header->cpusize) + ((size_t)fixed->proccount * header->procsize);
+		if((fixed->proccount > RECORD_PROC_MAX) || (fixed->size != size)) {
+			// damaged, nothing after it can be trusted
+			free(tick);
+			break;
+		}
+		grown = (unsigned char *)realloc(tick, size);
+		if(grown == NULL) {
+			// TODO: handle memory allocation failure
+			free(tick);
+			break;
+		}
+		tick = grown;
+		if(!replayreadall(replay->fd, tick + header->ticksize, size - header->ticksize)) {
+			free(tick);
+			break;
+		}
+
+		pthread_mutex_lock(&replay->lock);
+		if(replay->tickcount == replay->tickcapacity) {
+			size_t capacity = replay->tickcapacity ? (replay->tickcapacity * 2) : 1024;
+			unsigned char **ticks = (unsigned char **)realloc(replay->ticks, sizeof(unsigned char *) * capacity);
+			if(ticks == NULL) {
+				// TODO: handle memory allocation failure
+				pthread_mutex_unlock(&replay->lock);
+				free(tick);
+				break;
+			}
+			replay->ticks = ticks;
+			replay->tickcapacity = capacity;
+		}
+		replay->ticks[replay->tickcount++] = tick;
+		pthread_cond_broadcast(&replay->changed);
+		pthread_mutex_unlock(&replay->lock);
+	}
+
+	pthread_mutex_lock(&replay->lock);
+	replay->ended = true;
+	pthread_cond_broadcast(&replay->changed);
+	pthread_mutex_unlock(&replay->lock);
+	return NULL;
+}
+
+/*
+ * Turn a tick (and the one before it, for the differences) back into
+ *  what the resource, network and process collectors fill in
+ */
+static void replaydecode(struct replay *replay, struct recordtick *tick, struct recordtick *last, struct replayframe *frame, struct uidcache *uids)
+{
+	struct recordcpu *cpus = replaycpus(replay, tick);
+	struct recordcpu *lastcpus = replaycpus(replay, last);
+	struct sysres *res = &frame->res;
+
+	frame->time = tick->time;
+	frame->intervalns = (tick->time > last->time) ? (tick->time - last->time) : 0;
+	frame->collected = tick->collected;
+
+	res->avgpercentuser = 0;
+	res->avgpercentsys = 0;
+	res->avgpercentidle = 0;
+	res->avgpercentnice = 0;
+	double total = 0;
+	for (int cpuno = 0; cpuno < res->cpucount; ++cpuno) {
+		struct sysrescpu *cpu = &res->cpus[cpuno];
+		cpu->olduser = (int)lastcpus[cpuno].user;
+		cpu->oldsys = (int)lastcpus[cpuno].sys;
+		cpu->oldidle = (int)lastcpus[cpuno].idle;
+		cpu->oldnice = (int)lastcpus[cpuno].nice;
+		cpu->oldtotal = cpu->olduser + cpu->oldsys + cpu->oldidle + cpu->oldnice;
+		cpu->user = (int)cpus[cpuno].user;
+		cpu->sys = (int)cpus[cpuno].sys;
+		cpu->idle = (int)cpus[cpuno].idle;
+		cpu->nice = (int)cpus[cpuno].nice;
+		cpu->total = cpu->user + cpu->sys + cpu->idle + cpu->nice;
+
+		// the tick counters wrap, unsigned differences do not mind
+		total = (double)((cpus[cpuno].user - lastcpus[cpuno].user) + (cpus[cpuno].sys - lastcpus[cpuno].sys) +
+			(cpus[cpuno].idle - lastcpus[cpuno].idle) + (cpus[cpuno].nice - lastcpus[cpuno].nice));
+		if(total > 0) {
+			cpu->percentuser = (double)(cpus[cpuno].user - lastcpus[cpuno].user) / total * 100;
+			cpu->percentsys = (double)(cpus[cpuno].sys - lastcpus[cpuno].sys) / total * 100;
+			cpu->percentidle = (double)(cpus[cpuno].idle - lastcpus[cpuno].idle) / total * 100;
+			cpu->percentnice = (double)(cpus[cpuno].nice - lastcpus[cpuno].nice) / total * 100;
+		} else {
+			cpu->percentuser = 0;
+			cpu->percentsys = 0;
+			cpu->percentidle = 0;
+			cpu->percentnice = 0;
+		}
+		res->avgpercentuser += cpu->percentuser;
+		res->avgpercentsys += cpu->percentsys;
+		res->avgpercentidle += cpu->percentidle;
+		res->avgpercentnice += cpu->percentnice;
+	}
+	res->percentallcpu = (res->avgpercentuser + res->avgpercentsys + res->avgpercentnice) / 100;
+	if(res->cpucount) {
+		res->avgpercentuser /= res->cpucount;
+		res->avgpercentsys /= res->cpucount;
+		res->avgpercentidle /= res->cpucount;
+		res->avgpercentnice /= res->cpucount;
+	}
+
+	res->loadavg1 = tick->loadavg[0] / 100.0;
+	res->loadavg5 = tick->loadavg[1] / 100.0;
+	res->loadavg15 = tick->loadavg[2] / 100.0;
+	res->memused = tick->memused;
+	res->diskuser = (unsigned long)tick->diskread;
+	res->diskuserlast = (unsigned long)last->diskread;
+	res->diskusew = (unsigned long)tick->diskwrite;
+	res->diskusewlast = (unsigned long)last->diskwrite;
+	res->gpuuse = tick->gpuuse;
+	res->gpuuselast = last->gpuuse;
+	res->energyuser = tick->energyuser;
+	res->energyuserlast = last->energyuser;
+	res->energysystem = tick->energysystem;
+	res->energysystemlast = last->energysystem;
+
+	memset(&frame->net, 0, sizeof(frame->net));
+	frame->net.ibytes = tick->netibytes;
+	frame->net.oldibytes = last->netibytes;
+	frame->net.obytes = tick->netobytes;
+	frame->net.oldobytes = last->netobytes;
+	frame->net.ipackets = tick->netipackets;
+	frame->net.opackets = tick->netopackets;
+	frame->net.ierrors = tick->netierrors;
+	frame->net.oerrors = tick->netoerrors;
+	frame->vms = tick->vmpageouts;
+
+	// the user names are the ones of this machine
+	struct recordproc *procs = replayprocs(replay, tick);
+	frame->proccount = tick->proccount;
+	for (size_t i = 0; i < frame->proccount; ++i) {
+		struct sysproc *proc = &frame->procs[i];
+		memset(proc, 0, sizeof(struct sysproc));
+		proc->pid = procs[i].pid;
+		proc->status = procs[i].status;
+		memcpy(proc->name, procs[i].name, RECORD_NAME_LENGTH);
+		memcpy(proc->path, procs[i].name, RECORD_NAME_LENGTH);
+		proc->realuid = procs[i].uid;
+		proc->effectiveuid = procs[i].uid;
+		proc->realusername = uidcachename(uids, procs[i].uid);
+		proc->effectiveusername = proc->realusername;
+		proc->percentage = procs[i].percentage / 100.0;
+		proc->residentmem = procs[i].residentmem;
+		proc->diskior = procs[i].diskread;
+		proc->diskiow = procs[i].diskwrite;
+	}
+}
+
+/*
+ * Put a frame into the sampler's data and publish it to the UI thread
+ */
+static void replayshow(struct replay *replay, struct replayframe *frame)
+{
+	struct sysdata *data = &replay->sampler->data;
+	data->time = (time_t)(frame->time / 1000000000ULL);
+	sysrescopy(&data->res, &frame->res);
+	data->net = frame->net;
+	data->vms = frame->vms;
+	data->collected = frame->collected;
+	for (int i = 0; i < COLLECTOR_COUNT; ++i) {
+		data->intervalns[i] = frame->intervalns;
+	}
+
+	// the rows point into the frame, publishing copies them
+	struct sysproctable *table = &data->procs;
+	table->count = 0;
+	if(sysproctablereserve(table, frame->proccount)) {
+		for (size_t i = 0; i < frame->proccount; ++i) {
+			struct sysproc *proc = &frame->procs[i];
+			table->records[i] = proc;
+			table->order[i] = (int)i;
+			table->sample[i] = (int)i;
+			table->pid[i] = proc->pid;
+			table->pgid[i] = proc->pgid;
+			table->parentpid[i] = proc->parentpid;
+			table->uid[i] = proc->realuid;
+			table->status[i] = proc->status;
+			table->percentage[i] = proc->percentage;
+			table->totaltime[i] = 0;
+			table->lasttotaltime[i] = 0;
+			table->residentmem[i] = proc->residentmem;
+			table->physicalmem[i] = proc->physicalmem;
+			table->diskior[i] = proc->diskior;
+			table->diskiow[i] = proc->diskiow;
+			table->gpuuse[i] = 0;
+		}
+		table->count = frame->proccount;
+	}
+
+	samplerpublish(replay->sampler);
+	replay->position = frame->index;
+	replay->positiontime = frame->time;
+}
+
+static void *replaydecodemain(void *arg)
+{
+	struct replay *replay = (struct replay *)arg;
+	struct uidcache *uids = &replay->sampler->data.proccache.uids;
+	struct replayframe *frame = NULL;
+	struct recordtick *tick = NULL;
+	struct recordtick *last = NULL;
+	unsigned long generation = 0;
+	size_t index = 0;
+
+	pthread_mutex_lock(&replay->lock);
+	while(!atomic_load(&replay->quit)) {
+		if((replay->framecount == REPLAY_AHEAD) || (replay->decodenext >= replaytickcount(replay))) {
+			pthread_cond_wait(&replay->changed, &replay->lock);
+			continue;
+		}
+
+		// the slot after the last frame is not read by the player
+		index = replay->decodenext;
+		generation = replay->generation;
+		frame = &replay->frames[(replay->framefirst + replay->framecount) % REPLAY_AHEAD];
+		tick = replaytick(replay, index);
+		last = index ? replaytick(replay, index - 1) : tick;
+		pthread_mutex_unlock(&replay->lock);
+
+		// reading the ticks (page faults of a mapped file) and decoding
+		//  happen here, ahead of the playhead and outside of the lock
+		replaydecode(replay, tick, last, frame, uids);
+		frame->index = index;
+
+		pthread_mutex_lock(&replay->lock);
+		// a seek while decoding makes the frame useless
+		if(generation == replay->generation) {
+			replay->framecount += 1;
+			replay->decodenext = index + 1;
+			replaypoke(replay);
+		}
+	}
+	pthread_mutex_unlock(&replay->lock);
+	return NULL;
+}
+
+static void *replayplaymain(void *arg)
+{
+	struct replay *replay = (struct replay *)arg;
+	struct pollfd wake = { replay->wakepipe[0], POLLIN, 0 };
+	struct replayframe *frame = NULL;
+	unsigned long long maxgapns = (unsigned long long)(replay->header.intervalms ? replay->header.intervalms : 2000) * 1000000ULL * REPLAY_GAP_MAX;
+	unsigned long long gapns = 0;
+	unsigned long long dueat = 0;
+	unsigned long long now = 0;
+	int waitms = 0;
+	bool show = false;
+
+	pthread_mutex_lock(&replay->lock);
+	unsigned long long shownat = collectorclock();
+	uint64_t showntime = replay->positiontime;
+	pthread_mutex_unlock(&replay->lock);
+
+	for(;;) {
+		replaydrain(replay->wakepipe[0]);
+		waitms = -1;
+		show = false;
+
+		pthread_mutex_lock(&replay->lock);
+		if(atomic_load(&replay->quit)) {
+			pthread_mutex_unlock(&replay->lock);
+			break;
+		}
+		if(replay->framecount) {
+			frame = &replay->frames[replay->framefirst];
+			if(replay->shownow || replay->step) {
+				show = true;
+			} else if(!replay->paused) {
+				// frames are as far apart as they were recorded, sped up
+				gapns = (frame->time > showntime) ? (frame->time - showntime) : 0;
+				if(gapns > maxgapns) {
+					gapns = maxgapns;
+				}
+				dueat = shownat + (gapns / (unsigned long long)replay->speed);
+				now = collectorclock();
+				if(now >= dueat) {
+					show = true;
+				} else {
+					waitms = (int)((dueat - now + 999999) / 1000000);
+				}
+			}
+
+			if(show) {
+				replayshow(replay, frame);
+				replay->framefirst = (replay->framefirst + 1) % REPLAY_AHEAD;
+				replay->framecount -= 1;
+				replay->shownow = false;
+				replay->step = false;
+				shownat = collectorclock();
+				showntime = replay->positiontime;
+				pthread_cond_signal(&replay->changed);
+			}
+		}
+		pthread_mutex_unlock(&replay->lock);
+
+		if(!show) {
+			poll(&wake, 1, waitms);
+		}
+	}
+	return NULL;
+}
+
+static char *replaystring(const char *from, size_t size)
+{
+	char *result = (char *)calloc(1, size + 1);
+	if(result) {
+		memcpy(result, from, size);
+	}
+	return result;
+}
+
+/*
+ * Open a recording to play back, a path of "-" reads it from stdin
+ *  (returns NULL with errno set, EINVAL when it is not a recording)
+ */
+struct replay *replayopen(const char *path)
+{
+	struct replay *replay = (struct replay *)calloc(1, sizeof(struct replay));
+	if(replay == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	replay->fd = -1;
+	replay->speed = 1;
+	atomic_init(&replay->quit, false);
+	pthread_mutex_init(&replay->lock, NULL);
+	pthread_cond_init(&replay->changed, NULL);
+	replay->wakepipe[0] = -1;
+	replay->wakepipe[1] = -1;
+
+	int error = 0;
+	if(strcmp(path, "-")) {
+		replay->recording = recordingopen(path);
+		if(replay->recording == NULL) {
+			error = errno;
+			replayfree(replay);
+			errno = error;
+			return NULL;
+		}
+		replay->header = *replay->recording->header;
+	} else {
+		replay->fd = STDIN_FILENO;
+		if(!replayreadall(replay->fd, &replay->header, sizeof(struct recordheader)) || !recordreadable(&replay->header)) {
+			replayfree(replay);
+			errno = EINVAL;
+			return NULL;
+		}
+		// skip what a later version added to the header
+		char skipped[256];
+		size_t skip = replay->header.headersize - sizeof(struct recordheader);
+		while(skip) {
+			size_t chunk = (skip < sizeof(skipped)) ? skip : sizeof(skipped);
+			if(!replayreadall(replay->fd, skipped, chunk)) {
+				break;
+			}
+			skip -= chunk;
+		}
+	}
+	if(!replay->header.cpucount) {
+		replayfree(replay);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (int i = 0; i < REPLAY_AHEAD; ++i) {
+		replay->frames[i].res.cpucount = (int)replay->header.cpucount;
+		replay->frames[i].res.cpuhyperthreadmod = 1;
+		replay->frames[i].res.cpus = (struct sysrescpu *)calloc(replay->header.cpucount, sizeof(struct sysrescpu));
+		if(replay->frames[i].res.cpus == NULL) {
+			// TODO: handle memory allocation failure
+			replayfree(replay);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	if(pipe(replay->wakepipe)) {
+		error = errno;
+		replayfree(replay);
+		errno = error;
+		return NULL;
+	}
+	for (int i = 0; i < 2; ++i) {
+		fcntl(replay->wakepipe[i], F_SETFL, fcntl(replay->wakepipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(replay->wakepipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	if(replay->fd >= 0) {
+		sigset_t blocked;
+		sigset_t previous;
+		sigfillset(&blocked);
+		pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+		replay->reading = !pthread_create(&replay->reader, NULL, replayreadmain, replay);
+		pthread_sigmask(SIG_SETMASK, &previous, NULL);
+		if(!replay->reading) {
+			replayfree(replay);
+			errno = EAGAIN;
+			return NULL;
+		}
+	}
+	return replay;
+}
+
+/*
+ * Fill the sampler's data with the recorded facts and the first tick
+ *  (instead of collecting them, so that the panes are sized for the
+ *  recording), false when the recording holds no ticks
+ */
+bool replayfirst(struct replay *replay, struct sampler *sampler)
+{
+	replay->sampler = sampler;
+
+	pthread_mutex_lock(&replay->lock);
+	while(!replay->recording && !replay->ended && !replay->tickcount) {
+		pthread_cond_wait(&replay->changed, &replay->lock);
+	}
+	struct recordtick *tick = replaytick(replay, 0);
+	pthread_mutex_unlock(&replay->lock);
+	if(tick == NULL) {
+		return false;
+	}
+
+	struct recordheader *header = &replay->header;
+	struct sysdata *data = &sampler->data;
+	data->hw.cpucount = header->cpucount;
+	data->hw.logicalcpucount = header->cpucount;
+	data->hw.memorysize = header->memorysize;
+	data->hw.model = replaystring(header->model, sizeof(header->model));
+	data->hw.cpubrand = replaystring(header->cpubrand, sizeof(header->cpubrand));
+	data->hw.architecture = replaystring("", 0);
+	data->hw.cpuvendor = replaystring("", 0);
+	data->hw.machine = replaystring("", 0);
+	data->kern.hostname = replaystring(header->hostname, sizeof(header->hostname));
+	data->kern.osrelease = replaystring(header->osrelease, sizeof(header->osrelease));
+	data->kern.osversion = replaystring(header->osversion, sizeof(header->osversion));
+	data->kern.ostype = replaystring("", 0);
+	data->kern.version = replaystring("", 0);
+	data->kern.bootfile = replaystring("", 0);
+	data->kern.domainname = replaystring("", 0);
+	data->kern.boottime.tv_sec = (time_t)header->boottime;
+	data->kern.boottimestring = replaystring("", 0);
+	data->reloads += 1;
+
+	struct replayframe *frame = &replay->frames[0];
+	replaydecode(replay, tick, tick, frame, &data->proccache.uids);
+	frame->index = 0;
+	replayshow(replay, frame);
+	replay->decodenext = 1;
+	return true;
+}
+
+/*
+ * Start decoding and playing back on threads (after replayfirst)
+ */
+bool replaystart(struct replay *replay)
+{
+	// signals (resize, interrupt) are left to the UI thread
+	sigset_t blocked;
+	sigset_t previous;
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+	replay->running = !pthread_create(&replay->decoder, NULL, replaydecodemain, replay);
+	if(replay->running && pthread_create(&replay->player, NULL, replayplaymain, replay)) {
+		atomic_store(&replay->quit, true);
+		pthread_mutex_lock(&replay->lock);
+		pthread_cond_broadcast(&replay->changed);
+		pthread_mutex_unlock(&replay->lock);
+		pthread_join(replay->decoder, NULL);
+		replay->running = false;
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	return replay->running;
+}
+
+void replaypause(struct replay *replay)
+{
+	pthread_mutex_lock(&replay->lock);
+	replay->paused = !replay->paused;
+	pthread_mutex_unlock(&replay->lock);
+	replaypoke(replay);
+}
+
+/*
+ * Pause, and show the next frame
+ */
+void replaystep(struct replay *replay)
+{
+	pthread_mutex_lock(&replay->lock);
+	replay->paused = true;
+	replay->step = true;
+	pthread_mutex_unlock(&replay->lock);
+	replaypoke(replay);
+}
+
+/*
+ * Play twice as fast (or half as fast), from 1x up to REPLAY_SPEED_MAX
+ */
+void replayspeed(struct replay *replay, bool faster)
+{
+	pthread_mutex_lock(&replay->lock);
+	if(faster) {
+		replay->speed *= 2;
+		if(replay->speed > REPLAY_SPEED_MAX) {
+			replay->speed = REPLAY_SPEED_MAX;
+		}
+	} else {
+		replay->speed /= 2;
+		if(replay->speed < 1) {
+			replay->speed = 1;
+		}
+	}
+	pthread_mutex_unlock(&replay->lock);
+	replaypoke(replay);
+}
+
+/*
+ * Index of the first tick at or after a time (the last tick when all of
+ *  them are earlier), call with the lock held
+ */
+static size_t replayfind(struct replay *replay, uint64_t time)
+{
+	size_t low = 0;
+	size_t high = replaytickcount(replay);
+	size_t middle = 0;
+	while(low < high) {
+		middle = low + ((high - low) / 2);
+		if(replaytick(replay, middle)->time < time) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if(low && (low == replaytickcount(replay))) {
+		low -= 1;
+	}
+	return low;
+}
+
+/*
+ * Seek to "+seconds", "-seconds", "HH:MM[:SS]" (on the day shown) or
+ *  "YYYY-MM-DD HH:MM[:SS]" (local time), false when it cannot be parsed
+ */
+bool replayseek(struct replay *replay, const char *text)
+{
+	pthread_mutex_lock(&replay->lock);
+	time_t shown = (time_t)(replay->positiontime / 1000000000ULL);
+	pthread_mutex_unlock(&replay->lock);
+
+	time_t target = 0;
+	char *end = NULL;
+	while(*text == ' ') {
+		++text;
+	}
+	if((*text == '+') || (*text == '-')) {
+		long seconds = strtol(text, &end, 10);
+		if(end == text) {
+			return false;
+		}
+		target = shown + seconds;
+	} else {
+		struct tm when;
+		int year = 0;
+		int month = 0;
+		int day = 0;
+		int hour = 0;
+		int minute = 0;
+		int second = 0;
+		localtime_r(&shown, &when);
+		if(sscanf(text, "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) >= 5) {
+			when.tm_year = year - 1900;
+			when.tm_mon = month - 1;
+			when.tm_mday = day;
+		} else if(sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2) {
+			return false;
+		}
+		when.tm_hour = hour;
+		when.tm_min = minute;
+		when.tm_sec = second;
+		when.tm_isdst = -1;
+		target = mktime(&when);
+	}
+	if(target < 0) {
+		target = 0;
+	}
+
+	pthread_mutex_lock(&replay->lock);
+	if(replaytickcount(replay)) {
+		// frames decoded ahead are dropped, the decoder starts over there
+		replay->decodenext = replayfind(replay, (uint64_t)target * 1000000000ULL);
+		replay->generation += 1;
+		replay->framecount = 0;
+		replay->shownow = true;
+		pthread_cond_broadcast(&replay->changed);
+	}
+	pthread_mutex_unlock(&replay->lock);
+	replaypoke(replay);
+	return true;
+}
+
+/*
+ * Describe the playback for the header (state, speed and recorded date)
+ */
+void replaystatus(struct replay *replay, char *message, size_t size)
+{
+	pthread_mutex_lock(&replay->lock);
+	bool paused = replay->paused;
+	int speed = replay->speed;
+	bool atend = (replay->recording || replay->ended) && !replay->framecount && ((replay->position + 1) >= replaytickcount(replay));
+	time_t shown = (time_t)(replay->positiontime / 1000000000ULL);
+	pthread_mutex_unlock(&replay->lock);
+
+	struct tm when;
+	localtime_r(&shown, &when);
+	snprintf(message, size, "%-6s %4dx %04d-%02d-%02d", atend ? "END" : (paused ? "PAUSED" : "REPLAY"), speed,
+		when.tm_year + 1900, when.tm_mon + 1, when.tm_mday);
+}
+
+void replayfree(struct replay *replay)
+{
+	if(replay == NULL) {
+		return;
+	}
+
+	atomic_store(&replay->quit, true);
+	if(replay->running) {
+		pthread_mutex_lock(&replay->lock);
+		pthread_cond_broadcast(&replay->changed);
+		pthread_mutex_unlock(&replay->lock);
+		replaypoke(replay);
+		pthread_join(replay->decoder, NULL);
+		pthread_join(replay->player, NULL);
+	}
+	if(replay->reading) {
+		// it may be blocked reading the pipe
+		pthread_cancel(replay->reader);
+		pthread_join(replay->reader, NULL);
+	}
+
+	for (size_t i = 0; i < replay->tickcount; ++i) {
+		free(replay->ticks[i]);
+	}
+	free(replay->ticks);
+	for (int i = 0; i < REPLAY_AHEAD; ++i) {
+		free(replay->frames[i].res.cpus);
+	}
+	recordingclose(replay->recording);
+	if(replay->wakepipe[0] >= 0) {
+		close(replay->wakepipe[0]);
+		close(replay->wakepipe[1]);
+	}
+	pthread_cond_destroy(&replay->changed);
+	pthread_mutex_destroy(&replay->lock);
+	free(replay);
+}
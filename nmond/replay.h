@@ -0,0 +1,118 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/**
+ * replay.h -- play recordings back through the panes
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "record.h"
+#include "sampler.h"
+
+// frames decoded ahead of the one shown
+#define REPLAY_AHEAD 16
+#define REPLAY_SPEED_MAX 1000
+// longest wait between two ticks (in recorded refresh delays), so that a
+//  recording which was stopped and appended to later plays on
+#define REPLAY_GAP_MAX 10
+
+// A tick turned back into what the collectors fill in
+struct replayframe {
+	size_t index; // of the tick in the recording
+	uint64_t time; // when it was recorded (ns since the epoch)
+	unsigned long long intervalns; // since the tick before
+	unsigned int collected;
+	struct sysres res; // owns its per CPU array
+	struct sysnet net;
+	unsigned long long vms;
+	size_t proccount;
+	struct sysproc procs[RECORD_PROC_MAX];
+};
+
+struct replay {
+	// a mapped file, or (for a pipe) ticks copied as they arrive
+	struct recordheader header;
+	struct recording *recording;
+	int fd;
+	unsigned char **ticks;
+	size_t tickcount;
+	size_t tickcapacity;
+	bool ended; // the pipe was closed
+
+	// everything below is guarded by lock
+	pthread_mutex_t lock;
+	pthread_cond_t changed; // wakes the decoder
+
+	// frames decoded ahead of the playhead (a ring)
+	struct replayframe frames[REPLAY_AHEAD];
+	size_t framefirst;
+	size_t framecount;
+	size_t decodenext; // tick the decoder works on next
+	unsigned long generation; // seeks so far, older frames are dropped
+
+	// playback, as set by the UI thread
+	bool paused;
+	bool step;
+	bool shownow; // show the next frame without waiting (after a seek)
+	int speed;
+	size_t position; // tick shown
+	uint64_t positiontime;
+
+	int wakepipe[2]; // wakes the player
+	atomic_bool quit;
+	struct sampler *sampler;
+	pthread_t reader;
+	pthread_t decoder;
+	pthread_t player;
+	bool reading;
+	bool running;
+};
+
+extern struct replay *replayopen(const char*);
+extern bool replayfirst(struct replay*, struct sampler*);
+extern bool replaystart(struct replay*);
+extern void replaypause(struct replay*);
+extern void replaystep(struct replay*);
+extern void replayspeed(struct replay*, bool);
+extern bool replayseek(struct replay*, const char*);
+extern void replaystatus(struct replay*, char*, size_t);
+extern void replayfree(struct replay*);
+
+#endif
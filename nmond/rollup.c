@@ -0,0 +1,477 @@
+/**
+ * rollup.c -- keep long-term summaries of the samples
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rollup.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint32_t rollupslots[ROLLUP_LEVELS] = {
+	ROLLUP_SLOTS_MINUTE, ROLLUP_SLOTS_HOUR, ROLLUP_SLOTS_DAY, ROLLUP_SLOTS_MONTH
+};
+
+// the value of the first bin above zero (percent, or bytes per second)
+static const double rollupunits[ROLLUP_METRICS] = {
+	0.01, 0.01, 0.01, 256, 256, 256, 256
+};
+
+/*
+ * The ring of buckets of a resolution
+ */
+static struct rollupbucket *rollupring(struct rollupfile *file, int level)
+{
+	struct rollupbucket *ring = file->buckets;
+	for (int i = 0; i < level; ++i) {
+		ring += rollupslots[i];
+	}
+	return ring;
+}
+
+/*
+ * Start of the bucket which holds a time (and of the one after it),
+ *  hours, days and months follow the local clock
+ */
+static time_t rollupstart(int level, time_t time, time_t *next)
+{
+	if(level == ROLLUP_MINUTE) {
+		*next = time - (time % 60) + 60;
+		return time - (time % 60);
+	}
+
+	struct tm when;
+	localtime_r(&time, &when);
+	when.tm_sec = 0;
+	when.tm_min = 0;
+	if(level != ROLLUP_HOUR) {
+		when.tm_hour = 0;
+		when.tm_isdst = -1;
+	}
+	if(level == ROLLUP_MONTH) {
+		when.tm_mday = 1;
+	}
+	time_t start = mktime(&when);
+
+	if(level == ROLLUP_HOUR) {
+		when.tm_hour += 1;
+		when.tm_isdst = -1;
+	} else if(level == ROLLUP_DAY) {
+		when.tm_mday += 1;
+	} else {
+		when.tm_mon += 1;
+	}
+	*next = mktime(&when);
+	return start;
+}
+
+static int rollupbin(int metric, double value)
+{
+	double units = value / rollupunits[metric];
+	if(!(units >= 1)) {
+		return 0;
+	}
+	int bin = 1 + (int)(2 * log2(units));
+	return (bin < ROLLUP_BINS) ? bin : (ROLLUP_BINS - 1);
+}
+
+/*
+ * The middle (geometric) of the values counted in a bin
+ */
+static double rollupbinvalue(int metric, int bin)
+{
+	if(!bin) {
+		return 0;
+	}
+	return rollupunits[metric] * exp2((bin - 0.5) / 2);
+}
+
+static void rolluphalve(struct rollupmetric *metric)
+{
+	// a bin which counted anything keeps at least one
+	for (int i = 0; i < ROLLUP_BINS; ++i) {
+		metric->bins[i] = (uint16_t)((metric->bins[i] + 1) >> 1);
+	}
+	metric->shift += 1;
+}
+
+static void rollupmetricadd(struct rollupmetric *metric, double value, int bin)
+{
+	if(metric->bins[bin] == UINT16_MAX) {
+		rolluphalve(metric);
+	}
+	metric->bins[bin] += 1;
+	if(!metric->count || (value < metric->min)) {
+		metric->min = value;
+	}
+	if(!metric->count || (value > metric->max)) {
+		metric->max = value;
+	}
+	metric->count += 1;
+	metric->sum += value;
+}
+
+/*
+ * Add the counts of one metric to another (scaled to the larger shift)
+ */
+static void rollupmerge(struct rollupmetric *to, struct rollupmetric *from)
+{
+	if(!from->count) {
+		return;
+	}
+	if(!to->count) {
+		*to = *from;
+		return;
+	}
+
+	uint8_t shift = (to->shift > from->shift) ? to->shift : from->shift;
+	int toscale = shift - to->shift;
+	int fromscale = shift - from->shift;
+	uint32_t bins[ROLLUP_BINS];
+	uint32_t largest = 0;
+	for (int i = 0; i < ROLLUP_BINS; ++i) {
+		bins[i] = ((to->bins[i] + (1U << toscale) - 1) >> toscale) + ((from->bins[i] + (1U << fromscale) - 1) >> fromscale);
+		if(bins[i] > largest) {
+			largest = bins[i];
+		}
+	}
+	while(largest > UINT16_MAX) {
+		for (int i = 0; i < ROLLUP_BINS; ++i) {
+			bins[i] = (bins[i] + 1) >> 1;
+		}
+		largest = (largest + 1) >> 1;
+		shift += 1;
+	}
+	for (int i = 0; i < ROLLUP_BINS; ++i) {
+		to->bins[i] = (uint16_t)bins[i];
+	}
+	to->shift = shift;
+
+	if(from->min < to->min) {
+		to->min = from->min;
+	}
+	if(from->max > to->max) {
+		to->max = from->max;
+	}
+	to->count += from->count;
+	to->sum += from->sum;
+}
+
+static double rollupquantile(struct rollupmetric *metric, int id, double quantile)
+{
+	unsigned long total = 0;
+	for (int i = 0; i < ROLLUP_BINS; ++i) {
+		total += metric->bins[i];
+	}
+	if(!total) {
+		return 0;
+	}
+
+	double wanted = ceil(quantile * (double)total);
+	unsigned long seen = 0;
+	double result = metric->max;
+	for (int i = 0; i < ROLLUP_BINS; ++i) {
+		seen += metric->bins[i];
+		if((double)seen >= wanted) {
+			result = rollupbinvalue(id, i);
+			break;
+		}
+	}
+	// the bin is coarser than what was seen
+	if(result < metric->min) {
+		result = metric->min;
+	}
+	if(result > metric->max) {
+		result = metric->max;
+	}
+	return result;
+}
+
+/*
+ * Open (or create) a roll-up file, returns NULL with errno set (EINVAL
+ *  when the file is not a roll-up file of this layout, EWOULDBLOCK when
+ *  another nmond keeps it)
+ */
+struct rollup *rollupopen(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		return NULL;
+	}
+	int error = 0;
+	if(flock(fd, LOCK_EX | LOCK_NB)) {
+		error = errno;
+		close(fd);
+		errno = error;
+		return NULL;
+	}
+
+	struct stat status;
+	bool created = false;
+	if(fstat(fd, &status)) {
+		error = errno;
+		close(fd);
+		errno = error;
+		return NULL;
+	}
+	if(status.st_size == 0) {
+		if(ftruncate(fd, (off_t)sizeof(struct rollupfile))) {
+			error = errno;
+			close(fd);
+			errno = error;
+			return NULL;
+		}
+		created = true;
+	} else if(status.st_size != (off_t)sizeof(struct rollupfile)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct rollupfile *file = (struct rollupfile *)mmap(NULL, sizeof(struct rollupfile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(file == MAP_FAILED) {
+		error = errno;
+		close(fd);
+		errno = error;
+		return NULL;
+	}
+
+	struct rollupheader *header = &file->header;
+	if(created) {
+		memcpy(header->magic, ROLLUP_MAGIC, sizeof(header->magic));
+		header->version = ROLLUP_VERSION;
+		header->byteorder = ROLLUP_BYTEORDER;
+		header->headersize = sizeof(struct rollupheader);
+		header->bucketsize = sizeof(struct rollupbucket);
+		memcpy(header->slots, rollupslots, sizeof(header->slots));
+	} else if(memcmp(header->magic, ROLLUP_MAGIC, sizeof(header->magic)) || (header->version != ROLLUP_VERSION) || \
+		(header->byteorder != ROLLUP_BYTEORDER) || (header->headersize != sizeof(struct rollupheader)) || \
+		(header->bucketsize != sizeof(struct rollupbucket)) || memcmp(header->slots, rollupslots, sizeof(header->slots))) {
+		munmap(file, sizeof(struct rollupfile));
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	for (int level = 0; level < ROLLUP_LEVELS; ++level) {
+		if((header->head[level] >= rollupslots[level]) || (header->used[level] > rollupslots[level])) {
+			munmap(file, sizeof(struct rollupfile));
+			close(fd);
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	struct rollup *rollup = (struct rollup *)calloc(1, sizeof(struct rollup));
+	if(rollup == NULL) {
+		// TODO: handle memory allocation failure
+		munmap(file, sizeof(struct rollupfile));
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	rollup->fd = fd;
+	rollup->file = file;
+	pthread_mutex_init(&rollup->lock, NULL);
+	return rollup;
+}
+
+/*
+ * Add the metrics set in present (a bit for each metric) to the current
+ *  bucket of every resolution, starting new buckets as time moves on
+ */
+void rollupadd(struct rollup *rollup, time_t time, const double *values, unsigned int present)
+{
+	int bins[ROLLUP_METRICS];
+	for (int metric = 0; metric < ROLLUP_METRICS; ++metric) {
+		if(present & (1U << metric)) {
+			bins[metric] = rollupbin(metric, values[metric]);
+		}
+	}
+
+	pthread_mutex_lock(&rollup->lock);
+	struct rollupheader *header = &rollup->file->header;
+	for (int level = 0; level < ROLLUP_LEVELS; ++level) {
+		struct rollupbucket *ring = rollupring(rollup->file, level);
+		struct rollupbucket *bucket = &ring[header->head[level]];
+
+		// the calendar is only consulted when a bucket is over (or the
+		// clock went back)
+		if(!header->used[level] || (time >= rollup->next[level]) || (time < bucket->start)) {
+			time_t start = rollupstart(level, time, &rollup->next[level]);
+			if(!header->used[level] || (bucket->start != start)) {
+				if(header->used[level]) {
+					header->head[level] = (header->head[level] + 1) % rollupslots[level];
+					bucket = &ring[header->head[level]];
+				}
+				if(header->used[level] < rollupslots[level]) {
+					header->used[level] += 1;
+				}
+				memset(bucket, 0, sizeof(struct rollupbucket));
+				bucket->start = start;
+			}
+		}
+
+		for (int metric = 0; metric < ROLLUP_METRICS; ++metric) {
+			if(present & (1U << metric)) {
+				rollupmetricadd(&bucket->metrics[metric], values[metric], bins[metric]);
+			}
+		}
+	}
+	header->updated = time;
+	pthread_mutex_unlock(&rollup->lock);
+}
+
+/*
+ * Add the metrics of a sample (those which were collected, over an
+ *  interval, so that they have rates)
+ */
+void rollupsample(struct rollup *rollup, struct sysdata *data)
+{
+	double values[ROLLUP_METRICS];
+	unsigned int present = 0;
+
+	if((data->collected & COLLECT_RES) && collectorinterval(data, COLLECT_RES)) {
+		values[ROLLUP_CPUUSER] = data->res.avgpercentuser;
+		values[ROLLUP_CPUSYS] = data->res.avgpercentsys;
+		values[ROLLUP_CPUNICE] = data->res.avgpercentnice;
+		present |= (1U << ROLLUP_CPUUSER) | (1U << ROLLUP_CPUSYS) | (1U << ROLLUP_CPUNICE);
+	}
+	if((data->collected & COLLECT_PROC) && collectorinterval(data, COLLECT_PROC)) {
+		values[ROLLUP_DISKREAD] = (double)collectorrate(data, COLLECT_PROC, data->res.diskuser - data->res.diskuserlast);
+		values[ROLLUP_DISKWRITE] = (double)collectorrate(data, COLLECT_PROC, data->res.diskusew - data->res.diskusewlast);
+		present |= (1U << ROLLUP_DISKREAD) | (1U << ROLLUP_DISKWRITE);
+	}
+	if((data->collected & COLLECT_NET) && collectorinterval(data, COLLECT_NET)) {
+		values[ROLLUP_NETIN] = (double)collectorrate(data, COLLECT_NET, data->net.ibytes - data->net.oldibytes);
+		values[ROLLUP_NETOUT] = (double)collectorrate(data, COLLECT_NET, data->net.obytes - data->net.oldobytes);
+		present |= (1U << ROLLUP_NETIN) | (1U << ROLLUP_NETOUT);
+	}
+
+	if(present) {
+		rollupadd(rollup, data->time, values, present);
+	}
+}
+
+/*
+ * The means of a metric in the newest buckets of a resolution, oldest
+ *  first (returns how many buckets there were, at most count)
+ */
+size_t rollupseries(struct rollup *rollup, int level, int metric, double *values, size_t count)
+{
+	pthread_mutex_lock(&rollup->lock);
+	struct rollupheader *header = &rollup->file->header;
+	struct rollupbucket *ring = rollupring(rollup->file, level);
+	size_t result = (header->used[level] < count) ? header->used[level] : count;
+	size_t slot = header->head[level];
+	for (size_t i = result; i > 0; --i) {
+		struct rollupmetric *summary = &ring[slot].metrics[metric];
+		values[i - 1] = summary->count ? (summary->sum / summary->count) : 0;
+		slot = slot ? (slot - 1) : (rollupslots[level] - 1);
+	}
+	pthread_mutex_unlock(&rollup->lock);
+	return result;
+}
+
+/*
+ * Summarize a metric over the newest buckets of a resolution (false when
+ *  it was not seen in any of them)
+ */
+bool rollupsummary(struct rollup *rollup, int level, size_t buckets, int metric, struct rollupstat *result)
+{
+	struct rollupmetric merged;
+	memset(&merged, 0, sizeof(merged));
+
+	pthread_mutex_lock(&rollup->lock);
+	struct rollupheader *header = &rollup->file->header;
+	struct rollupbucket *ring = rollupring(rollup->file, level);
+	if(buckets > header->used[level]) {
+		buckets = header->used[level];
+	}
+	size_t slot = header->head[level];
+	for (size_t i = 0; i < buckets; ++i) {
+		rollupmerge(&merged, &ring[slot].metrics[metric]);
+		slot = slot ? (slot - 1) : (rollupslots[level] - 1);
+	}
+	pthread_mutex_unlock(&rollup->lock);
+
+	memset(result, 0, sizeof(struct rollupstat));
+	if(!merged.count) {
+		return false;
+	}
+	result->count = merged.count;
+	result->mean = merged.sum / merged.count;
+	result->min = merged.min;
+	result->max = merged.max;
+	result->p50 = rollupquantile(&merged, metric, 0.5);
+	result->p99 = rollupquantile(&merged, metric, 0.99);
+	return true;
+}
+
+/*
+ * Name of the buckets of a resolution (for titles)
+ */
+const char *rollupname(int level)
+{
+	switch(level) {
+		case ROLLUP_MINUTE:
+			return "minutes";
+		case ROLLUP_HOUR:
+			return "hours";
+		case ROLLUP_DAY:
+			return "days";
+		case ROLLUP_MONTH:
+			return "months";
+	}
+	return "live";
+}
+
+void rollupclose(struct rollup *rollup)
+{
+	if(rollup == NULL) {
+		return;
+	}
+	// the mapping is shared, the kernel writes it back after an exit too
+	msync(rollup->file, sizeof(struct rollupfile), MS_ASYNC);
+	munmap(rollup->file, sizeof(struct rollupfile));
+	close(rollup->fd);
+	pthread_mutex_destroy(&rollup->lock);
+	free(rollup);
+}
@@ -0,0 +1,145 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+/**
+ * rollup.h -- keep long-term summaries of the samples
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "collector.h"
+
+// A roll-up file keeps a ring of buckets for each resolution. Every sample
+// is added to the current bucket of each ring, a bucket holds the count,
+// sum, min, max and a quantile sketch of each metric. The file is mapped
+// and has the same size however long it is kept.
+#define ROLLUP_MAGIC "NMONDRUP"
+#define ROLLUP_VERSION 1
+#define ROLLUP_BYTEORDER 0x01020304
+
+// the graphs show the live samples, or one of the resolutions
+#define ROLLUP_LIVE -1
+#define ROLLUP_MINUTE 0
+#define ROLLUP_HOUR 1
+#define ROLLUP_DAY 2
+#define ROLLUP_MONTH 3
+#define ROLLUP_LEVELS 4
+
+// buckets kept for each resolution (2 hours, a week, 3 months, 10 years)
+#define ROLLUP_SLOTS_MINUTE 120
+#define ROLLUP_SLOTS_HOUR 168
+#define ROLLUP_SLOTS_DAY 92
+#define ROLLUP_SLOTS_MONTH 120
+#define ROLLUP_SLOTS (ROLLUP_SLOTS_MINUTE + ROLLUP_SLOTS_HOUR + ROLLUP_SLOTS_DAY + ROLLUP_SLOTS_MONTH)
+
+#define ROLLUP_CPUUSER 0
+#define ROLLUP_CPUSYS 1
+#define ROLLUP_CPUNICE 2
+#define ROLLUP_DISKREAD 3
+#define ROLLUP_DISKWRITE 4
+#define ROLLUP_NETIN 5
+#define ROLLUP_NETOUT 6
+#define ROLLUP_METRICS 7
+
+// statistics which are rolled up, they are collected for every sample
+#define ROLLUP_COLLECT (COLLECT_RES | COLLECT_PROC | COLLECT_NET)
+
+// The sketch counts values in logarithmic bins, two to a doubling above
+// the unit of the metric (so quantiles are within about 20%). Sketches
+// merge by adding their bins, once a bin would overflow all of them are
+// halved and shift is incremented (quantiles only depend on proportions).
+#define ROLLUP_BINS 48
+
+struct rollupmetric {
+	uint32_t count;
+	uint16_t bins[ROLLUP_BINS];
+	uint8_t shift;
+	uint8_t reserved[3];
+	double sum;
+	double min;
+	double max;
+};
+
+struct rollupbucket {
+	int64_t start; // seconds since the epoch, 0 for an unused bucket
+	struct rollupmetric metrics[ROLLUP_METRICS];
+};
+
+struct rollupheader {
+	char magic[8]; // ROLLUP_MAGIC, without a terminator
+	uint32_t version;
+	uint32_t byteorder;
+	uint32_t headersize;
+	uint32_t bucketsize;
+	uint32_t slots[ROLLUP_LEVELS];
+	uint32_t head[ROLLUP_LEVELS]; // the current bucket of each ring
+	uint32_t used[ROLLUP_LEVELS];
+	int64_t updated; // the last sample added
+};
+
+struct rollupfile {
+	struct rollupheader header;
+	struct rollupbucket buckets[ROLLUP_SLOTS]; // the rings, minutes first
+};
+
+struct rollupstat {
+	unsigned long count;
+	double mean;
+	double min;
+	double max;
+	double p50;
+	double p99;
+};
+
+struct rollup {
+	int fd;
+	struct rollupfile *file; // mapped
+	pthread_mutex_t lock; // the sampler adds, the UI thread reads
+	time_t next[ROLLUP_LEVELS]; // start of the bucket after the current
+};
+
+extern struct rollup *rollupopen(const char*);
+extern void rollupadd(struct rollup*, time_t, const double*, unsigned int);
+extern void rollupsample(struct rollup*, struct sysdata*);
+extern size_t rollupseries(struct rollup*, int, int, double*, size_t);
+extern bool rollupsummary(struct rollup*, int, size_t, int, struct rollupstat*);
+extern const char *rollupname(int);
+extern void rollupclose(struct rollup*);
+
+#endif
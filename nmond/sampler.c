@@ -0,0 +1,469 @@
+/**
+ * sampler.c -- Collector thread publishing snapshots to the UI
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sampler.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Create a pipe which never blocks, for waking up a thread in poll()
+ */
+static bool samplerpipe(int fds[2])
+{
+	if(pipe(fds)) {
+		return false;
+	}
+	for (int i = 0; i < 2; ++i) {
+		fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	return true;
+}
+
+/*
+ * Empty a wakeup pipe (any number of wakeups is handled as one)
+ */
+static void samplerdrain(int fd)
+{
+	char buffer[64];
+	while(read(fd, buffer, sizeof(buffer)) > 0) {
+	}
+}
+
+static void samplerpoke(int fd)
+{
+	// a full pipe already has a wakeup pending
+	ssize_t written = write(fd, "", 1);
+	(void)written;
+}
+
+/*
+ * Copy the working data into a snapshot which the UI can keep using
+ *  while the next sample is collected (it owns all of its memory)
+ */
+static void samplercopy(struct sysdata *to, struct sysdata *from, size_t showrows, int (*showcompare)(struct sysproctable*, int, int))
+{
+	// the static facts are only copied again after they were reloaded
+	if(to->reloads != from->reloads) {
+		syshwcopy(&to->hw, &from->hw);
+		syskerncopy(&to->kern, &from->kern);
+		to->reloads = from->reloads;
+	}
+	to->hwdyn = from->hwdyn;
+	to->kerndyn = from->kerndyn;
+	sysrescopy(&to->res, &from->res);
+
+	// the panes only show the network totals, not each interface
+	to->net = from->net;
+	to->net.ifcount = 0;
+	to->net.ifs = NULL;
+
+	if(!sysproctablecopy(&to->procs, &from->procs, showrows, showcompare)) {
+		// TODO: handle memory allocation failure
+		to->procs.count = 0;
+	}
+	// only the counters of the process cache mean anything to the panes
+	to->proccache.live = from->proccache.live;
+	to->proccache.generation = from->proccache.generation;
+	to->proccache.evictions = from->proccache.evictions;
+	to->proccache.sampledhot = from->proccache.sampledhot;
+	to->proccache.sampledcold = from->proccache.sampledcold;
+	to->proccache.cold = from->proccache.cold;
+	to->proccache.uids.hits = from->proccache.uids.hits;
+	to->proccache.uids.misses = from->proccache.uids.misses;
+
+	to->vms = from->vms;
+	to->time = from->time;
+	sysburstcopy(&to->burst, &from->burst);
+	to->collected = from->collected;
+	memcpy(to->intervalns, from->intervalns, sizeof(to->intervalns));
+	memcpy(to->collectns, from->collectns, sizeof(to->collectns));
+}
+
+/*
+ * Hand the working data to the UI thread as the latest snapshot
+ *  (only from the thread which fills the data, see also replay.c)
+ */
+void samplerpublish(struct sampler *sampler)
+{
+	pthread_mutex_lock(&sampler->pinlock);
+	size_t showrows = sampler->showrows;
+	int (*showcompare)(struct sysproctable*, int, int) = sampler->showcompare;
+	pthread_mutex_unlock(&sampler->pinlock);
+
+	samplercopy(&sampler->snapshots[sampler->back], &sampler->data, showrows, showcompare);
+	// the snapshot given back is the one the UI thread skipped (or let go of)
+	sampler->back = atomic_exchange(&sampler->latest, sampler->back | SAMPLER_FRESH) & SAMPLER_INDEX;
+	samplerpoke(sampler->readypipe[1]);
+}
+
+/*
+ * Collect one sample with the settings last requested by the UI thread
+ */
+static void samplersample(struct sampler *sampler)
+{
+	if(atomic_exchange(&sampler->reload, false)) {
+		collectorsreload(&sampler->data);
+	}
+
+	pthread_mutex_lock(&sampler->pinlock);
+	memcpy(sampler->pinned, sampler->pinrequest, sizeof(int) * sampler->pinrequestcount);
+	sampler->data.proccache.pinnedcount = sampler->pinrequestcount;
+	pthread_mutex_unlock(&sampler->pinlock);
+	sampler->data.proccache.pinned = sampler->pinned;
+	sampler->data.proccache.fetchargs = atomic_load(&sampler->fetchargs);
+
+	collectorsrun(&sampler->data, atomic_load(&sampler->collectmask));
+	if(sampler->burst) {
+		burstsummarize(sampler->burst, &sampler->data.burst);
+	}
+	if(sampler->recorder) {
+		recordtick(sampler->recorder, &sampler->data);
+	}
+	if(sampler->rollup) {
+		rollupsample(sampler->rollup, &sampler->data);
+	}
+	metricsrender(sampler->metrics, &sampler->data);
+	sampler->samples += 1;
+	samplerpublish(sampler);
+}
+
+static void *samplermain(void *arg)
+{
+	struct sampler *sampler = (struct sampler *)arg;
+	struct pollfd wake = { sampler->wakepipe[0], POLLIN, 0 };
+	unsigned long long now = 0;
+	unsigned long long intervalns = 0;
+	unsigned long long waitms = 0;
+	int scheduledms = 0;
+	int refreshms = 0;
+
+	for(;;) {
+		samplerdrain(sampler->wakepipe[0]);
+		if(atomic_load(&sampler->quit)) {
+			break;
+		}
+
+		// a new refresh delay counts from the last sample
+		refreshms = atomic_load(&sampler->refreshms);
+		intervalns = (unsigned long long)refreshms * 1000000ULL;
+		if(refreshms != scheduledms) {
+			sampler->nextsample = sampler->lastsample + intervalns;
+			scheduledms = refreshms;
+			if(sampler->burst) {
+				burstrefresh(sampler->burst, refreshms);
+			}
+		}
+
+		// samples are taken at absolute deadlines, so neither the time spent
+		// collecting nor a slow terminal shifts the schedule
+		now = collectorclock();
+		if(atomic_exchange(&sampler->samplenow, false) || (now >= sampler->nextsample)) {
+			samplersample(sampler);
+			sampler->lastsample = now;
+			sampler->nextsample += intervalns;
+			// a forced sample, or one which fell behind (the machine slept),
+			// starts a new schedule instead of catching up on missed samples
+			if(sampler->nextsample <= now) {
+				sampler->nextsample = now + intervalns;
+			}
+			continue;
+		}
+
+		// round up, so that the deadline has passed when poll() times out
+		waitms = (sampler->nextsample - now + 999999) / 1000000;
+		poll(&wake, 1, (int)waitms);
+	}
+	return NULL;
+}
+
+/*
+ * Create a sampler, its data is filled in on the calling thread
+ *  (for the first sample) until samplerstart() hands it to the thread
+ */
+struct sampler *samplernew(int refreshms)
+{
+	struct sampler *sampler = (struct sampler *)calloc(1, sizeof(struct sampler));
+	if(sampler == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+
+	// all zero is the same as SYSDATA_INIT
+	sampler->front = 0;
+	atomic_init(&sampler->latest, 1);
+	sampler->back = 2;
+
+	atomic_init(&sampler->collectmask, COLLECT_ALL);
+	atomic_init(&sampler->fetchargs, false);
+	atomic_init(&sampler->refreshms, refreshms);
+	atomic_init(&sampler->reload, false);
+	atomic_init(&sampler->samplenow, false);
+	atomic_init(&sampler->quit, false);
+	pthread_mutex_init(&sampler->pinlock, NULL);
+	// every record is copied until a consumer says which rows it shows
+	sampler->showrows = SIZE_MAX;
+	sampler->showcompare = NULL;
+
+	if(!samplerpipe(sampler->wakepipe)) {
+		pthread_mutex_destroy(&sampler->pinlock);
+		free(sampler);
+		return NULL;
+	}
+	if(!samplerpipe(sampler->readypipe)) {
+		close(sampler->wakepipe[0]);
+		close(sampler->wakepipe[1]);
+		pthread_mutex_destroy(&sampler->pinlock);
+		free(sampler);
+		return NULL;
+	}
+	return sampler;
+}
+
+/*
+ * Publish the data collected so far and start sampling on a thread
+ */
+bool samplerstart(struct sampler *sampler)
+{
+	sampler->lastsample = collectorclock();
+	sampler->nextsample = sampler->lastsample + ((unsigned long long)atomic_load(&sampler->refreshms) * 1000000ULL);
+	samplerpublish(sampler);
+
+	// signals (resize, reload, interrupt) are left to the UI thread
+	sigset_t blocked;
+	sigset_t previous;
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+	if(sampler->burst && !burststart(sampler->burst)) {
+		// sample without the bursts rather than not at all
+		burstfree(sampler->burst);
+		sampler->burst = NULL;
+	}
+	if(sampler->metrics) {
+		// scrapers are served the data collected so far until the first sample
+		metricsrender(sampler->metrics, &sampler->data);
+		if(!metricsstart(sampler->metrics)) {
+			metricsclose(sampler->metrics);
+			sampler->metrics = NULL;
+		}
+	}
+	sampler->running = !pthread_create(&sampler->thread, NULL, samplermain, sampler);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	return sampler->running;
+}
+
+/*
+ * Also sample the cheap counters hz times a second (before samplerstart),
+ *  each sample then carries a summary of the bursts taken since the last
+ */
+bool samplerburst(struct sampler *sampler, int hz)
+{
+	if(sampler->data.res.cpucount <= 0) {
+		return false;
+	}
+	sampler->burst = burstnew(hz, sampler->data.res.cpucount, atomic_load(&sampler->refreshms));
+	return sampler->burst != NULL;
+}
+
+/*
+ * Also append each sample to a recording (before samplerstart), returns
+ *  false with errno set when the file cannot be recorded to
+ */
+bool samplerrecord(struct sampler *sampler, const char *path)
+{
+	sampler->recorder = recordopen(path, &sampler->data, atomic_load(&sampler->refreshms));
+	return sampler->recorder != NULL;
+}
+
+/*
+ * Also add each sample to the long-term summaries kept in a file (before
+ *  samplerstart), returns false with errno set when it cannot be kept
+ */
+bool samplerrollup(struct sampler *sampler, const char *path)
+{
+	sampler->rollup = rollupopen(path);
+	return sampler->rollup != NULL;
+}
+
+/*
+ * Also serve each sample to OpenMetrics scrapers (before samplerstart),
+ *  returns false with errno set when the address cannot be listened on
+ */
+bool samplermetrics(struct sampler *sampler, const char *address, int topcount)
+{
+	sampler->metrics = metricsopen(address, topcount);
+	return sampler->metrics != NULL;
+}
+
+/*
+ * The newest complete snapshot (fresh is set when it was not seen before)
+ */
+struct sysdata *samplerlatest(struct sampler *sampler, bool *fresh)
+{
+	samplerdrain(sampler->readypipe[0]);
+
+	*fresh = false;
+	if(atomic_load(&sampler->latest) & SAMPLER_FRESH) {
+		sampler->front = atomic_exchange(&sampler->latest, sampler->front) & SAMPLER_INDEX;
+		*fresh = true;
+	}
+	return &sampler->snapshots[sampler->front];
+}
+
+/*
+ * File descriptor which becomes readable when a new snapshot is published
+ */
+int samplerreadyfd(struct sampler *sampler)
+{
+	return sampler->readypipe[0];
+}
+
+/*
+ * Set what the next samples collect (the collectors of the visible panes)
+ */
+void samplerconfigure(struct sampler *sampler, unsigned int collectmask, bool fetchargs)
+{
+	atomic_store(&sampler->collectmask, collectmask);
+	atomic_store(&sampler->fetchargs, fetchargs);
+}
+
+void samplerrefresh(struct sampler *sampler, int refreshms)
+{
+	atomic_store(&sampler->refreshms, refreshms);
+	samplerpoke(sampler->wakepipe[1]);
+}
+
+/*
+ * Take a sample now, without waiting for the next deadline
+ */
+void samplerforce(struct sampler *sampler)
+{
+	atomic_store(&sampler->samplenow, true);
+	samplerpoke(sampler->wakepipe[1]);
+}
+
+/*
+ * Re-read the static facts with the next sample (which is taken now)
+ */
+void samplerreload(struct sampler *sampler)
+{
+	atomic_store(&sampler->reload, true);
+	samplerforce(sampler);
+}
+
+/*
+ * Keep the processes in the first rows of a displayed table in the hot tier
+ */
+void samplerpin(struct sampler *sampler, struct sysproctable *table, size_t rows)
+{
+	if(rows > table->count) {
+		rows = table->count;
+	}
+	if(rows > SAMPLER_PINNED_MAX) {
+		rows = SAMPLER_PINNED_MAX;
+	}
+
+	pthread_mutex_lock(&sampler->pinlock);
+	for (size_t i = 0; i < rows; ++i) {
+		sampler->pinrequest[i] = table->pid[table->order[i]];
+	}
+	sampler->pinrequestcount = rows;
+	pthread_mutex_unlock(&sampler->pinlock);
+}
+
+/*
+ * Only copy the records of the first rows by compare into the snapshots
+ *  (the rows the top pane shows, SIZE_MAX for every record), a different
+ *  request takes a sample now so that the rows shown soon have records
+ */
+void samplershow(struct sampler *sampler, size_t rows, int (*compare)(struct sysproctable*, int, int))
+{
+	pthread_mutex_lock(&sampler->pinlock);
+	bool changed = (sampler->showrows != rows) || (sampler->showcompare != compare);
+	sampler->showrows = rows;
+	sampler->showcompare = compare;
+	pthread_mutex_unlock(&sampler->pinlock);
+
+	if(changed) {
+		samplerforce(sampler);
+	}
+}
+
+void samplerfree(struct sampler *sampler)
+{
+	if(sampler == NULL) {
+		return;
+	}
+
+	if(sampler->running) {
+		atomic_store(&sampler->quit, true);
+		samplerpoke(sampler->wakepipe[1]);
+		pthread_join(sampler->thread, NULL);
+	}
+	burstfree(sampler->burst);
+	recordclose(sampler->recorder);
+	rollupclose(sampler->rollup);
+	metricsclose(sampler->metrics);
+	close(sampler->wakepipe[0]);
+	close(sampler->wakepipe[1]);
+	close(sampler->readypipe[0]);
+	close(sampler->readypipe[1]);
+	pthread_mutex_destroy(&sampler->pinlock);
+
+	// each snapshot owns a copy of everything which is not a plain value
+	for (int i = 0; i < 3; ++i) {
+		struct sysdata *snapshot = &sampler->snapshots[i];
+		syshwfree(&snapshot->hw);
+		syskernfree(&snapshot->kern);
+		sysresfree(&snapshot->res);
+		sysproctablefree(&snapshot->procs);
+		sysburstfree(&snapshot->burst);
+	}
+	// and the working data owns the caches the rows point into
+	syshwfree(&sampler->data.hw);
+	syskernfree(&sampler->data.kern);
+	sysresfree(&sampler->data.res);
+	sysproctablefree(&sampler->data.procs);
+	sysproccachefree(&sampler->data.proccache);
+	sysburstfree(&sampler->data.burst);
+	free(sampler);
+}
@@ -0,0 +1,116 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/**
+ * sampler.h -- Collector thread publishing snapshots to the UI
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "collector.h"
+#include "metrics.h"
+#include "record.h"
+#include "rollup.h"
+
+// most processes shown by the top pane which are kept in the hot tier
+#define SAMPLER_PINNED_MAX 512
+// the latest snapshot is flagged until the UI thread picks it up
+#define SAMPLER_FRESH 0x4
+#define SAMPLER_INDEX 0x3
+
+// The sampler thread owns data (and the caches in it). After each sample
+// it copies data into its back snapshot and swaps that with the latest
+// one; the UI thread swaps the latest with its front snapshot when it is
+// flagged fresh. Neither thread ever waits for the other (triple buffer).
+struct sampler {
+	struct sysdata data;
+	struct sysdata snapshots[3];
+	atomic_uint latest; // snapshot index, and SAMPLER_FRESH until picked up
+	unsigned int back; // owned by the sampler thread
+	unsigned int front; // owned by the UI thread
+
+	// requests from the UI thread, read before each sample
+	atomic_uint collectmask;
+	atomic_bool fetchargs;
+	atomic_int refreshms;
+	atomic_bool reload;
+	atomic_bool samplenow;
+	atomic_bool quit;
+
+	// PIDs shown by the top pane (only held for a short copy), and the
+	// rows whose records are copied into the snapshots
+	pthread_mutex_t pinlock;
+	int pinrequest[SAMPLER_PINNED_MAX];
+	size_t pinrequestcount;
+	int pinned[SAMPLER_PINNED_MAX];
+	size_t showrows;
+	int (*showcompare)(struct sysproctable*, int, int);
+
+	struct burst *burst; // burst sampling thread, NULL when it is off (-z)
+	struct recorder *recorder; // appends each sample to a file, NULL when off (-o)
+	struct rollup *rollup; // long-term summaries, NULL when off (-R)
+	struct metrics *metrics; // OpenMetrics served to scrapers, NULL when off (-M)
+
+	int wakepipe[2]; // wakes the sampler thread for a request
+	int readypipe[2]; // wakes the UI thread for a new snapshot
+
+	pthread_t thread;
+	bool running;
+	unsigned long long nextsample; // deadline of the next sample (monotonic ns)
+	unsigned long long lastsample;
+	unsigned long samples;
+};
+
+extern struct sampler *samplernew(int);
+extern bool samplerburst(struct sampler*, int);
+extern bool samplerrecord(struct sampler*, const char*);
+extern bool samplerrollup(struct sampler*, const char*);
+extern bool samplermetrics(struct sampler*, const char*, int);
+extern bool samplerstart(struct sampler*);
+extern void samplerpublish(struct sampler*);
+extern struct sysdata *samplerlatest(struct sampler*, bool*);
+extern int samplerreadyfd(struct sampler*);
+extern void samplerconfigure(struct sampler*, unsigned int, bool);
+extern void samplerrefresh(struct sampler*, int);
+extern void samplerforce(struct sampler*);
+extern void samplerreload(struct sampler*);
+extern void samplerpin(struct sampler*, struct sysproctable*, size_t);
+extern void samplershow(struct sampler*, size_t, int (*)(struct sysproctable*, int, int));
+extern void samplerfree(struct sampler*);
+
+#endif
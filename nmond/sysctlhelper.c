@@ -37,6 +37,7 @@
  */
 
 #include "sysctlhelper.h"
+#include "procargs.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <sys/sysctl.h>
@@ -218,15 +219,15 @@ char *timeStringFromTimestamp(time_t timet, char *format)
  */
 void processArguments(int pid, int sizelimit, char *resultLoc)
 {
-	int mib[4];
+	int mib[3];
 	mib[0] = CTL_KERN;
-	mib[1] = KERN_PROCARGS;//KERN_PROCARGS2;
+	mib[1] = KERN_PROCARGS2;
 	mib[2] = pid;
 	size_t templength = 0;
 	int error = 0;
 	char *arglist = NULL;
 
-	error = sysctl(mib, 4, NULL, &templength, NULL, 0);
+	error = sysctl(mib, 3, NULL, &templength, NULL, 0);
 	// allocate memory for the result
 	if(!error) {
 		arglist = malloc(templength);
@@ -235,83 +236,11 @@ void processArguments(int pid, int sizelimit, char *resultLoc)
 		}
 	}
 
-	// get the result
+	// get the result, then format it in place (the buffer is not copied)
 	if(!error) {
 		error = sysctl(mib, 3, arglist, &templength, NULL, 0);
-
 		if(!error) {
-			//
-			// TODO: merge loops together
-			//
-			int argcount = 0;
-			static int argstarts[1024];
-			int argstart = 0;
-			static int argsizes[1024];
-			int argsize = -1;
-			int skipcount = 0;
-			for(int i = 0; i < (int)templength; ++i) {
-				if(arglist[i] == '\0') {
-
-					if(arglist[i-1] == '\0') {
-						++skipcount;
-					} else {
-						argstarts[argcount] = argstart + skipcount;
-						argstart = i + 1;
-
-						argsizes[argcount] = i - (argsize + skipcount + 1);
-						argsize = i;
-
-						skipcount = 0;
-						++argcount;
-					}
-				} else if(arglist[i] == '/') {
-					// argstart = i + 1;
-					// argsize = i;
-				} else if(arglist[i] == '=') {
-					break;
-				}
-			}
-
-			int resultlen = 0;
-			int resultoffset = 0;
-
-			for(int argno = 1; argno < argcount; ++argno) {
-				resultlen += (argsizes[argno] + 1);
-			}
-
-			if(resultlen > sizelimit) {
-				resultoffset = resultlen - sizelimit + TRUNC_STRING_LENGTH;
-				resultlen = sizelimit - TRUNC_STRING_LENGTH;
-			}
-
-			int currentarg = 1;
-			int currentargpos = argstarts[currentarg];
-			char currentchar = 0;
-
-			int stringpos = 0;
-
-			for(int i = 0; i < (int)(resultoffset + resultlen - 1); ++i) {
-				currentchar = arglist[currentargpos];
-
-				if(i >= resultoffset) {
-					if(currentchar != '\0'){
-						resultLoc[stringpos] = currentchar;
-					} else {
-						resultLoc[stringpos] = ' ';
-					}
-					++stringpos;
-				} else if (i >= (resultoffset - TRUNC_STRING_LENGTH)) {
-					resultLoc[stringpos] = TRUNC_CHAR;
-					++stringpos;
-				}
-
-				++currentargpos;
-				if(currentargpos > (argstarts[currentarg] + argsizes[currentarg])) {
-					++currentarg;
-					currentargpos = argstarts[currentarg];
-				}
-			}
-			resultLoc[stringpos] = '\0';
+			procargsformat(arglist, templength, resultLoc, (size_t)sizelimit);
 		}
 		free(arglist);
 	}
@@ -41,9 +41,6 @@
 #include <stdint.h>
 #include <time.h>
 
-#define TRUNC_STRING_LENGTH 3
-#define TRUNC_CHAR '.'
-
 extern char *stringFromSysctl(int, int);
 extern char *stringFromSysctlByName(char*);
 extern unsigned int intFromSysctl(int, int);
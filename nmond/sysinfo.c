@@ -36,14 +36,14 @@
  */
 
 #include "sysinfo.h"
-#include <assert.h>
 #include <errno.h>
 #include <ifaddrs.h>
 #include <libproc.h>
-#include <pwd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
+#include <net/if.h>
+#include <net/route.h>
 #include <mach/host_info.h>
 #include <mach/mach.h>
 #include <mach/mach_host.h>
@@ -56,9 +56,10 @@
 #include <sys/time.h>
 
 #include "sysctlhelper.h"
+#include "workpool.h"
 
 /*
- * Get all hardware information from sysctl
+ * Get all static hardware information from sysctl
  */
 void getsyshwinfo(struct syshw *hw)
 {
@@ -66,11 +67,11 @@ void getsyshwinfo(struct syshw *hw)
 	hw->cpufrequencymin = intFromSysctlByName("hw.cpufrequency_min");
 	hw->cpufrequencymax = intFromSysctlByName("hw.cpufrequency_max");
 	hw->cpucount = intFromSysctlByName("hw.ncpu");
-	hw->cpuactive = intFromSysctlByName("hw.activecpu");
 	hw->physicalcpucount = intFromSysctlByName("hw.physicalcpu");
 	hw->physicalcpumax = intFromSysctlByName("hw.physicalcpu_max");
 	hw->logicalcpucount = intFromSysctlByName("hw.logicalcpu");
 	hw->logicalcpumax = intFromSysctlByName("hw.logicalcpu_max");
+	hw->packages = intFromSysctlByName("hw.packages");
 
 	hw->byteorder = intFromSysctl(CTL_HW, HW_BYTEORDER);
 	hw->memorysize = int64FromSysctlByName("hw.memsize");
@@ -78,9 +79,6 @@ void getsyshwinfo(struct syshw *hw)
 	hw->pagesize = intFromSysctl(CTL_HW, HW_PAGESIZE);
 
 	hw->thermalsensor = intFromSysctlByName("machdep.cpu.thermal.sensor");
-	hw->thermallevelcpu = intFromSysctlByName("machdep.xcpm.cpu_thermal_level");
-	hw->thermallevelgpu = intFromSysctlByName("machdep.xcpm.gpu_thermal_level");
-	hw->thermallevelio = intFromSysctlByName("machdep.xcpm.io_thermal_level");
 
 	free(hw->architecture);
 	hw->architecture = stringFromSysctl(CTL_HW, HW_MACHINE_ARCH);
@@ -106,7 +104,64 @@ void getsyshwinfo(struct syshw *hw)
 }
 
 /*
- * Get all hernel information from sysctl
+ * Copy a string which is owned by the destination (freeing its old one)
+ */
+static char *sysstringcopy(char *to, const char *from)
+{
+	free(to);
+	if(from == NULL) {
+		return NULL;
+	}
+	// TODO: handle memory allocation failure
+	return strdup(from);
+}
+
+/*
+ * Copy static hardware information, the copy owns its own strings
+ *  (the originals are freed when the facts are reloaded)
+ */
+void syshwcopy(struct syshw *to, struct syshw *from)
+{
+	struct syshw old = *to;
+	*to = *from;
+	to->architecture = sysstringcopy(old.architecture, from->architecture);
+	to->cpuvendor = sysstringcopy(old.cpuvendor, from->cpuvendor);
+	to->cpubrand = sysstringcopy(old.cpubrand, from->cpubrand);
+	to->machine = sysstringcopy(old.machine, from->machine);
+	to->model = sysstringcopy(old.model, from->model);
+}
+
+/*
+ * Free the strings owned by hardware information (see syshwcopy)
+ */
+void syshwfree(struct syshw *hw)
+{
+	free(hw->architecture);
+	free(hw->cpuvendor);
+	free(hw->cpubrand);
+	free(hw->machine);
+	free(hw->model);
+	hw->architecture = NULL;
+	hw->cpuvendor = NULL;
+	hw->cpubrand = NULL;
+	hw->machine = NULL;
+	hw->model = NULL;
+}
+
+/*
+ * Get the hardware information which changes at runtime from sysctl
+ */
+void getsyshwdyninfo(struct syshwdyn *hwdyn)
+{
+	hwdyn->cpuactive = intFromSysctlByName("hw.activecpu");
+
+	hwdyn->thermallevelcpu = intFromSysctlByName("machdep.xcpm.cpu_thermal_level");
+	hwdyn->thermallevelgpu = intFromSysctlByName("machdep.xcpm.gpu_thermal_level");
+	hwdyn->thermallevelio = intFromSysctlByName("machdep.xcpm.io_thermal_level");
+}
+
+/*
+ * Get all static kernel information from sysctl
  */
 void getsyskerninfo(struct syskern *kern)
 {
@@ -156,15 +211,57 @@ void getsyskerninfo(struct syskern *kern)
 
 	free(kern->boottimestring);
 	kern->boottimestring = timeStringFromTimestamp(kern->boottime.tv_sec, DATE_TIME_FORMAT);
+}
+
+/*
+ * Copy static kernel information, the copy owns its own strings
+ */
+void syskerncopy(struct syskern *to, struct syskern *from)
+{
+	struct syskern old = *to;
+	*to = *from;
+	to->ostype = sysstringcopy(old.ostype, from->ostype);
+	to->osrelease = sysstringcopy(old.osrelease, from->osrelease);
+	to->osversion = sysstringcopy(old.osversion, from->osversion);
+	to->version = sysstringcopy(old.version, from->version);
+	to->bootfile = sysstringcopy(old.bootfile, from->bootfile);
+	to->hostname = sysstringcopy(old.hostname, from->hostname);
+	to->domainname = sysstringcopy(old.domainname, from->domainname);
+	to->boottimestring = sysstringcopy(old.boottimestring, from->boottimestring);
+}
 
-	// struct timeval tv;
-	// gettimeofday(&tv, NULL);
-	// kern->uptime = sinfo.uptime;
-	// timet = kern->uptime.tv_sec - kern->boottime.tv_sec;
-	// ptm = localtime(&timet);
-	// char uptimestring[64];
-	// strftime(uptimestring, sizeof(uptimestring), "%Y-%m-%d %H:%M:%S", ptm);
-	// kern->uptimestring = uptimestring;
+/*
+ * Free the strings owned by kernel information (see syskerncopy)
+ */
+void syskernfree(struct syskern *kern)
+{
+	free(kern->ostype);
+	free(kern->osrelease);
+	free(kern->osversion);
+	free(kern->version);
+	free(kern->bootfile);
+	free(kern->hostname);
+	free(kern->domainname);
+	free(kern->boottimestring);
+	kern->ostype = NULL;
+	kern->osrelease = NULL;
+	kern->osversion = NULL;
+	kern->version = NULL;
+	kern->bootfile = NULL;
+	kern->hostname = NULL;
+	kern->domainname = NULL;
+	kern->boottimestring = NULL;
+}
+
+/*
+ * Get the kernel information which changes at runtime
+ *  (derived from the static boot time, so no sysctl is needed)
+ */
+void getsyskerndyninfo(struct syskerndyn *kerndyn, struct syskern *kern)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	timersub(&now, &kern->boottime, &kerndyn->uptime);
 }
 
 //
@@ -311,6 +408,59 @@ void getsysresinfo(struct sysres *inres)
 	vm_deallocate(mach_task_self(), (vm_address_t)hostinfo, count);
 }
 
+/*
+ * Copy resource utilization, the copy owns its own per CPU array
+ */
+void sysrescopy(struct sysres *to, struct sysres *from)
+{
+	struct sysrescpu *cpus = to->cpus;
+	if((to->cpucount != from->cpucount) || (cpus == NULL)) {
+		cpus = (struct sysrescpu *)realloc(to->cpus, sizeof(struct sysrescpu) * (size_t)(from->cpucount ? from->cpucount : 1));
+		if(cpus == NULL) {
+			// TODO: handle memory allocation failure
+			return;
+		}
+	}
+
+	*to = *from;
+	to->cpus = cpus;
+	if(from->cpus && from->cpucount) {
+		memcpy(to->cpus, from->cpus, sizeof(struct sysrescpu) * (size_t)from->cpucount);
+	}
+}
+
+void sysresfree(struct sysres *res)
+{
+	free(res->cpus);
+	res->cpus = NULL;
+}
+
+/*
+ * Read only the tick counters of each CPU (cheap enough for burst sampling),
+ *  returns the number of CPUs read
+ */
+int getsyscputicks(struct syscputicks *ticks, int maxcpus)
+{
+	natural_t cpucount = 0;
+	processor_info_array_t cpuinfo = NULL;
+	mach_msg_type_number_t infocount = 0;
+	if(host_processor_info(mach_host_self(), PROCESSOR_CPU_LOAD_INFO, &cpucount, &cpuinfo, &infocount)) {
+		return 0;
+	}
+
+	processor_cpu_load_info_data_t *load = (processor_cpu_load_info_data_t *)cpuinfo;
+	int count = ((int)cpucount < maxcpus) ? (int)cpucount : maxcpus;
+	for (int cpuno = 0; cpuno < count; ++cpuno) {
+		ticks[cpuno].user = load[cpuno].cpu_ticks[CPU_STATE_USER];
+		ticks[cpuno].sys = load[cpuno].cpu_ticks[CPU_STATE_SYSTEM];
+		ticks[cpuno].idle = load[cpuno].cpu_ticks[CPU_STATE_IDLE];
+		ticks[cpuno].nice = load[cpuno].cpu_ticks[CPU_STATE_NICE];
+	}
+
+	vm_deallocate(mach_task_self(), (vm_address_t)cpuinfo, (vm_size_t)infocount * sizeof(integer_t));
+	return count;
+}
+
 /*
  * Get Mach Virtual Memory Statistics
  *
@@ -334,41 +484,111 @@ unsigned long long getsysvminfo()
 //
 
 /*
- * Convert kinfo_proc data structure into a simple sysproc data structure
+ * Take a zeroed process record from the free list, adding a slab when empty
  */
-static struct sysproc **sysprocfromkinfoproc(struct kinfo_proc *processes, int count, struct sysproc **procsin, struct hashitem **hashtable, double cpupercent, struct sysres *res)
+static struct sysproc *sysprocalloc(struct sysproccache *cache)
 {
-	// struct sysproc **procsin;
-	if(procsin == NULL) {
-		procsin = (struct sysproc **)malloc(sizeof(struct sysproc*) * (size_t)count);
-		if(procsin == NULL) {
+	if(cache->freelist == NULL) {
+		struct sysprocslab *slab = (struct sysprocslab *)malloc(sizeof(struct sysprocslab));
+		if(slab == NULL) {
 			// TODO: handle memory allocation failure
+			return NULL;
 		}
-	} else {
-		struct sysproc **procsold = procsin;
-		procsin = (struct sysproc **)realloc(procsold, sizeof(struct sysproc*) * (size_t)count);
-		if(!procsin) {
-			// TODO: handle error and memory leak
+		slab->next = cache->slabs;
+		cache->slabs = slab;
+
+		for (int i = SYSPROC_SLAB_SIZE - 1; i >= 0; --i) {
+			slab->procs[i].nextfree = cache->freelist;
+			cache->freelist = &slab->procs[i];
 		}
+		cache->free += SYSPROC_SLAB_SIZE;
 	}
 
-	int error = 0;
-	struct rusage_info_v3 rusage;
+	struct sysproc *procinfo = cache->freelist;
+	cache->freelist = procinfo->nextfree;
+	cache->free -= 1;
+	cache->live += 1;
 
-	unsigned int totaldiskr = 0;
-	unsigned int totaldiskw = 0;
-	unsigned long long totalmem = 0;
-	unsigned long long totalgpu = 0;
+	memset(procinfo, 0, sizeof(struct sysproc));
+	return procinfo;
+}
 
-	unsigned long long total = 0;
-	unsigned long long oldtotal = 0;
+/*
+ * Reclaim the records of processes which were not seen in the last walk
+ */
+static void sysprocsweep(struct sysproccache *cache)
+{
+	struct sysproc *stale = NULL;
+	struct sysproc *procinfo = NULL;
+	size_t iter = 0;
 
+	// the hash table cannot change while iterating, so list the stale records first
+	while((procinfo = (struct sysproc *)hashtnext(cache->hash, &iter, NULL))) {
+		if(procinfo->generation != cache->generation) {
+			procinfo->nextfree = stale;
+			stale = procinfo;
+		}
+	}
+
+	cache->evictions = 0;
+	while(stale) {
+		procinfo = stale;
+		stale = stale->nextfree;
+
+		hashtdel(cache->hash, procinfo->pid);
+		procinfo->nextfree = cache->freelist;
+		cache->freelist = procinfo;
+		cache->free += 1;
+		cache->live -= 1;
+		cache->evictions += 1;
+	}
+}
+
+struct sysprocjob {
+	struct sysproctable *table;
+	struct sysproccache *cache;
+	int count; // entries in table->sample
+	unsigned long long now; // when this walk started sampling (ns)
+};
+
+/*
+ * Convert mach absolute time units to nanoseconds
+ */
+static unsigned long long sysprocnanoseconds(struct sysproccache *cache, unsigned long long ticks)
+{
+	if(cache->timebasenumer == cache->timebasedenom) {
+		return ticks;
+	}
+	return (ticks * cache->timebasenumer) / cache->timebasedenom;
+}
+
+/*
+ * Sample the counters of the processes in this worker's share of the rows
+ *  (system calls only, each row is written by exactly one worker)
+ */
+static void sysprocsample(void *jobarg, int worker, int workers)
+{
+	struct sysprocjob *job = (struct sysprocjob *)jobarg;
+	struct sysproctable *table = job->table;
+	struct sysproccache *cache = job->cache;
+
+	int first = (int)(((long long)job->count * worker) / workers);
+	int last = (int)(((long long)job->count * (worker + 1)) / workers);
+
+	int error = 0;
+	int row = 0;
+	struct rusage_info_v3 rusage;
 	struct sysproc *procinfo = NULL;
-	for (int i = 0; i < count; ++i) {
+
+	for (int i = first; i < last; ++i) {
+		row = table->sample[i];
+		procinfo = table->records[row];
+
 		kern_return_t task_name_eror;
 		task_name_t task;
-		task_name_eror = task_name_for_pid(mach_task_self(), processes[i].kp_proc.p_pid, &task);
+		task_name_eror = task_name_for_pid(mach_task_self(), procinfo->pid, &task);
 
+		procinfo->gpuuse = 0;
 		if (task_name_eror == KERN_SUCCESS) {
 			kern_return_t task_info_error;
 			task_power_info_v2_data_t power_info_data_v2;
@@ -376,18 +596,214 @@ static struct sysproc **sysprocfromkinfoproc(struct kinfo_proc *processes, int c
 			task_info_error = task_info(task, TASK_POWER_INFO_V2, (task_info_t)&power_info_data_v2, &tpi_count);
 
 			if (task_info_error == KERN_SUCCESS) {
-				totalgpu += power_info_data_v2.gpu_energy.task_gpu_utilisation;
+				procinfo->gpuuse = power_info_data_v2.gpu_energy.task_gpu_utilisation;
 			}
+			mach_port_deallocate(mach_task_self(), task);
 		}
 
-		procinfo = (struct sysproc *)hashtget(*hashtable, processes[i].kp_proc.p_pid);
+		// arguments do not change, so they are only read for new processes
+		// (a reused PID resets the record), the name stands in until then
+		if(cache->fetchargs && !procinfo->pathfetched) {
+			procinfo->path[0] = '\0';
+			processArguments(procinfo->pid, SYSPROC_PATH_LENGTH, procinfo->path);
+			procinfo->pathfetched = true;
+		}
+		if(procinfo->path[0] == '\0') {
+			strlcpy(procinfo->path, procinfo->name, sizeof(procinfo->path));
+		}
+
+		procinfo->lasttotaltime = procinfo->totaltime;
+
+		// get additional info not available from sysctl
+		error = proc_pid_rusage(procinfo->pid, RUSAGE_INFO_V3, (rusage_info_t *)&rusage);
+		if(!error) {
+			//
+			// resource.h
+			//
+			// times are in mach units (which are not nanoseconds on arm64)
+			procinfo->utime = sysprocnanoseconds(cache, rusage.ri_user_time);
+			procinfo->stime = sysprocnanoseconds(cache, rusage.ri_system_time);
+			procinfo->totaltime = procinfo->utime + procinfo->stime;
+			procinfo->idlewakeups = rusage.ri_pkg_idle_wkups;
+
+			procinfo->wiredmem = rusage.ri_wired_size;
+			procinfo->residentmem = rusage.ri_resident_size;
+			procinfo->physicalmem = rusage.ri_phys_footprint;
+			procinfo->diskior = rusage.ri_diskio_bytesread;
+			procinfo->diskiow = rusage.ri_diskio_byteswritten;
+			procinfo->billedtime = rusage.ri_billed_system_time;
+		} else {
+			procinfo->utime = 0;
+			procinfo->stime = 0;
+			procinfo->totaltime = 0;
+			procinfo->idlewakeups = 0;
+
+			procinfo->wiredmem = 0;
+			procinfo->residentmem = 0;
+			procinfo->physicalmem = 0;
+			procinfo->diskior = 0;
+			procinfo->diskiow = 0;
+			procinfo->billedtime = 0;
+		}
+
+		// the CPU use is measured over the time since this process was last
+		// sampled, which is several walks for processes in the cold tier, as
+		// a share of all CPUs (like the total, so it stays within 0-100%)
+		procinfo->percentage = 0;
+		if(procinfo->sampletime) {
+			if(procinfo->totaltime > procinfo->lasttotaltime) {
+				if(job->now > procinfo->sampletime) {
+					procinfo->percentage = ((double)(procinfo->totaltime - procinfo->lasttotaltime) * 100) / ((double)(job->now - procinfo->sampletime) * cache->cpucount);
+				}
+				procinfo->idleticks = 0;
+			} else if(procinfo->idleticks < SYSPROC_COLD_TICKS) {
+				procinfo->idleticks += 1;
+			}
+		} else {
+			procinfo->lasttotaltime = procinfo->totaltime;
+		}
+		procinfo->sampletime = job->now;
+
+		table->percentage[row] = procinfo->percentage;
+		table->totaltime[row] = procinfo->totaltime;
+		table->lasttotaltime[row] = procinfo->lasttotaltime;
+		table->residentmem[row] = procinfo->residentmem;
+		table->physicalmem[row] = procinfo->physicalmem;
+		table->diskior[row] = procinfo->diskior;
+		table->diskiow[row] = procinfo->diskiow;
+		table->gpuuse[row] = procinfo->gpuuse;
+	}
+}
+
+/*
+ * Is the process in the cold tier (sampled round-robin every few walks)
+ */
+static bool sysprociscold(struct sysproc *procinfo)
+{
+	return procinfo->sampletime && (procinfo->idleticks >= SYSPROC_COLD_TICKS);
+}
+
+/*
+ * Choose the rows to sample this walk, every hot row and a round-robin
+ *  share of the cold rows, within the budget (returns the number chosen)
+ */
+static int sysprocschedule(struct sysproctable *table, struct sysproccache *cache, int count)
+{
+	if(count <= 0) {
+		cache->sampledhot = 0;
+		cache->sampledcold = 0;
+		cache->cold = 0;
+		return 0;
+	}
+
+	size_t budget = cache->budget ? cache->budget : (size_t)count;
+	size_t sampled = 0;
+	size_t cold = 0;
+	bool deferred = false;
+	int row = 0;
+
+	// hot rows first, a walk which runs out of budget leaves
+	// the rest for the next walk to start with
+	int start = (int)(cache->hotnext % (size_t)count);
+	cache->hotnext = 0;
+	for (int i = 0; i < count; ++i) {
+		row = (start + i) % count;
+		if(sysprociscold(table->records[row])) {
+			cold += 1;
+		} else if(sampled < budget) {
+			table->sample[sampled++] = row;
+		} else if(!deferred) {
+			cache->hotnext = (size_t)row;
+			deferred = true;
+		}
+	}
+	cache->sampledhot = sampled;
+
+	// enough cold rows to visit each of them about once an interval
+	size_t quota = (cold + SYSPROC_COLD_INTERVAL - 1) / SYSPROC_COLD_INTERVAL;
+	if(quota > budget - sampled) {
+		quota = budget - sampled;
+	}
+	start = (int)(cache->coldnext % (size_t)count);
+	for (int i = 0; (i < count) && quota; ++i) {
+		row = (start + i) % count;
+		if(sysprociscold(table->records[row])) {
+			table->sample[sampled++] = row;
+			cache->coldnext = (size_t)row + 1;
+			quota -= 1;
+		}
+	}
+	cache->sampledcold = sampled - cache->sampledhot;
+	cache->cold = cold;
+
+	return (int)sampled;
+}
+
+/*
+ * Convert kinfo_proc data structure into a simple sysproc data structure
+ */
+static void sysprocfromkinfoproc(struct kinfo_proc *processes, int count, struct sysproctable *table, struct sysproccache *cache, struct sysres *res)
+{
+	if(!cache->timebasedenom) {
+		mach_timebase_info_data_t timebase;
+		if((mach_timebase_info(&timebase) != KERN_SUCCESS) || !timebase.denom) {
+			timebase.numer = 1;
+			timebase.denom = 1;
+		}
+		cache->timebasenumer = timebase.numer;
+		cache->timebasedenom = timebase.denom;
+	}
+	if(!cache->cpucount) {
+		cache->cpucount = (unsigned int)intFromSysctlByName("hw.logicalcpu");
+		if(!cache->cpucount) {
+			cache->cpucount = 1;
+		}
+	}
+
+	// the processes shown by the top pane are kept in the hot tier
+	struct sysproc *procinfo = NULL;
+	for (size_t i = 0; i < cache->pinnedcount; ++i) {
+		procinfo = (struct sysproc *)hashtget(cache->hash, cache->pinned[i]);
+		if(procinfo) {
+			procinfo->idleticks = 0;
+		}
+	}
+
+	if(!sysproctablereserve(table, (size_t)count)) {
+		// TODO: handle memory allocation failure
+		count = (int)table->capacity;
+	}
+
+	// records not stamped with this generation are reclaimed after the walk
+	cache->generation += 1;
+	// user names are cached across walks, drop them if the users changed
+	uidcacherefresh(&cache->uids);
+
+	// the PID table, free list and user names are not thread safe,
+	// so match the processes to their records on this thread first
+	for (int i = 0; i < count; ++i) {
+		procinfo = (struct sysproc *)hashtget(cache->hash, processes[i].kp_proc.p_pid);
 		if(!procinfo) {
-			procinfo = (struct sysproc *)calloc(sizeof(struct sysproc), 1);
-			procinfo->path = malloc(SYSPROC_PATH_LENGTH + 1);
-			procinfo->realusername = malloc(SYSPROC_REAL_USER_NAME_LENGTH + 1);
-			hashtadd(*hashtable, processes[i].kp_proc.p_pid, procinfo);
+			procinfo = sysprocalloc(cache);
+			if(procinfo == NULL) {
+				// TODO: handle memory allocation failure
+				count = i;
+				break;
+			}
+			hashtadd(cache->hash, processes[i].kp_proc.p_pid, procinfo);
+		} else if(timercmp(&procinfo->starttime, &processes[i].kp_proc.p_starttime, !=)) {
+			// the PID was reused by a new process, do not inherit the old counters
+			struct sysproc *nextfree = procinfo->nextfree;
+			memset(procinfo, 0, sizeof(struct sysproc));
+			procinfo->nextfree = nextfree;
 		}
+		procinfo->generation = cache->generation;
+		procinfo->starttime = processes[i].kp_proc.p_starttime;
 
+		// a process which changed state is probably doing something again
+		if(procinfo->status != processes[i].kp_proc.p_stat) {
+			procinfo->idleticks = 0;
+		}
 		//
 		// sysctl.h > proc.h
 		//
@@ -409,8 +825,8 @@ static struct sysproc **sysprocfromkinfoproc(struct kinfo_proc *processes, int c
 		procinfo->priority = processes[i].kp_proc.p_priority;
 		// "nice" value
 		procinfo->nice = processes[i].kp_proc.p_nice;
-		// Process name
-		procinfo->name = processes[i].kp_proc.p_comm;
+		// Process name (copied, the kinfo_proc buffer is reused)
+		strlcpy(procinfo->name, processes[i].kp_proc.p_comm, sizeof(procinfo->name));
 
 		//
 		// sysctl.h
@@ -418,14 +834,11 @@ static struct sysproc **sysprocfromkinfoproc(struct kinfo_proc *processes, int c
 		// process credentials, real user id
 		procinfo->realuid = processes[i].kp_eproc.e_pcred.p_ruid;
 		// real username
-		struct passwd *realuser = getpwuid(procinfo->realuid);
-		// procinfo->realusername = realuser->pw_name;
-		strlcpy(procinfo->realusername, realuser->pw_name, sizeof(procinfo->realusername)+1);
+		procinfo->realusername = uidcachename(&cache->uids, procinfo->realuid);
 		// current credentials, effective user id
 		procinfo->effectiveuid = processes[i].kp_eproc.e_ucred.cr_uid;
 		// effectiver user, name
-		struct passwd *effectiveuser = getpwuid(processes[i].kp_eproc.e_ucred.cr_uid);
-		procinfo->effectiveusername = effectiveuser->pw_name;
+		procinfo->effectiveusername = uidcachename(&cache->uids, procinfo->effectiveuid);
 		// parent process id
 		procinfo->parentpid = processes[i].kp_eproc.e_ppid;
 		// Process group identifier.
@@ -433,103 +846,122 @@ static struct sysproc **sysprocfromkinfoproc(struct kinfo_proc *processes, int c
 		// controlling tty dev
 		procinfo->ttydev = processes[i].kp_eproc.e_tdev;
 		// setlogin() name
-		procinfo->setloginname = processes[i].kp_eproc.e_login;
-
-		processArguments(procinfo->pid, SYSPROC_PATH_LENGTH, procinfo->path);
-		if(procinfo->path == NULL) {
-			procinfo->path = procinfo->name;
-		}
-
-		procinfo->lasttotaltime = procinfo->totaltime;
-
-		// get additional info not available from sysctl
-		error = proc_pid_rusage(procinfo->pid, RUSAGE_INFO_V3, (rusage_info_t *)&rusage);
-		if(!error) {
-			//
-			// resource.h
-			//
-			procinfo->utime = rusage.ri_user_time;
-			procinfo->stime = rusage.ri_system_time;
-			procinfo->totaltime = rusage.ri_user_time + rusage.ri_system_time;
-			procinfo->idlewakeups = rusage.ri_pkg_idle_wkups;
-
-			procinfo->wiredmem = rusage.ri_wired_size;
-			procinfo->residentmem = rusage.ri_resident_size;
-			procinfo->physicalmem = rusage.ri_phys_footprint;
-			procinfo->diskior = rusage.ri_diskio_bytesread;
-			procinfo->diskiow = rusage.ri_diskio_byteswritten;
-			procinfo->billedtime = rusage.ri_billed_system_time;
-
-			totaldiskr += procinfo->diskior;
-			totaldiskw += procinfo->diskiow;
-			totalmem += procinfo->residentmem;
-		} else {
-			procinfo->utime = 0;
-			procinfo->stime = 0;
-			procinfo->totaltime = 0;
-			procinfo->idlewakeups = 0;
-
-			procinfo->wiredmem = 0;
-			procinfo->residentmem = 0;
-			procinfo->physicalmem = 0;
-			procinfo->diskior = 0;
-			procinfo->diskiow = 0;
-			procinfo->billedtime = 0;
-		}
-
-		if(procinfo->totaltime && !procinfo->lasttotaltime) {
-			procinfo->lasttotaltime = procinfo->totaltime;
-		}
-
-		oldtotal = total;
-		total += (procinfo->totaltime - procinfo->lasttotaltime);
-		if(total < oldtotal) {
-			// TODO: handle integer overflows
-		}
+		strlcpy(procinfo->setloginname, processes[i].kp_eproc.e_login, sizeof(procinfo->setloginname));
+
+		table->records[i] = procinfo;
+		table->order[i] = i;
+		table->pid[i] = procinfo->pid;
+		table->pgid[i] = procinfo->pgid;
+		table->parentpid[i] = procinfo->parentpid;
+		table->uid[i] = procinfo->realuid;
+		table->status[i] = procinfo->status;
+	}
+	table->count = (size_t)count;
 
-		procsin[i] = procinfo;
+	// rows which are not sampled keep the numbers from their last sample
+	for (int i = 0; i < count; ++i) {
+		procinfo = table->records[i];
+		table->percentage[i] = procinfo->percentage;
+		table->totaltime[i] = procinfo->totaltime;
+		table->lasttotaltime[i] = procinfo->lasttotaltime;
+		table->residentmem[i] = procinfo->residentmem;
+		table->physicalmem[i] = procinfo->physicalmem;
+		table->diskior[i] = procinfo->diskior;
+		table->diskiow[i] = procinfo->diskiow;
+		table->gpuuse[i] = procinfo->gpuuse;
 	}
 
+	// the per process system calls are independent, spread them over the
+	// workers (one worker does them all, in order, without a pool)
+	struct sysprocjob job = { table, cache, 0, 0 };
+	job.count = sysprocschedule(table, cache, count);
+	job.now = sysprocnanoseconds(cache, mach_absolute_time());
+	workpoolrun(cache->pool, sysprocsample, &job);
+
+	// sum the dense columns (integer sums, so the order does not matter)
+	unsigned long long gpuuse = 0;
+	unsigned long long diskior = 0;
+	unsigned long long diskiow = 0;
+	unsigned long long residentmem = 0;
 	for (int i = 0; i < count; ++i) {
-		procsin[i]->percentage = (((double)(procsin[i]->totaltime - procsin[i]->lasttotaltime) / total) * 100) * cpupercent;
+		gpuuse += table->gpuuse[i];
+		diskior += table->diskior[i];
+		diskiow += table->diskiow[i];
+		residentmem += table->residentmem[i];
 	}
 
-	if(totalgpu > res->gpuuse) {
+	if(gpuuse > res->gpuuse) {
 		res->gpuuselast = res->gpuuse;
-		res->gpuuse = totalgpu;
+		res->gpuuse = gpuuse;
 	} else {
-		res->gpuuselast = totalgpu;
-		res->gpuuse = totalgpu;
+		res->gpuuselast = gpuuse;
+		res->gpuuse = gpuuse;
 	}
 
-	if(totaldiskr > res->diskuser) {
+	if(diskior > res->diskuser) {
 		res->diskuserlast = res->diskuser;
-		res->diskuser = totaldiskr;
+		res->diskuser = diskior;
 	} else {
-		res->diskuserlast = totaldiskr;
-		res->diskuser = totaldiskr;
+		res->diskuserlast = diskior;
+		res->diskuser = diskior;
 	}
-	if(totaldiskw > res->diskusew) {
+	if(diskiow > res->diskusew) {
 		res->diskusewlast = res->diskusew;
-		res->diskusew = totaldiskw;
+		res->diskusew = diskiow;
 	} else {
-		res->diskusewlast = totaldiskw;
-		res->diskusew = totaldiskw;
+		res->diskusewlast = diskiow;
+		res->diskusew = diskiow;
 	}
 
-	res->memused = totalmem;
+	res->memused = residentmem;
 
-	return procsin;
+	sysprocsweep(cache);
 }
 
 /*
- * Get all process information from sysctl
+ * Sample process counters with the given number of workers (threads)
+ */
+void sysproccacheworkers(struct sysproccache *cache, int workers)
+{
+	workpoolfree(cache->pool);
+	cache->pool = NULL;
+
+	if(workers > 1) {
+		cache->pool = workpoolnew(workers);
+	}
+}
+
+/*
+ * Free the process records, the PID table, the sysctl buffer, the uid
+ *  names and the workers (a table walked into it points at its records)
  */
-static struct sysproc **getsysprocinfo(int processinfotype, int criteria, size_t *length, struct sysproc **procs, struct hashitem **hashtable, double cpupercent, struct sysres *res)
+void sysproccachefree(struct sysproccache *cache)
 {
-	struct sysproc **result = NULL;
-	struct kinfo_proc *processlist = NULL;
+	workpoolfree(cache->pool);
+	hashtfree(cache->hash);
+	struct sysprocslab *slab = cache->slabs;
+	while(slab) {
+		struct sysprocslab *next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	free(cache->kinfo);
+	uidcachefree(&cache->uids);
+	cache->pool = NULL;
+	cache->hash = NULL;
+	cache->slabs = NULL;
+	cache->freelist = NULL;
+	cache->kinfo = NULL;
+	cache->kinfosize = 0;
+	cache->live = 0;
+	cache->free = 0;
+}
 
+/*
+ * Get all process information from sysctl
+ */
+static void getsysprocinfo(int processinfotype, int criteria, struct sysproctable *table, struct sysproccache *cache, struct sysres *res)
+{
 	int mib[4];
 	mib[0] = CTL_KERN;
 	mib[1] = KERN_PROC;
@@ -537,54 +969,51 @@ static struct sysproc **getsysprocinfo(int processinfotype, int criteria, size_t
 	mib[3] = criteria;
 	size_t templength = 0;
 	int processcount = 0;
-	int complete = 0;
 	int error = 0;
 
-	// catch memory errors (ENOMEM),
-	// assert to catch program errors
-	while(!complete && !error) {
-		assert(processlist == NULL);
-		templength = 0;
-
+	// catch memory errors (ENOMEM), the process table can grow
+	// between the two calls, so retry with the new expected length
+	for(;;) {
 		// get the expected length of the result
+		templength = 0;
 		error = sysctl(mib, 4, NULL, &templength, NULL, 0);
+		if(error) {
+			table->count = 0;
+			return;
+		}
 
-		// allocate memory for the result
-		if(!error) {
-			processlist = malloc(templength);
-			if(processlist == NULL) {
-				error = 1;
+		// the buffer is kept between walks and only grows
+		if(templength > cache->kinfosize) {
+			size_t newsize = templength + (templength / 8);
+			struct kinfo_proc *newkinfo = (struct kinfo_proc *)realloc(cache->kinfo, newsize);
+			if(newkinfo == NULL) {
+				// TODO: handle memory allocation failure
+				table->count = 0;
+				return;
 			}
+			cache->kinfo = newkinfo;
+			cache->kinfosize = newsize;
 		}
 
 		// get the result
+		templength = cache->kinfosize;
+		error = sysctl(mib, 4, cache->kinfo, &templength, NULL, 0);
 		if(!error) {
-			error = sysctl(mib, 4, processlist, &templength, NULL, 0);
-		}
-
-		// fill the sysproc struct from the returned information
-		if(!error) {
-			processcount = (unsigned int)templength / sizeof(struct kinfo_proc);
-			result = sysprocfromkinfoproc(processlist, processcount, procs, hashtable, cpupercent, res);
-			free(processlist);
-			processlist = NULL;
-			complete = 1;
-		} else {
-			assert(processlist != NULL);
-			free(processlist);
-			processlist = NULL;
-
-			complete = 0;
-			error = 0;
+			break;
+		} else if(errno != ENOMEM) {
+			table->count = 0;
+			return;
 		}
 	}
-	*length = (size_t)processcount;
-	return result;
+
+	// fill the sysproc struct from the returned information
+	processcount = (int)(templength / sizeof(struct kinfo_proc));
+	sysprocfromkinfoproc(cache->kinfo, processcount, table, cache, res);
 }
 
-struct sysproc **getsysprocinfoall(size_t *length, struct sysproc **procs, struct hashitem **hashtable, double cpupercent, struct sysres *res)
+void getsysprocinfoall(struct sysproctable *table, struct sysproccache *cache, struct sysres *res)
 {
-	return getsysprocinfo(KERN_PROC_ALL, 0, length, procs, hashtable, cpupercent, res);
+	getsysprocinfo(KERN_PROC_ALL, 0, table, cache, res);
 }
 
 void getsysnetinfo(struct sysnet *net)
@@ -663,3 +1092,64 @@ void getsysnetinfo(struct sysnet *net)
 	*/
 	freeifaddrs(if_list);
 }
+
+/*
+ * Sum the byte counters of the running interfaces (for burst sampling)
+ *
+ * getifaddrs() only has the 32 bit counters, which wrap in a few seconds
+ *  on a fast link, so the 64 bit ones are read from the routing socket
+ *  (NET_RT_IFLIST2). Returns the number of interfaces summed, or -1; the
+ *  sums jump when an interface comes or goes, so compare that number too.
+ */
+int getsysnetbytes(char **buffer, size_t *buffersize, unsigned long long *ibytes, unsigned long long *obytes)
+{
+	int mib[6] = { CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST2, 0 };
+	size_t length = 0;
+
+	// the caller keeps the buffer between calls and it only grows, the
+	// length is only asked for when it is too small (ENOMEM)
+	for(;;) {
+		length = *buffersize;
+		if(*buffer) {
+			if(!sysctl(mib, 6, *buffer, &length, NULL, 0)) {
+				break;
+			} else if(errno != ENOMEM) {
+				return -1;
+			}
+		}
+
+		length = 0;
+		if(sysctl(mib, 6, NULL, &length, NULL, 0) < 0) {
+			return -1;
+		}
+		size_t newsize = length + (length / 8);
+		char *newbuffer = (char *)realloc(*buffer, newsize);
+		if(newbuffer == NULL) {
+			// TODO: handle memory allocation failure
+			return -1;
+		}
+		*buffer = newbuffer;
+		*buffersize = newsize;
+	}
+
+	int count = 0;
+	*ibytes = 0;
+	*obytes = 0;
+	struct if_msghdr *message = NULL;
+	for (char *next = *buffer; next < (*buffer + length); next += message->ifm_msglen) {
+		message = (struct if_msghdr *)next;
+		if(message->ifm_msglen == 0) {
+			break;
+		}
+		if(message->ifm_type != RTM_IFINFO2) {
+			continue;
+		}
+		if((message->ifm_flags & IFF_UP) && (message->ifm_flags & IFF_RUNNING)) {
+			struct if_msghdr2 *ifinfo = (struct if_msghdr2 *)next;
+			*ibytes += ifinfo->ifm_data.ifi_ibytes;
+			*obytes += ifinfo->ifm_data.ifi_obytes;
+			++count;
+		}
+	}
+	return count;
+}
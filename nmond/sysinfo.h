@@ -38,8 +38,10 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include "pidhash.h"
+#include "uidcache.h"
 
 #define DATE_FORMAT "%Y-%m-%d"
 #define TIME_FORMAT "%H:%M:%S"
@@ -51,16 +53,16 @@
 // Hardware based information
 //
 
-struct syshw { // CTL_HW
+struct syshw { // CTL_HW (static, collected at start and on reload)
 	unsigned int cpufrequency; // hw.cpufrequency
 	unsigned int cpufrequencymin; // hw.cpufrequency_min
 	unsigned int cpufrequencymax; // hw.cpufrequency_max
 	unsigned int cpucount; // hw.ncpu -- DEPRECATED
-	unsigned int cpuactive; // hw.activecpu
 	unsigned int physicalcpucount; // hw.physicalcpu
 	unsigned int physicalcpumax; // hw.physicalcpu_max
 	unsigned int logicalcpucount; // hw.logicalcpu
 	unsigned int logicalcpumax; // hw.logicalcpu_max
+	unsigned int packages; // hw.packages
 	unsigned int hyperthreads;
 
 	unsigned int byteorder; // HW_BYTEORDER
@@ -72,9 +74,6 @@ struct syshw { // CTL_HW
 	unsigned int l3cachesiz;
 
 	unsigned int thermalsensor; // machdep.cpu.thermal.sensor
-	unsigned int thermallevelcpu; // machdep.xcpm.cpu_thermal_level
-	unsigned int thermallevelgpu; // machdep.xcpm.gpu_thermal_level
-	unsigned int thermallevelio; // machdep.xcpm.io_thermal_level
 
 	unsigned long long memorysize; // HW_MEMSIZE (total memory, 64bit int)
 
@@ -86,16 +85,28 @@ struct syshw { // CTL_HW
 };
 #define SYSHW_INIT { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, \
 0, 0, 0, 0, 0, 0, 0, \
-0, 0, 0, 0, 0, \
-NULL, NULL, NULL, NULL, NULL };
+0, \
+0, \
+NULL, NULL, NULL, NULL, NULL }
+
+struct syshwdyn { // CTL_HW (dynamic, collected every COLLECTOR_SLOW_NS for the sys pane)
+	unsigned int cpuactive; // hw.activecpu
+	unsigned int thermallevelcpu; // machdep.xcpm.cpu_thermal_level
+	unsigned int thermallevelgpu; // machdep.xcpm.gpu_thermal_level
+	unsigned int thermallevelio; // machdep.xcpm.io_thermal_level
+};
+#define SYSHWDYN_INIT { 0, 0, 0, 0 }
 
 extern void getsyshwinfo(struct syshw*);
+extern void syshwcopy(struct syshw*, struct syshw*);
+extern void syshwfree(struct syshw*);
+extern void getsyshwdyninfo(struct syshwdyn*);
 
 //
 // Kernel based information
 //
 
-struct syskern { // CTL_KERN
+struct syskern { // CTL_KERN (static, collected at start and on reload)
 	unsigned int hostid; // KERN_HOSTID
 	unsigned int jobcontrol; // KERN_JOB_CONTROL
 	unsigned int maxarguments; // KERN_ARGMAX
@@ -123,10 +134,8 @@ struct syskern { // CTL_KERN
 	char *hostname; // KERN_HOSTNAME
 	char *domainname; // KERN_NISDOMAINNAME
 	char *boottimestring;
-	char *uptimestring;
 
 	struct timeval boottime; // KERN_BOOTTIME ("{ sec = 1439860179, usec = 0 }")
-	struct timeval uptime;
 
 	//struct clockinfo clockrate; // KERN_CLOCKRATE ("{ hz = 100, tick = 10000, tickadj = 22, profhz = 100, stathz = 100 }")
 	//struct file filetable; // KERN_FILE
@@ -137,10 +146,18 @@ struct syskern { // CTL_KERN
 #define SYSKERN_INIT { 0, 0, 0, 0, 0, 0, 0, 0, 0, \
 0, 0, 0, 0, 0, \
 0, 0, \
-NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
-{ 0, 0 }, { 0, 0 } }
+NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
+{ 0, 0 } }
+
+struct syskerndyn { // CTL_KERN (dynamic, collected every COLLECTOR_SLOW_NS for the sys pane)
+	struct timeval uptime; // now - KERN_BOOTTIME
+};
+#define SYSKERNDYN_INIT { { 0, 0 } }
 
 extern void getsyskerninfo(struct syskern*);
+extern void syskerncopy(struct syskern*, struct syskern*);
+extern void syskernfree(struct syskern*);
+extern void getsyskerndyninfo(struct syskerndyn*, struct syskern*);
 
 //
 // System resource utilization information
@@ -203,7 +220,18 @@ struct sysres {
 };
 #define SYSRES_INIT { 0, 0, NULL, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 
+// tick counters of one CPU, read on their own for burst sampling
+struct syscputicks {
+	unsigned int user;
+	unsigned int sys;
+	unsigned int idle;
+	unsigned int nice;
+};
+
 extern void getsysresinfo(struct sysres *);
+extern void sysrescopy(struct sysres*, struct sysres*);
+extern void sysresfree(struct sysres*);
+extern int getsyscputicks(struct syscputicks*, int);
 
 //
 // Virtual memory statistics
@@ -216,30 +244,39 @@ extern unsigned long long getsysvminfo();
 //
 
 #define SYSPROC_PATH_LENGTH 45
-#define SYSPROC_REAL_USER_NAME_LENGTH 16
+#define SYSPROC_NAME_LENGTH 16 // MAXCOMLEN
+#define SYSPROC_LOGIN_NAME_LENGTH 12 // MAXLOGNAME
+// process records are allocated this many at a time
+#define SYSPROC_SLAB_SIZE 256
+// walks without any CPU use before a process is moved to the cold tier
+#define SYSPROC_COLD_TICKS 5
+// cold processes are sampled round-robin, each about once this many walks
+#define SYSPROC_COLD_INTERVAL 10
 
 struct sysproc {
 	char status;
 	int pid;
 	struct timeval realtime;
+	struct timeval starttime;
 	// int cticks;
 	// unsigned long long uticks;
 	// unsigned long long sticks;
 	// unsigned long long iticks;
 	unsigned int priority;
 	char nice;
-	char *name;
+	char name[SYSPROC_NAME_LENGTH + 1];
 
 	unsigned int realuid;
-	char *realusername;
+	char *realusername; // interned by the uidcache, compare by pointer
 	unsigned int effectiveuid;
-	char *effectiveusername;
+	char *effectiveusername; // interned by the uidcache
 	int pgid;
 	int parentpid;
 	int ttydev;
-	char *setloginname;
+	char setloginname[SYSPROC_LOGIN_NAME_LENGTH + 1];
 
-	char *path;
+	char path[SYSPROC_PATH_LENGTH + 1];
+	bool pathfetched; // arguments are read once per (pid, start time)
 
 	unsigned long long utime;
 	unsigned long long stime;
@@ -253,7 +290,14 @@ struct sysproc {
 	unsigned long long billedtime;
 
 	unsigned long long lasttotaltime;
-	double percentage;
+	unsigned long long gpuuse;
+
+	unsigned long long sampletime; // when the counters were read (ns, monotonic)
+	double percentage; // CPU use between the last two samples (percent of all CPUs)
+	unsigned int idleticks; // samples in a row without CPU use
+
+	unsigned long generation; // process walk which last saw this process
+	struct sysproc *nextfree; // free list (or eviction list) link
 };
 // #define SYSPROC_INIT { ' ', 0, 0, 0, ' ', ' ', \
 // 0, 0, 0, 0, 0, 0, 0, 0, \
@@ -261,7 +305,94 @@ struct sysproc {
 // 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, \
 // 0, 0.0 }
 
-extern struct sysproc **getsysprocinfoall(size_t*, struct sysproc**, struct hashitem**, double, struct sysres*);
+struct sysprocslab {
+	struct sysprocslab *next;
+	struct sysproc procs[SYSPROC_SLAB_SIZE];
+};
+
+struct kinfo_proc;
+struct workpool;
+
+// process records by PID, records of exited processes are reclaimed
+// into the free list at the end of each walk and reused for new PIDs
+struct sysproccache {
+	struct hashtable *hash;
+	struct sysprocslab *slabs;
+	struct sysproc *freelist;
+	size_t live;
+	size_t free;
+
+	struct uidcache uids;
+	bool fetchargs; // read command lines (only while they are shown)
+
+	struct kinfo_proc *kinfo; // reused sysctl buffer
+	size_t kinfosize;
+
+	struct workpool *pool; // NULL samples on the calling thread
+
+	// processes which used no CPU for a while are only sampled every few
+	// walks, new, changed and shown (pinned) processes are sampled every walk
+	size_t budget; // most processes sampled per walk (0 for no limit)
+	int *pinned; // PIDs kept hot (the rows shown by the top pane)
+	size_t pinnedcount;
+	size_t hotnext; // rows where the next walk resumes each tier
+	size_t coldnext;
+	size_t sampledhot; // processes sampled by the last walk, by tier
+	size_t sampledcold;
+	size_t cold; // processes in the cold tier
+	unsigned int timebasenumer; // mach time units to nanoseconds
+	unsigned int timebasedenom;
+	unsigned int cpucount; // logical CPUs, the CPU use is a share of all of them
+
+	unsigned long generation;
+	unsigned long evictions; // records reclaimed by the last walk (the profile pane repeats it until the next walk)
+};
+#define SYSPROCCACHE_INIT { NULL, NULL, NULL, 0, 0, UIDCACHE_INIT, false, NULL, 0, NULL, \
+0, NULL, 0, 0, 0, 0, 0, 0, 0, 0, \
+0, 0, 0 }
+
+// the processes seen by the last walk, one row per process with the
+// numbers that are sorted and summed every tick kept in dense columns
+// (the record holds the names, paths and state kept between walks)
+struct sysproctable {
+	size_t count;
+	size_t capacity;
+
+	struct sysproc **records; // NULL for the rows a copy left out
+	int *order; // display order of the rows (sorted by the UI)
+	int *sample; // rows sampled by this walk
+
+	int *pid;
+	int *pgid;
+	int *parentpid;
+	unsigned int *uid;
+	char *status;
+
+	double *percentage;
+	unsigned long long *totaltime;
+	unsigned long long *lasttotaltime;
+	unsigned long long *residentmem;
+	unsigned long long *physicalmem;
+	unsigned long long *diskior;
+	unsigned long long *diskiow;
+	unsigned long long *gpuuse;
+
+	struct sysproc *copies; // records owned by a copy (see sysproctablecopy)
+};
+#define SYSPROCTABLE_INIT { 0, 0, NULL, NULL, NULL, \
+NULL, NULL, NULL, NULL, NULL, \
+NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
+NULL }
+
+extern void sysproccacheworkers(struct sysproccache*, int);
+extern void sysproccachefree(struct sysproccache*);
+extern void getsysprocinfoall(struct sysproctable*, struct sysproccache*, struct sysres*);
+extern bool sysproctablereserve(struct sysproctable*, size_t);
+extern bool sysproctablecopy(struct sysproctable*, struct sysproctable*, size_t, int (*)(struct sysproctable*, int, int));
+extern void sysproctablefree(struct sysproctable*);
+extern int sysproctablecomparecpu(struct sysproctable*, int, int);
+extern int sysproctablecomparemem(struct sysproctable*, int, int);
+extern void sysproctableselect(struct sysproctable*, int, int (*)(struct sysproctable*, int, int));
 
 //
 // Network information
@@ -305,6 +436,7 @@ struct sysnet {
 0, 0 }
 
 extern void getsysnetinfo(struct sysnet *net);
+extern int getsysnetbytes(char**, size_t*, unsigned long long*, unsigned long long*);
 
 //
 // Mem
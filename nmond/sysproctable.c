@@ -0,0 +1,288 @@
+/**
+ * sysproctable.c -- Columnar table of the processes seen by a walk
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sysinfo.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SYSPROCTABLE_GROW(column) \
+	do { \
+		void *grown = realloc(table->column, sizeof(*table->column) * capacity); \
+		if(grown == NULL) { \
+			return false; \
+		} \
+		table->column = grown; \
+	} while(0)
+
+/*
+ * Make room for count rows in every column of the process table
+ */
+bool sysproctablereserve(struct sysproctable *table, size_t count)
+{
+	if(count <= table->capacity) {
+		return true;
+	}
+
+	// only grow, the table is reused between walks
+	size_t capacity = count + (count / 4);
+	SYSPROCTABLE_GROW(records);
+	SYSPROCTABLE_GROW(order);
+	SYSPROCTABLE_GROW(sample);
+	SYSPROCTABLE_GROW(pid);
+	SYSPROCTABLE_GROW(pgid);
+	SYSPROCTABLE_GROW(parentpid);
+	SYSPROCTABLE_GROW(uid);
+	SYSPROCTABLE_GROW(status);
+	SYSPROCTABLE_GROW(percentage);
+	SYSPROCTABLE_GROW(totaltime);
+	SYSPROCTABLE_GROW(lasttotaltime);
+	SYSPROCTABLE_GROW(residentmem);
+	SYSPROCTABLE_GROW(physicalmem);
+	SYSPROCTABLE_GROW(diskior);
+	SYSPROCTABLE_GROW(diskiow);
+	SYSPROCTABLE_GROW(gpuuse);
+	table->capacity = capacity;
+	return true;
+}
+
+#define SYSPROCTABLE_COPY(column) \
+	memcpy(to->column, from->column, sizeof(*to->column) * from->count)
+
+/*
+ * Copy a process table so that it stays valid while the original is
+ *  refilled by the next walk; every column is copied, but only the records
+ *  of the first rows by compare (selected to lead the copy's display order,
+ *  or as they are without a compare), the records of the other rows are NULL
+ */
+bool sysproctablecopy(struct sysproctable *to, struct sysproctable *from, size_t rows, int (*compare)(struct sysproctable*, int, int))
+{
+	if(from->count == 0) {
+		to->count = 0;
+		return true;
+	}
+
+	size_t capacity = to->capacity;
+	if(!sysproctablereserve(to, from->count)) {
+		// TODO: handle memory allocation failure
+		return false;
+	}
+	if((to->copies == NULL) || (to->capacity != capacity)) {
+		struct sysproc *copies = (struct sysproc *)realloc(to->copies, sizeof(struct sysproc) * to->capacity);
+		if(copies == NULL) {
+			// TODO: handle memory allocation failure
+			return false;
+		}
+		to->copies = copies;
+	}
+
+	SYSPROCTABLE_COPY(order);
+	SYSPROCTABLE_COPY(pid);
+	SYSPROCTABLE_COPY(pgid);
+	SYSPROCTABLE_COPY(parentpid);
+	SYSPROCTABLE_COPY(uid);
+	SYSPROCTABLE_COPY(status);
+	SYSPROCTABLE_COPY(percentage);
+	SYSPROCTABLE_COPY(totaltime);
+	SYSPROCTABLE_COPY(lasttotaltime);
+	SYSPROCTABLE_COPY(residentmem);
+	SYSPROCTABLE_COPY(physicalmem);
+	SYSPROCTABLE_COPY(diskior);
+	SYSPROCTABLE_COPY(diskiow);
+	SYSPROCTABLE_COPY(gpuuse);
+	to->count = from->count;
+
+	// user names are interned (never freed), so the pointers can be shared
+	if(rows >= from->count) {
+		for (size_t i = 0; i < from->count; ++i) {
+			to->copies[i] = *from->records[i];
+			to->records[i] = &to->copies[i];
+		}
+		return true;
+	}
+
+	// a record is hundreds of bytes, most rows are never shown
+	memset(to->records, 0, sizeof(struct sysproc*) * from->count);
+	if(compare) {
+		sysproctableselect(to, (int)rows, compare);
+	}
+	int row = 0;
+	for (size_t i = 0; i < rows; ++i) {
+		row = to->order[i];
+		to->copies[i] = *from->records[row];
+		to->records[row] = &to->copies[i];
+	}
+	return true;
+}
+
+/*
+ * Free every column of a process table (and the records of a copy), the
+ *  records of the walked table belong to the process cache
+ */
+void sysproctablefree(struct sysproctable *table)
+{
+	free(table->records);
+	free(table->order);
+	free(table->sample);
+	free(table->pid);
+	free(table->pgid);
+	free(table->parentpid);
+	free(table->uid);
+	free(table->status);
+	free(table->percentage);
+	free(table->totaltime);
+	free(table->lasttotaltime);
+	free(table->residentmem);
+	free(table->physicalmem);
+	free(table->diskior);
+	free(table->diskiow);
+	free(table->gpuuse);
+	free(table->copies);
+	memset(table, 0, sizeof(struct sysproctable));
+}
+
+/*
+ * Busiest first, ties go by PID so rows do not jump around between refreshes
+ */
+int sysproctablecomparecpu(struct sysproctable *table, int row1, int row2)
+{
+	if (table->percentage[row1] > table->percentage[row2]) {
+		return -1;
+	} else if (table->percentage[row1] < table->percentage[row2]) {
+		return 1;
+	} else if (table->pid[row1] < table->pid[row2]) {
+		return -1;
+	} else if (table->pid[row1] > table->pid[row2]) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/*
+ * Largest resident memory first, ties go by PID
+ */
+int sysproctablecomparemem(struct sysproctable *table, int row1, int row2)
+{
+	if (table->residentmem[row1] > table->residentmem[row2]) {
+		return -1;
+	} else if (table->residentmem[row1] < table->residentmem[row2]) {
+		return 1;
+	} else if (table->pid[row1] < table->pid[row2]) {
+		return -1;
+	} else if (table->pid[row1] > table->pid[row2]) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+static inline void sysproctableswap(int *order, int a, int b)
+{
+	int temp = order[a];
+	order[a] = order[b];
+	order[b] = temp;
+}
+
+/*
+ * Move the first topcount rows (by compare) to the front of the display
+ *  order, only that prefix is sorted, the rest are in no particular order
+ *  (quickselect, then sort the prefix: O(n + k^2) instead of O(n log n))
+ */
+void sysproctableselect(struct sysproctable *table, int topcount, int (*compare)(struct sysproctable*, int, int))
+{
+	int *order = table->order;
+	int processcount = (int)table->count;
+	if(topcount > processcount) {
+		topcount = processcount;
+	}
+	if(topcount <= 0) {
+		return;
+	}
+
+	int nth = topcount - 1;
+	int left = 0;
+	int right = processcount - 1;
+	while(left < right) {
+		// median of three pivot (deterministic, and fine for sorted input)
+		int middle = left + ((right - left) / 2);
+		if(compare(table, order[middle], order[left]) < 0) {
+			sysproctableswap(order, middle, left);
+		}
+		if(compare(table, order[right], order[left]) < 0) {
+			sysproctableswap(order, right, left);
+		}
+		if(compare(table, order[right], order[middle]) < 0) {
+			sysproctableswap(order, right, middle);
+		}
+		int pivot = order[middle];
+
+		int i = left;
+		int j = right;
+		while(i <= j) {
+			while(compare(table, order[i], pivot) < 0) {
+				++i;
+			}
+			while(compare(table, order[j], pivot) > 0) {
+				--j;
+			}
+			if(i <= j) {
+				sysproctableswap(order, i, j);
+				++i;
+				--j;
+			}
+		}
+
+		if(nth <= j) {
+			right = j;
+		} else if(nth >= i) {
+			left = i;
+		} else {
+			break;
+		}
+	}
+
+	// the prefix is one screen of rows, insertion sort is plenty
+	for (int i = 1; i < topcount; ++i) {
+		int row = order[i];
+		int j = i - 1;
+		while((j >= 0) && (compare(table, order[j], row) > 0)) {
+			order[j + 1] = order[j];
+			--j;
+		}
+		order[j + 1] = row;
+	}
+}
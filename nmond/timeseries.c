@@ -0,0 +1,252 @@
+/**
+ * timeseries.c -- ring of samples behind the long-term graphs
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "timeseries.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct timeseries *timeseriesnew(int channels, size_t capacity)
+{
+	if((channels < 1) || (capacity < 1)) {
+		return NULL;
+	}
+
+	struct timeseries *series = (struct timeseries *)calloc(1, sizeof(struct timeseries));
+	if(series == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	size_t cells = capacity * (size_t)channels;
+	series->channels = channels;
+	series->capacity = capacity;
+	series->window = capacity;
+	series->values = (double *)calloc(cells, sizeof(double));
+	series->sums = (double *)calloc((size_t)channels, sizeof(double));
+	series->minqueue = (unsigned long long *)calloc(cells, sizeof(unsigned long long));
+	series->maxqueue = (unsigned long long *)calloc(cells, sizeof(unsigned long long));
+	series->minhead = (size_t *)calloc((size_t)channels, sizeof(size_t));
+	series->minlength = (size_t *)calloc((size_t)channels, sizeof(size_t));
+	series->maxhead = (size_t *)calloc((size_t)channels, sizeof(size_t));
+	series->maxlength = (size_t *)calloc((size_t)channels, sizeof(size_t));
+	if(!series->values || !series->sums || !series->minqueue || !series->maxqueue || \
+		!series->minhead || !series->minlength || !series->maxhead || !series->maxlength) {
+		// TODO: handle memory allocation failure
+		timeseriesfree(series);
+		return NULL;
+	}
+	return series;
+}
+
+static inline double *timeseriesrow(struct timeseries *series, unsigned long long sample)
+{
+	return series->values + ((size_t)(sample % series->capacity) * (size_t)series->channels);
+}
+
+/*
+ * Add a sample to the back of a channel's queue, dropping the samples
+ *  before it which can no longer be the minimum (or the maximum) of the
+ *  window while it is in the window
+ */
+static void timeseriesqueue(struct timeseries *series, unsigned long long *queue, size_t head, size_t *length, int channel, unsigned long long sample, bool minimum)
+{
+	double value = timeseriesrow(series, sample)[channel];
+	while(*length) {
+		size_t back = (head + *length - 1) % series->capacity;
+		double last = timeseriesrow(series, queue[back])[channel];
+		if(minimum ? (last < value) : (last > value)) {
+			break;
+		}
+		*length -= 1;
+	}
+	queue[(head + *length) % series->capacity] = sample;
+	*length += 1;
+}
+
+/*
+ * Drop the samples which left the window from the front of a queue
+ */
+static void timeseriesexpire(struct timeseries *series, unsigned long long *queue, size_t *head, size_t *length, unsigned long long oldest)
+{
+	while(*length && (queue[*head] < oldest)) {
+		*head = (*head + 1) % series->capacity;
+		*length -= 1;
+	}
+}
+
+/*
+ * Append a sample (a value for each channel), the oldest kept sample
+ *  is overwritten once the ring is full
+ */
+void timeseriesappend(struct timeseries *series, const double *values)
+{
+	unsigned long long sample = series->count;
+	double *row = timeseriesrow(series, sample);
+	int channels = series->channels;
+
+	// the sample leaving the window is still in the ring until overwritten
+	if(sample >= series->window) {
+		double *leaving = timeseriesrow(series, sample - series->window);
+		for (int c = 0; c < channels; ++c) {
+			series->sums[c] -= leaving[c];
+		}
+	}
+	memcpy(row, values, sizeof(double) * (size_t)channels);
+	series->count += 1;
+
+	unsigned long long oldest = (sample >= series->window) ? (sample + 1 - series->window) : 0;
+	for (int c = 0; c < channels; ++c) {
+		series->sums[c] += values[c];
+
+		unsigned long long *minqueue = series->minqueue + ((size_t)c * series->capacity);
+		unsigned long long *maxqueue = series->maxqueue + ((size_t)c * series->capacity);
+		timeseriesexpire(series, minqueue, &series->minhead[c], &series->minlength[c], oldest);
+		timeseriesexpire(series, maxqueue, &series->maxhead[c], &series->maxlength[c], oldest);
+		timeseriesqueue(series, minqueue, series->minhead[c], &series->minlength[c], c, sample, true);
+		timeseriesqueue(series, maxqueue, series->maxhead[c], &series->maxlength[c], c, sample, false);
+	}
+}
+
+/*
+ * Whether a sample (by number) is still in the ring
+ */
+bool timeserieskept(struct timeseries *series, unsigned long long sample)
+{
+	return (sample < series->count) && ((series->count - sample) <= series->capacity);
+}
+
+/*
+ * The value of a channel of a sample, zero for a sample not kept
+ */
+double timeseriesvalue(struct timeseries *series, unsigned long long sample, int channel)
+{
+	if(!timeserieskept(series, sample) || (channel < 0) || (channel >= series->channels)) {
+		return 0;
+	}
+	return timeseriesrow(series, sample)[channel];
+}
+
+/*
+ * Keep the aggregates over the last samples samples (such as the width
+ *  of a graph), they are rebuilt from the samples kept
+ */
+void timeserieswindow(struct timeseries *series, size_t samples)
+{
+	if(samples < 1) {
+		samples = 1;
+	}
+	if(samples > series->capacity) {
+		samples = series->capacity;
+	}
+	series->window = samples;
+
+	unsigned long long oldest = (series->count > samples) ? (series->count - samples) : 0;
+	for (int c = 0; c < series->channels; ++c) {
+		series->sums[c] = 0;
+		series->minhead[c] = 0;
+		series->minlength[c] = 0;
+		series->maxhead[c] = 0;
+		series->maxlength[c] = 0;
+
+		unsigned long long *minqueue = series->minqueue + ((size_t)c * series->capacity);
+		unsigned long long *maxqueue = series->maxqueue + ((size_t)c * series->capacity);
+		for (unsigned long long sample = oldest; sample < series->count; ++sample) {
+			series->sums[c] += timeseriesrow(series, sample)[c];
+			timeseriesqueue(series, minqueue, 0, &series->minlength[c], c, sample, true);
+			timeseriesqueue(series, maxqueue, 0, &series->maxlength[c], c, sample, false);
+		}
+	}
+}
+
+/*
+ * Samples the aggregates are over (fewer than the window at first)
+ */
+size_t timeserieswindowcount(struct timeseries *series)
+{
+	return (series->count < series->window) ? (size_t)series->count : series->window;
+}
+
+double timeseriesmin(struct timeseries *series, int channel)
+{
+	if(!series->minlength[channel]) {
+		return 0;
+	}
+	unsigned long long *queue = series->minqueue + ((size_t)channel * series->capacity);
+	return timeseriesrow(series, queue[series->minhead[channel]])[channel];
+}
+
+double timeseriesmax(struct timeseries *series, int channel)
+{
+	if(!series->maxlength[channel]) {
+		return 0;
+	}
+	unsigned long long *queue = series->maxqueue + ((size_t)channel * series->capacity);
+	return timeseriesrow(series, queue[series->maxhead[channel]])[channel];
+}
+
+double timeseriessum(struct timeseries *series, int channel)
+{
+	return series->sums[channel];
+}
+
+/*
+ * Forget every sample (the window is kept)
+ */
+void timeseriesclear(struct timeseries *series)
+{
+	series->count = 0;
+	for (int c = 0; c < series->channels; ++c) {
+		series->sums[c] = 0;
+		series->minlength[c] = 0;
+		series->maxlength[c] = 0;
+	}
+}
+
+void timeseriesfree(struct timeseries *series)
+{
+	if(series == NULL) {
+		return;
+	}
+	free(series->values);
+	free(series->sums);
+	free(series->minqueue);
+	free(series->maxqueue);
+	free(series->minhead);
+	free(series->minlength);
+	free(series->maxhead);
+	free(series->maxlength);
+	free(series);
+}
@@ -0,0 +1,80 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+/**
+ * timeseries.h -- ring of samples behind the long-term graphs
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Samples of one or more channels (user, system and nice time, or reads
+// and writes) appended at a steady pace. The last capacity samples are
+// kept whatever the graph shows; the minimum, maximum and sum of each
+// channel over the last window samples are kept up to date as samples
+// are appended (monotonic queues for the minimum and maximum), so each
+// append and each query is O(1) (amortized for the queues).
+struct timeseries {
+	int channels;
+	size_t capacity; // samples kept
+	double *values; // capacity rows of channels values (a ring)
+	unsigned long long count; // samples appended, the next sample number
+
+	size_t window; // samples the aggregates are over (at most capacity)
+	double *sums; // per channel
+	// sample numbers whose values may still be the window minimum or
+	// maximum, capacity per channel, oldest at the head
+	unsigned long long *minqueue;
+	unsigned long long *maxqueue;
+	size_t *minhead;
+	size_t *minlength;
+	size_t *maxhead;
+	size_t *maxlength;
+};
+
+extern struct timeseries *timeseriesnew(int, size_t);
+extern void timeseriesappend(struct timeseries*, const double*);
+extern bool timeserieskept(struct timeseries*, unsigned long long);
+extern double timeseriesvalue(struct timeseries*, unsigned long long, int);
+extern void timeserieswindow(struct timeseries*, size_t);
+extern size_t timeserieswindowcount(struct timeseries*);
+extern double timeseriesmin(struct timeseries*, int);
+extern double timeseriesmax(struct timeseries*, int);
+extern double timeseriessum(struct timeseries*, int);
+extern void timeseriesclear(struct timeseries*);
+extern void timeseriesfree(struct timeseries*);
+
+#endif
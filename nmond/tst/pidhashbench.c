@@ -0,0 +1,206 @@
+/**
+ * pidhashbench.c -- Benchmark of the PID hash table against the chained table it replaced
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pidhash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_MAX_PID 4000000
+#define BENCH_TICKS 20
+
+//
+// The chained table pidhash.c used to have (lookups and inserts only)
+//
+
+#define OLD_HASH_TABLE_SIZE 1000
+#define OLD_HASH_TABLE_SIZE_X10 10000
+#define OLD_HASH_TABLE_SIZE_X100 100000
+
+struct oldhashitem {
+	int keyhash;
+	int key;
+	void *valoc;
+	struct oldhashitem *next;
+};
+
+static int oldhash(int value)
+{
+	while(value >= OLD_HASH_TABLE_SIZE) {
+		if(value < OLD_HASH_TABLE_SIZE_X10) {
+			value = value - OLD_HASH_TABLE_SIZE;
+		} else if(value < OLD_HASH_TABLE_SIZE_X100) {
+			value = value - OLD_HASH_TABLE_SIZE_X10;
+		} else {
+			value = value - OLD_HASH_TABLE_SIZE_X100;
+		}
+	}
+	return value;
+}
+
+static void oldhashtadd(struct oldhashitem *hashtable, int key, void *valoc)
+{
+	struct oldhashitem *thishashitem = (struct oldhashitem *)malloc(sizeof(struct oldhashitem));
+	thishashitem->next = NULL;
+	thishashitem->keyhash = oldhash(key);
+	thishashitem->key = key;
+	thishashitem->valoc = valoc;
+
+	struct oldhashitem *hitem = &hashtable[thishashitem->keyhash];
+	while(hitem->next) {
+		hitem = hitem->next;
+	}
+	if(hitem->valoc) {
+		hitem->next = thishashitem;
+	} else {
+		hashtable[thishashitem->keyhash] = *thishashitem;
+		free(thishashitem);
+	}
+}
+
+static void *oldhashtget(struct oldhashitem *hashtable, int key)
+{
+	struct oldhashitem *hitem = &hashtable[oldhash(key)];
+	if(hitem->key != key) {
+		while(hitem->next) {
+			hitem = hitem->next;
+			if(hitem->key == key) {
+				break;
+			}
+		}
+		if(hitem->key != key) {
+			return NULL;
+		}
+	}
+	return hitem->valoc;
+}
+
+static void oldhashtfree(struct oldhashitem *hashtable)
+{
+	for (int i = 0; i < OLD_HASH_TABLE_SIZE; ++i) {
+		struct oldhashitem *hitem = hashtable[i].next;
+		while(hitem) {
+			struct oldhashitem *next = hitem->next;
+			free(hitem);
+			hitem = next;
+		}
+	}
+	free(hashtable);
+}
+
+static double benchclock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((double)now.tv_sec * 1000.0) + ((double)now.tv_nsec / 1000000.0);
+}
+
+/*
+ * Unique random PIDs, as on a host with a large PID space
+ */
+static int *benchpids(int count)
+{
+	int *pids = (int *)malloc(sizeof(int) * (size_t)count);
+	char *used = (char *)calloc(BENCH_MAX_PID, 1);
+	for (int i = 0; i < count;) {
+		int pid = 1 + (rand() % (BENCH_MAX_PID - 1));
+		if(!used[pid]) {
+			used[pid] = 1;
+			pids[i] = pid;
+			++i;
+		}
+	}
+	free(used);
+	return pids;
+}
+
+int main()
+{
+	int counts[] = { 1000, 10000, 100000 };
+	volatile void *sink = NULL;
+	srand(42);
+
+	printf("%-8s %20s %24s %12s\n", "PIDs", "insert old/new ms", "lookup all old/new ms", "delete ms");
+	for (size_t c = 0; c < (sizeof(counts) / sizeof(counts[0])); ++c) {
+		int count = counts[c];
+		int *pids = benchpids(count);
+
+		double started = benchclock();
+		struct oldhashitem *old = (struct oldhashitem *)calloc(OLD_HASH_TABLE_SIZE, sizeof(struct oldhashitem));
+		for (int i = 0; i < count; ++i) {
+			oldhashtadd(old, pids[i], &pids[i]);
+		}
+		double oldinsert = benchclock() - started;
+
+		started = benchclock();
+		for (int tick = 0; tick < BENCH_TICKS; ++tick) {
+			for (int i = 0; i < count; ++i) {
+				sink = oldhashtget(old, pids[i]);
+			}
+		}
+		double oldlookup = (benchclock() - started) / BENCH_TICKS;
+		oldhashtfree(old);
+
+		started = benchclock();
+		struct hashtable *table = hashtnew();
+		for (int i = 0; i < count; ++i) {
+			hashtset(table, pids[i], &pids[i]);
+		}
+		double newinsert = benchclock() - started;
+
+		started = benchclock();
+		for (int tick = 0; tick < BENCH_TICKS; ++tick) {
+			for (int i = 0; i < count; ++i) {
+				sink = hashtget(table, pids[i]);
+			}
+		}
+		double newlookup = (benchclock() - started) / BENCH_TICKS;
+
+		// the old table could not delete at all
+		started = benchclock();
+		for (int i = 0; i < count; ++i) {
+			sink = hashtdel(table, pids[i]);
+		}
+		double newdelete = benchclock() - started;
+		hashtfree(table);
+
+		printf("%-8d %9.3f / %-8.3f %11.3f / %-10.3f %12.3f\n", count, oldinsert, newinsert, oldlookup, newlookup, newdelete);
+		free(pids);
+	}
+	(void)sink;
+	return 0;
+}
@@ -0,0 +1,303 @@
+/**
+ * pidhashtest.c -- Unit tests of the PID hash table
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pidhash.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_KEYS 5000
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures += 1; \
+		} \
+	} while(0)
+
+/*
+ * Slot a key lands in when it is alone in a new (smallest) table
+ */
+static size_t homeslot(int key)
+{
+	struct hashtable *table = hashtnew();
+	hashtset(table, key, &key);
+
+	size_t result = 0;
+	while(table->items[result].valoc == NULL) {
+		++result;
+	}
+	hashtfree(table);
+	return result;
+}
+
+/*
+ * Find count keys (from *next upwards) whose home slot is home
+ */
+static void keysathome(size_t home, int *keys, int count, int *next)
+{
+	for (int i = 0; i < count; ++*next) {
+		if(homeslot(*next) == home) {
+			keys[i] = *next;
+			++i;
+		}
+	}
+}
+
+/*
+ * Every key in the reference can be found, and nothing else is stored
+ */
+static bool matches(struct hashtable *table, void **reference, int keys)
+{
+	size_t count = 0;
+	for (int key = 0; key < keys; ++key) {
+		if(hashtget(table, key) != reference[key]) {
+			return false;
+		}
+		if(reference[key]) {
+			++count;
+		}
+	}
+
+	size_t occupied = 0;
+	for (size_t i = 0; i < table->size; ++i) {
+		if(table->items[i].valoc) {
+			++occupied;
+		}
+	}
+	return (count == table->count) && (occupied == table->count);
+}
+
+static void testbasic(void)
+{
+	int one = 1;
+	int two = 2;
+	struct hashtable *table = hashtnew();
+	CHECK(table != NULL);
+	CHECK(hashtget(table, 42) == NULL);
+
+	hashtadd(table, 42, &one);
+	CHECK(hashtget(table, 42) == &one);
+	hashtset(table, 42, &two);
+	CHECK(hashtget(table, 42) == &two);
+	CHECK(table->count == 1);
+
+	// PID 0 (kernel_task) is a key like any other
+	hashtset(table, 0, &one);
+	CHECK(hashtget(table, 0) == &one);
+
+	CHECK(hashtdel(table, 42) == &two);
+	CHECK(hashtdel(table, 42) == NULL);
+	CHECK(hashtget(table, 42) == NULL);
+
+	// setting NULL removes the key
+	hashtset(table, 0, NULL);
+	CHECK(hashtget(table, 0) == NULL);
+	CHECK(table->count == 0);
+	hashtfree(table);
+}
+
+/*
+ * Deleting from a probe run which wraps from the last slot to the first
+ *  shifts the rest of the run back, but never before an item's home
+ */
+static void testwrappeddelete(void)
+{
+	size_t last = HASH_TABLE_MIN_SIZE - 1;
+	int next = 1;
+	int nexttolast[2];
+	int atlast[2];
+	int atfirst[1];
+	keysathome(last - 1, nexttolast, 2, &next);
+	keysathome(last, atlast, 2, &next);
+	keysathome(0, atfirst, 1, &next);
+
+	struct hashtable *table = hashtnew();
+	hashtset(table, nexttolast[0], &nexttolast[0]);
+	hashtset(table, nexttolast[1], &nexttolast[1]);
+	hashtset(table, atlast[0], &atlast[0]);
+	hashtset(table, atlast[1], &atlast[1]);
+	hashtset(table, atfirst[0], &atfirst[0]);
+
+	// one run from the next to last slot through slot 2
+	CHECK(table->items[last - 1].key == nexttolast[0]);
+	CHECK(table->items[last].key == nexttolast[1]);
+	CHECK(table->items[0].key == atlast[0]);
+	CHECK(table->items[1].key == atlast[1]);
+	CHECK(table->items[2].key == atfirst[0]);
+
+	// the hole in the last slot is filled across the wrap
+	CHECK(hashtdel(table, nexttolast[1]) == &nexttolast[1]);
+	CHECK(table->items[last].key == atlast[0]);
+	CHECK(table->items[0].key == atlast[1]);
+	CHECK(table->items[1].key == atfirst[0]);
+	CHECK(table->items[2].valoc == NULL);
+
+	// nothing can move into the next to last slot (it is no one's home)
+	CHECK(hashtdel(table, nexttolast[0]) == &nexttolast[0]);
+	CHECK(table->items[last - 1].valoc == NULL);
+	CHECK(table->items[last].key == atlast[0]);
+	CHECK(table->items[0].key == atlast[1]);
+	CHECK(table->items[1].key == atfirst[0]);
+
+	CHECK(hashtget(table, atlast[0]) == &atlast[0]);
+	CHECK(hashtget(table, atlast[1]) == &atlast[1]);
+	CHECK(hashtget(table, atfirst[0]) == &atfirst[0]);
+	CHECK(table->count == 3);
+	hashtfree(table);
+}
+
+/*
+ * Random sets and deletes, growing and shrinking, against a plain array
+ */
+static void testrandom(void)
+{
+	static void *reference[TEST_KEYS];
+	static int values[TEST_KEYS];
+	memset(reference, 0, sizeof(reference));
+
+	struct hashtable *table = hashtnew();
+	size_t largest = 0;
+	srand(3);
+	for (int round = 0; round < 20; ++round) {
+		// alternate between filling up and emptying out
+		int setpercent = (round % 2) ? 10 : 90;
+		for (int op = 0; op < 20000; ++op) {
+			int key = rand() % TEST_KEYS;
+			if((rand() % 100) < setpercent) {
+				hashtset(table, key, &values[key]);
+				reference[key] = &values[key];
+			} else {
+				CHECK(hashtdel(table, key) == reference[key]);
+				reference[key] = NULL;
+			}
+			if(table->size > largest) {
+				largest = table->size;
+			}
+		}
+		CHECK(matches(table, reference, TEST_KEYS));
+	}
+	// it grew and shrank again
+	CHECK(largest > HASH_TABLE_MIN_SIZE);
+	CHECK(table->size < largest);
+	hashtfree(table);
+}
+
+/*
+ * Iteration visits every item once, also after the table was resized,
+ *  and an iteration over a table that shrank stays inside the table
+ */
+static void testiterate(void)
+{
+	static int values[TEST_KEYS];
+	static int seen[TEST_KEYS];
+	struct hashtable *table = hashtnew();
+	for (int key = 0; key < TEST_KEYS; ++key) {
+		hashtset(table, key * 7, &values[key]);
+	}
+
+	memset(seen, 0, sizeof(seen));
+	size_t iter = 0;
+	int key = 0;
+	int *value = NULL;
+	while((value = (int *)hashtnext(table, &iter, &key))) {
+		CHECK(value == &values[key / 7]);
+		seen[key / 7] += 1;
+	}
+	for (int i = 0; i < TEST_KEYS; ++i) {
+		CHECK(seen[i] == 1);
+	}
+
+	// list while iterating, then delete (as the process cache sweep does),
+	// which shrinks the table
+	size_t size = table->size;
+	int *stale = (int *)malloc(sizeof(int) * TEST_KEYS);
+	int stalecount = 0;
+	iter = 0;
+	while((value = (int *)hashtnext(table, &iter, &key))) {
+		if(key % 10) {
+			stale[stalecount] = key;
+			++stalecount;
+		}
+	}
+	for (int i = 0; i < stalecount; ++i) {
+		CHECK(hashtdel(table, stale[i]) != NULL);
+	}
+	free(stale);
+	CHECK(table->size < size);
+
+	memset(seen, 0, sizeof(seen));
+	iter = 0;
+	while((value = (int *)hashtnext(table, &iter, &key))) {
+		seen[key / 7] += 1;
+	}
+	for (int i = 0; i < TEST_KEYS; ++i) {
+		CHECK(seen[i] == (((i * 7) % 10) ? 0 : 1));
+	}
+
+	// the table should not change while iterating, when it does the
+	// iteration may miss or repeat items, but an iterator left past the
+	// end of a table which shrank just ends (nothing is read past it)
+	size = table->size;
+	iter = size - 1;
+	for (int i = 0; i < TEST_KEYS; ++i) {
+		hashtdel(table, i * 7);
+	}
+	CHECK(table->size < size);
+	CHECK(hashtnext(table, &iter, &key) == NULL);
+	CHECK(table->count == 0);
+	hashtfree(table);
+}
+
+int main()
+{
+	testbasic();
+	testwrappeddelete();
+	testrandom();
+	testiterate();
+
+	if(failures) {
+		fprintf(stderr, "pidhashtest: %d failed\n", failures);
+		return 1;
+	}
+	printf("pidhashtest: ok\n");
+	return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ * procargsbench.c -- Benchmark of the process argument formatter against the old parser
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "procargs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the result size used for the top pane (SYSPROC_PATH_LENGTH)
+#define BENCH_RESULT_LENGTH 45
+
+//
+// The parser processArguments used to have, on a KERN_PROCARGS buffer
+// (the path, padding, then the arguments, no argc), with the sysctl
+// calls taken out
+//
+
+#define OLD_TRUNC_STRING_LENGTH 3
+#define OLD_TRUNC_CHAR '.'
+// how many arguments the old parser could index
+#define OLD_MAX_ARGS 1024
+
+static void oldformat(char *arglist, size_t templength, int sizelimit, char *resultLoc)
+{
+	int argcount = 0;
+	static int argstarts[OLD_MAX_ARGS];
+	int argstart = 0;
+	static int argsizes[OLD_MAX_ARGS];
+	int argsize = -1;
+	int skipcount = 0;
+	for(int i = 0; i < (int)templength; ++i) {
+		if(arglist[i] == '\0') {
+			if(arglist[i-1] == '\0') {
+				++skipcount;
+			} else {
+				argstarts[argcount] = argstart + skipcount;
+				argstart = i + 1;
+
+				argsizes[argcount] = i - (argsize + skipcount + 1);
+				argsize = i;
+
+				skipcount = 0;
+				++argcount;
+			}
+		} else if(arglist[i] == '=') {
+			break;
+		}
+	}
+
+	int resultlen = 0;
+	int resultoffset = 0;
+	for(int argno = 1; argno < argcount; ++argno) {
+		resultlen += (argsizes[argno] + 1);
+	}
+	if(resultlen > sizelimit) {
+		resultoffset = resultlen - sizelimit + OLD_TRUNC_STRING_LENGTH;
+		resultlen = sizelimit - OLD_TRUNC_STRING_LENGTH;
+	}
+
+	int currentarg = 1;
+	int currentargpos = argstarts[currentarg];
+	char currentchar = 0;
+	int stringpos = 0;
+	for(int i = 0; i < (int)(resultoffset + resultlen - 1); ++i) {
+		currentchar = arglist[currentargpos];
+		if(i >= resultoffset) {
+			if(currentchar != '\0'){
+				resultLoc[stringpos] = currentchar;
+			} else {
+				resultLoc[stringpos] = ' ';
+			}
+			++stringpos;
+		} else if (i >= (resultoffset - OLD_TRUNC_STRING_LENGTH)) {
+			resultLoc[stringpos] = OLD_TRUNC_CHAR;
+			++stringpos;
+		}
+
+		++currentargpos;
+		if(currentargpos > (argstarts[currentarg] + argsizes[currentarg])) {
+			++currentarg;
+			currentargpos = argstarts[currentarg];
+		}
+	}
+	resultLoc[stringpos] = '\0';
+}
+
+/*
+ * Lay out the same synthetic arguments as a KERN_PROCARGS2 buffer (with
+ *  argc) or a KERN_PROCARGS one (without), followed by an environment
+ */
+static size_t benchargs(char *buffer, int argc, int withargc)
+{
+	size_t length = 0;
+	if(withargc) {
+		memcpy(buffer, &argc, sizeof(int));
+		length += sizeof(int);
+	}
+	length += (size_t)sprintf(buffer + length, "/usr/bin/java") + 1;
+	memset(buffer + length, 0, 3);
+	length += 3;
+
+	length += (size_t)sprintf(buffer + length, "java") + 1;
+	for (int i = 1; i < argc; ++i) {
+		length += (size_t)sprintf(buffer + length, "-Dprop%d.name/value_%d", i, i * 7) + 1;
+	}
+	length += (size_t)sprintf(buffer + length, "PATH=/bin:/usr/bin") + 1;
+	return length;
+}
+
+static double benchclock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((double)now.tv_sec * 1000000000.0) + (double)now.tv_nsec;
+}
+
+int main()
+{
+	int counts[] = { 10, 1000, 10000 };
+	char result[BENCH_RESULT_LENGTH + 1];
+	volatile size_t sink = 0;
+
+	printf("%-8s %14s %14s\n", "args", "old ns/call", "new ns/call");
+	for (size_t c = 0; c < (sizeof(counts) / sizeof(counts[0])); ++c) {
+		int argc = counts[c];
+		int calls = 10000000 / argc;
+		char *oldargs = (char *)malloc((size_t)argc * 32 + 64);
+		char *newargs = (char *)malloc((size_t)argc * 32 + 64);
+		size_t oldlength = benchargs(oldargs, argc, 0);
+		size_t newlength = benchargs(newargs, argc, 1);
+
+		char oldtime[16] = "overflows";
+		if(argc < OLD_MAX_ARGS) {
+			double started = benchclock();
+			for (int i = 0; i < calls; ++i) {
+				oldformat(oldargs, oldlength, BENCH_RESULT_LENGTH, result);
+				sink += (size_t)result[0];
+			}
+			snprintf(oldtime, sizeof(oldtime), "%.1f", (benchclock() - started) / calls);
+		}
+
+		double started = benchclock();
+		for (int i = 0; i < calls; ++i) {
+			sink += procargsformat(newargs, newlength, result, sizeof(result));
+		}
+		printf("%-8d %14s %14.1f\n", argc, oldtime, (benchclock() - started) / calls);
+
+		free(oldargs);
+		free(newargs);
+	}
+	(void)sink;
+	return 0;
+}
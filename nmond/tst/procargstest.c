@@ -0,0 +1,367 @@
+/**
+ * procargstest.c -- Unit and fuzz tests of the process argument formatter
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "procargs.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BUFFER_SIZE (1024 * 1024 * 4)
+#define TEST_RESULT_SIZE 64
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures += 1; \
+		} \
+	} while(0)
+
+/*
+ * Lay out a KERN_PROCARGS2 buffer: argc, the executable path, padding,
+ *  the arguments and then the environment (each NUL terminated)
+ */
+static size_t buildargs(char *buffer, int argc, char **argv, int envc, char **envv)
+{
+	size_t length = 0;
+	memcpy(buffer, &argc, sizeof(int));
+	length += sizeof(int);
+
+	char *path = "/usr/bin/tool";
+	memcpy(buffer + length, path, strlen(path));
+	length += strlen(path);
+	memset(buffer + length, 0, 5);
+	length += 5;
+
+	for (int i = 0; i < argc; ++i) {
+		memcpy(buffer + length, argv[i], strlen(argv[i]) + 1);
+		length += strlen(argv[i]) + 1;
+	}
+	for (int i = 0; i < envc; ++i) {
+		memcpy(buffer + length, envv[i], strlen(envv[i]) + 1);
+		length += strlen(envv[i]) + 1;
+	}
+	return length;
+}
+
+/*
+ * What the formatter should produce: the non-empty arguments joined by
+ *  spaces, or when that is too long its tail behind "..."
+ */
+static void referenceformat(int argc, char **argv, char *result, size_t resultsize)
+{
+	size_t length = 0;
+	for (int i = 0; i < argc; ++i) {
+		if(argv[i][0]) {
+			length += (length ? 1 : 0) + strlen(argv[i]);
+		}
+	}
+
+	char *joined = (char *)malloc(length + 1);
+	char *end = joined;
+	for (int i = 0; i < argc; ++i) {
+		if(argv[i][0]) {
+			if(end != joined) {
+				*end++ = ' ';
+			}
+			end = stpcpy(end, argv[i]);
+		}
+	}
+	*end = '\0';
+
+	size_t capacity = resultsize - 1;
+	if((resultsize <= (PROCARGS_TRUNC_LENGTH + 1)) || (length == 0)) {
+		result[0] = '\0';
+	} else if(length <= capacity) {
+		strcpy(result, joined);
+	} else {
+		memset(result, PROCARGS_TRUNC_CHAR, PROCARGS_TRUNC_LENGTH);
+		strcpy(result + PROCARGS_TRUNC_LENGTH, joined + length - (capacity - PROCARGS_TRUNC_LENGTH));
+	}
+	free(joined);
+}
+
+/*
+ * Format a buffer copied to memory of exactly its length (so that
+ *  reading past it is caught by the address sanitizer)
+ */
+static size_t format(const char *buffer, size_t length, char *result, size_t resultsize)
+{
+	char *exact = (char *)malloc(length ? length : 1);
+	memcpy(exact, buffer, length);
+	size_t written = procargsformat(exact, length, result, resultsize);
+	free(exact);
+	return written;
+}
+
+static bool formats(int argc, char **argv, size_t resultsize, char *expected)
+{
+	static char buffer[TEST_BUFFER_SIZE];
+	char *envv[] = { "PATH=/bin:/usr/bin", "HOME=/var/root" };
+	size_t length = buildargs(buffer, argc, argv, 2, envv);
+
+	char result[TEST_RESULT_SIZE * 2];
+	size_t written = format(buffer, length, result, resultsize);
+	return (written == strlen(expected)) && (strcmp(result, expected) == 0);
+}
+
+static void testformat(void)
+{
+	char *simple[] = { "/usr/bin/tool", "-v", "--opt=value", "file" };
+	CHECK(formats(4, simple, TEST_RESULT_SIZE, "/usr/bin/tool -v --opt=value file"));
+	CHECK(formats(1, simple, TEST_RESULT_SIZE, "/usr/bin/tool"));
+	CHECK(formats(0, simple, TEST_RESULT_SIZE, ""));
+
+	// empty arguments are left out, along with their separator (an
+	// empty first argument cannot be told apart from the path padding)
+	char *empties[] = { "a", "", "", "b", "" };
+	CHECK(formats(5, empties, TEST_RESULT_SIZE, "a b"));
+
+	// exactly filling the result, then one character more
+	char *fit[] = { "abcd", "efgh" };
+	CHECK(formats(2, fit, 10, "abcd efgh"));
+	CHECK(formats(2, fit, 9, "... efgh"));
+	CHECK(formats(2, fit, 6, "...gh"));
+	// too small for anything after the "..."
+	CHECK(formats(2, fit, PROCARGS_TRUNC_LENGTH + 1, ""));
+}
+
+/*
+ * Buffers cut short or damaged, as a process changing its arguments
+ *  (or exiting) while they are read may leave them
+ */
+static void testdamaged(void)
+{
+	char buffer[256];
+	char result[TEST_RESULT_SIZE];
+	char *argv[] = { "alpha", "beta", "gamma" };
+	size_t length = buildargs(buffer, 3, argv, 0, NULL);
+
+	// nothing, or not even argc
+	CHECK(format(buffer, 0, result, sizeof(result)) == 0);
+	CHECK(result[0] == '\0');
+	CHECK(format(buffer, sizeof(int) - 1, result, sizeof(result)) == 0);
+
+	// no room for a result at all, it is left untouched
+	result[0] = 'x';
+	CHECK(format(buffer, length, result, 0) == 0);
+	CHECK(result[0] == 'x');
+
+	// cut in the middle of the path, or of the last argument (no NUL)
+	CHECK(format(buffer, sizeof(int) + 4, result, sizeof(result)) == 0);
+	CHECK(format(buffer, length - 3, result, sizeof(result)) == strlen("alpha beta gam"));
+	CHECK(strcmp(result, "alpha beta gam") == 0);
+
+	// argc larger than the arguments there are
+	int argc = 9;
+	memcpy(buffer, &argc, sizeof(int));
+	CHECK(format(buffer, length, result, sizeof(result)) == strlen("alpha beta gamma"));
+	CHECK(strcmp(result, "alpha beta gamma") == 0);
+
+	// and a negative argc
+	argc = -1;
+	memcpy(buffer, &argc, sizeof(int));
+	CHECK(format(buffer, length, result, sizeof(result)) == 0);
+	CHECK(result[0] == '\0');
+
+	// no NUL anywhere
+	memset(buffer, 'z', sizeof(buffer));
+	argc = 3;
+	memcpy(buffer, &argc, sizeof(int));
+	CHECK(format(buffer, sizeof(buffer), result, sizeof(result)) == 0);
+	CHECK(result[0] == '\0');
+}
+
+/*
+ * More arguments and longer arguments than a result can hold
+ */
+static void testoversized(void)
+{
+	static char buffer[TEST_BUFFER_SIZE];
+	char result[TEST_RESULT_SIZE];
+	char expected[TEST_RESULT_SIZE];
+
+	// far more arguments than the old parser could index (1024)
+	int argc = 100000;
+	char **argv = (char **)malloc(sizeof(char *) * (size_t)argc);
+	char *names[] = { "-Xmx4g", "-cp", "lib/a.jar:lib/b.jar", "--flag", "x" };
+	for (int i = 0; i < argc; ++i) {
+		argv[i] = names[i % 5];
+	}
+	size_t length = buildargs(buffer, argc, argv, 0, NULL);
+	referenceformat(argc, argv, expected, sizeof(expected));
+	CHECK(format(buffer, length, result, sizeof(result)) == (sizeof(result) - 1));
+	CHECK(strcmp(result, expected) == 0);
+	free(argv);
+
+	// one argument of a megabyte
+	char *huge = (char *)malloc(1024 * 1024 + 1);
+	for (int i = 0; i < (1024 * 1024); ++i) {
+		huge[i] = (char)('a' + (i % 26));
+	}
+	huge[1024 * 1024] = '\0';
+	length = buildargs(buffer, 1, &huge, 0, NULL);
+	referenceformat(1, &huge, expected, sizeof(expected));
+	CHECK(format(buffer, length, result, sizeof(result)) == (sizeof(result) - 1));
+	CHECK(strcmp(result, expected) == 0);
+	free(huge);
+}
+
+/*
+ * Random argument lists against the reference
+ */
+static void testrandom(void)
+{
+	static char buffer[TEST_BUFFER_SIZE];
+	char *argv[64];
+	char result[TEST_RESULT_SIZE];
+	char expected[TEST_RESULT_SIZE];
+	srand(3);
+
+	for (int round = 0; round < 50000; ++round) {
+		int argc = rand() % 64;
+		for (int i = 0; i < argc; ++i) {
+			int length = rand() % 12;
+			argv[i] = (char *)malloc((size_t)length + 1);
+			for (int c = 0; c < length; ++c) {
+				argv[i][c] = "abc/-.=_ 0123"[rand() % 13];
+			}
+			argv[i][length] = '\0';
+		}
+		size_t resultsize = (size_t)(rand() % TEST_RESULT_SIZE);
+		size_t length = buildargs(buffer, argc, argv, 0, NULL);
+
+		size_t written = format(buffer, length, result, resultsize);
+		if(resultsize) {
+			referenceformat(argc, argv, expected, resultsize);
+			CHECK(written == strlen(expected));
+			CHECK(strcmp(result, expected) == 0);
+		} else {
+			CHECK(written == 0);
+		}
+		for (int i = 0; i < argc; ++i) {
+			free(argv[i]);
+		}
+		if(failures) {
+			return;
+		}
+	}
+}
+
+/*
+ * The result of any buffer is a string that fits (the buffer is never
+ *  read or written out of bounds, the sanitizers check that part)
+ */
+static bool formatsanything(const char *buffer, size_t length, size_t resultsize)
+{
+	char *result = (char *)malloc(resultsize ? resultsize : 1);
+	size_t written = format(buffer, length, result, resultsize);
+	bool fits = (resultsize == 0) ? (written == 0) : ((written < resultsize) && (strlen(result) == written));
+	free(result);
+	return fits;
+}
+
+/*
+ * Random bytes, mostly NULs and a few letters, with a random argc
+ */
+static void testfuzz(void)
+{
+	char buffer[256];
+	srand(7);
+
+	for (int round = 0; round < 200000; ++round) {
+		size_t length = (size_t)(rand() % (int)sizeof(buffer));
+		for (size_t i = 0; i < length; ++i) {
+			buffer[i] = (rand() % 3) ? (char)('a' + (rand() % 3)) : '\0';
+		}
+		if((length >= sizeof(int)) && (rand() % 2)) {
+			int argc = (rand() % 40) - 5;
+			memcpy(buffer, &argc, sizeof(int));
+		}
+		CHECK(formatsanything(buffer, length, (size_t)(rand() % TEST_RESULT_SIZE)));
+		if(failures) {
+			return;
+		}
+	}
+}
+
+/*
+ * Format captured buffers (from sysctl KERN_PROCARGS2, one per file)
+ */
+static void testfiles(int count, char **paths)
+{
+	static char buffer[TEST_BUFFER_SIZE];
+	char result[TEST_RESULT_SIZE];
+
+	for (int i = 0; i < count; ++i) {
+		FILE *file = fopen(paths[i], "rb");
+		if(file == NULL) {
+			fprintf(stderr, "procargstest: cannot open %s\n", paths[i]);
+			failures += 1;
+			continue;
+		}
+		size_t length = fread(buffer, 1, sizeof(buffer), file);
+		fclose(file);
+
+		CHECK(formatsanything(buffer, length, sizeof(result)));
+		format(buffer, length, result, sizeof(result));
+		printf("%s: %s\n", paths[i], result);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1) {
+		testfiles(argc - 1, argv + 1);
+	} else {
+		testformat();
+		testdamaged();
+		testoversized();
+		testrandom();
+		testfuzz();
+	}
+
+	if(failures) {
+		fprintf(stderr, "procargstest: %d failed\n", failures);
+		return 1;
+	}
+	printf("procargstest: ok\n");
+	return 0;
+}
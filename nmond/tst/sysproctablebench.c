@@ -0,0 +1,143 @@
+/**
+ * sysproctablebench.c -- Benchmark of the top process selection and the snapshot copy
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sysinfo.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// rows shown by the top pane of a 60 line terminal
+#define BENCH_TOP_ROWS 56
+#define BENCH_ROUNDS 20
+
+static struct sysproctable *benchtable;
+
+/*
+ * The full sort uitop used to do (qsort stands in for the BSD heapsort)
+ */
+static int benchcomparecpu(const void *row1, const void *row2)
+{
+	return sysproctablecomparecpu(benchtable, *(const int *)row1, *(const int *)row2);
+}
+
+static double benchclock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((double)now.tv_sec * 1000.0) + ((double)now.tv_nsec / 1000000.0);
+}
+
+/*
+ * A walk of count processes, most of them idle (at 0% CPU)
+ */
+static void benchfill(struct sysproctable *table, struct sysproc *records, int count)
+{
+	sysproctablereserve(table, (size_t)count);
+	for (int row = 0; row < count; ++row) {
+		memset(&records[row], 0, sizeof(struct sysproc));
+		records[row].pid = 1 + (rand() % 4000000);
+		table->records[row] = &records[row];
+		table->order[row] = row;
+		table->pid[row] = records[row].pid;
+		table->percentage[row] = (rand() % 4) ? 0.0 : (double)(rand() % 10000) / 100.0;
+		table->residentmem[row] = (unsigned long long)(rand() % 1000000) * 4096;
+	}
+	table->count = (size_t)count;
+}
+
+int main()
+{
+	int counts[] = { 1000, 10000, 100000 };
+	srand(42);
+
+	printf("%-10s %14s %14s %8s %14s %14s\n", "processes", "full sort ms", "select ms", "same", "copy all ms", "copy top ms");
+	for (size_t c = 0; c < (sizeof(counts) / sizeof(counts[0])); ++c) {
+		int count = counts[c];
+		struct sysproctable table = SYSPROCTABLE_INIT;
+		struct sysproctable copy = SYSPROCTABLE_INIT;
+		struct sysproc *records = (struct sysproc *)malloc(sizeof(struct sysproc) * (size_t)count);
+		int *shuffled = (int *)malloc(sizeof(int) * (size_t)count);
+		int *sorted = (int *)malloc(sizeof(int) * (size_t)count);
+		benchfill(&table, records, count);
+		memcpy(shuffled, table.order, sizeof(int) * (size_t)count);
+		benchtable = &table;
+
+		double sorting = 0;
+		double selecting = 0;
+		double copying = 0;
+		double copyingtop = 0;
+		int same = 1;
+		for (int round = 0; round < BENCH_ROUNDS; ++round) {
+			memcpy(table.order, shuffled, sizeof(int) * (size_t)count);
+			double started = benchclock();
+			qsort(table.order, (size_t)count, sizeof(int), benchcomparecpu);
+			sorting += benchclock() - started;
+			memcpy(sorted, table.order, sizeof(int) * BENCH_TOP_ROWS);
+
+			memcpy(table.order, shuffled, sizeof(int) * (size_t)count);
+			started = benchclock();
+			sysproctableselect(&table, BENCH_TOP_ROWS, sysproctablecomparecpu);
+			selecting += benchclock() - started;
+			if(memcmp(sorted, table.order, sizeof(int) * BENCH_TOP_ROWS)) {
+				same = 0;
+			}
+
+			// each sample published to the UI is a copy of the table, with
+			// every record (spreadsheet files) or those of the top rows
+			started = benchclock();
+			sysproctablecopy(&copy, &table, SIZE_MAX, NULL);
+			copying += benchclock() - started;
+			started = benchclock();
+			sysproctablecopy(&copy, &table, BENCH_TOP_ROWS, sysproctablecomparecpu);
+			copyingtop += benchclock() - started;
+			if(memcmp(sorted, copy.order, sizeof(int) * BENCH_TOP_ROWS)) {
+				same = 0;
+			}
+		}
+		printf("%-10d %14.3f %14.3f %8s %14.3f %14.3f\n", count, sorting / BENCH_ROUNDS, selecting / BENCH_ROUNDS,
+			same ? "yes" : "NO", copying / BENCH_ROUNDS, copyingtop / BENCH_ROUNDS);
+		if(!same) {
+			return 1;
+		}
+		free(records);
+		free(shuffled);
+		free(sorted);
+	}
+	return 0;
+}
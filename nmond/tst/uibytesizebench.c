@@ -0,0 +1,114 @@
+/**
+ * uibytesizebench.c -- Benchmark of the readable byte counts
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "uibytesize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// about as many counts as the panes format in a busy second
+#define BENCH_COUNTS 1000000
+
+//
+// The formatter uireadablebytes used to be, which allocated its result
+//
+
+static char *oldreadablebytes(unsigned long long bytes)
+{
+	char *result = (char *)malloc(READABLE_BYTES_LENGTH);
+	char *suffix = "  ";
+	double number = (double)bytes;
+	if(bytes > BYTES_IN_KB_LIMIT) {
+		if(bytes > BYTES_IN_MB_LIMIT) {
+			if(bytes > BYTES_IN_GB_LIMIT) {
+				number = (double)bytes / BYTES_IN_GB;
+				suffix = "GB";
+			} else {
+				number = (double)bytes / BYTES_IN_MB;
+				suffix = "MB";
+			}
+		} else {
+			number = (double)bytes / BYTES_IN_KB;
+			suffix = "KB";
+		}
+	}
+	snprintf(result, READABLE_BYTES_LENGTH, "%3.3f%s", number, suffix);
+	return result;
+}
+
+static double benchclock()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((double)now.tv_sec * 1000000000.0) + (double)now.tv_nsec;
+}
+
+int main()
+{
+	unsigned long long *counts = (unsigned long long *)malloc(sizeof(unsigned long long) * BENCH_COUNTS);
+	if(counts == NULL) {
+		return 1;
+	}
+	// memory and disk sized counts, from bytes to terabytes
+	srand(1);
+	for (int i = 0; i < BENCH_COUNTS; ++i) {
+		counts[i] = (((unsigned long long)rand() << 31) ^ (unsigned long long)rand()) >> (rand() % 40);
+	}
+	volatile char sink = 0;
+
+	double started = benchclock();
+	for (int i = 0; i < BENCH_COUNTS; ++i) {
+		char *result = oldreadablebytes(counts[i]);
+		sink ^= result[0];
+		free(result);
+	}
+	double oldtime = (benchclock() - started) / BENCH_COUNTS;
+
+	char result[READABLE_BYTES_LENGTH];
+	started = benchclock();
+	for (int i = 0; i < BENCH_COUNTS; ++i) {
+		sink ^= uireadablebytes(result, counts[i])[0];
+	}
+	double newtime = (benchclock() - started) / BENCH_COUNTS;
+
+	printf("%-20s %14s\n", "", "ns/count");
+	printf("%-20s %14.1f\n", "malloc + snprintf", oldtime);
+	printf("%-20s %14.1f\n", "uireadablebytes", newtime);
+	free(counts);
+	(void)sink;
+	return 0;
+}
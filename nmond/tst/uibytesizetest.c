@@ -0,0 +1,202 @@
+/**
+ * uibytesizetest.c -- Table and differential tests of the readable byte counts
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "uibytesize.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if(!(condition)) { \
+			fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+			failures += 1; \
+		} \
+	} while(0)
+
+/*
+ * What uireadablebytes used to be: the count divided as a double and
+ *  printed with snprintf (the fixed-point version has to match it)
+ */
+static void oldreadablebytes(char *result, unsigned long long bytes)
+{
+	char *suffix = "  ";
+	double number = (double)bytes;
+	if(bytes > BYTES_IN_KB_LIMIT) {
+		if(bytes > BYTES_IN_MB_LIMIT) {
+			if(bytes > BYTES_IN_GB_LIMIT) {
+				number = (double)bytes / BYTES_IN_GB;
+				suffix = "GB";
+			} else {
+				number = (double)bytes / BYTES_IN_MB;
+				suffix = "MB";
+			}
+		} else {
+			number = (double)bytes / BYTES_IN_KB;
+			suffix = "KB";
+		}
+	}
+	snprintf(result, READABLE_BYTES_LENGTH, "%3.3f%s", number, suffix);
+}
+
+struct readable {
+	unsigned long long bytes;
+	char *text;
+};
+
+/*
+ * Counts around each unit and each unit limit, exact ties of the third
+ *  decimal, counts too large for a double, and the largest count
+ */
+static void testtable()
+{
+	struct readable table[] = {
+		{ 0ULL, "0.000  " },
+		{ 1ULL, "1.000  " },
+		{ 999ULL, "999.000  " },
+		{ 1000ULL, "1000.000 " },
+		{ 1001ULL, "0.978KB" },
+		{ 1023ULL, "0.999KB" },
+		{ 1024ULL, "1.000KB" },
+		{ 1025ULL, "1.001KB" },
+		{ 1536ULL, "1.500KB" },
+		{ 1537ULL, "1.501KB" },
+		{ 2049ULL, "2.001KB" },
+		{ 5125ULL, "5.005KB" },
+		{ 999999ULL, "976.562KB" },
+		{ 1000000ULL, "976.562KB" },
+		{ 1000001ULL, "0.954MB" },
+		{ 1048575ULL, "1.000MB" },
+		{ 1048576ULL, "1.000MB" },
+		{ 1048577ULL, "1.000MB" },
+		{ 1245184ULL, "1.188MB" }, // 1.1875, the tie goes to even
+		{ 3146240ULL, "3.000MB" },
+		{ 999999999ULL, "953.674MB" },
+		{ 1000000000ULL, "953.674MB" },
+		{ 1000000001ULL, "0.931GB" },
+		{ 1073741823ULL, "1.000GB" },
+		{ 1073741824ULL, "1.000GB" },
+		{ 1073741825ULL, "1.000GB" },
+		{ 7650410496ULL, "7.125GB" },
+		{ 7851737088ULL, "7.312GB" }, // 7.3125, the tie goes to even
+		{ 1073741823999ULL, "1000.000G" }, // the fraction carries
+		{ 1099511627775ULL, "1024.000G" },
+		{ 1099511627776ULL, "1024.000G" },
+		{ 1099511627777ULL, "1024.000G" },
+		{ 1125899906842623ULL, "1048576.0" },
+		{ 1125899906842624ULL, "1048576.0" },
+		{ 1125899906842625ULL, "1048576.0" },
+		{ 9007199254740992ULL, "8388608.0" },
+		{ 9007199254740993ULL, "8388608.0" }, // 2^53 + 1 does not fit a double
+		{ 9007199254740995ULL, "8388608.0" },
+		{ 1152921504606846975ULL, "107374182" },
+		{ 1152921504606846976ULL, "107374182" },
+		{ 1152921504606846977ULL, "107374182" },
+		{ ULLONG_MAX - 1, "171798691" },
+		{ ULLONG_MAX, "171798691" }, // rounds up to 2^64 as a double
+	};
+
+	char result[READABLE_BYTES_LENGTH];
+	for (size_t i = 0; i < (sizeof(table) / sizeof(table[0])); ++i) {
+		CHECK(uireadablebytes(result, table[i].bytes) == result);
+		if(strcmp(result, table[i].text)) {
+			fprintf(stderr, "uibytesizetest: %llu is \"%s\", not \"%s\"\n", table[i].bytes, result, table[i].text);
+			failures += 1;
+		}
+	}
+}
+
+static void checkold(unsigned long long bytes)
+{
+	char result[READABLE_BYTES_LENGTH];
+	char expected[READABLE_BYTES_LENGTH];
+	uireadablebytes(result, bytes);
+	oldreadablebytes(expected, bytes);
+	if(strcmp(result, expected)) {
+		fprintf(stderr, "uibytesizetest: %llu is \"%s\", snprintf gives \"%s\"\n", bytes, result, expected);
+		failures += 1;
+	}
+}
+
+/*
+ * Compare with snprintf on every small count, around each power of two
+ *  and ten, and on random counts of every width
+ */
+static void testold()
+{
+	for (unsigned long long bytes = 0; bytes < 100000ULL; ++bytes) {
+		checkold(bytes);
+	}
+	for (int bit = 0; bit < 64; ++bit) {
+		for (int delta = -3; delta <= 3; ++delta) {
+			checkold((1ULL << bit) + (unsigned long long)delta);
+		}
+	}
+	unsigned long long power = 1;
+	for (int digits = 0; digits < 20; ++digits) {
+		for (int delta = -3; delta <= 3; ++delta) {
+			checkold(power + (unsigned long long)delta);
+		}
+		power *= 10;
+	}
+
+	srand(1);
+	for (int i = 0; i < 1000000; ++i) {
+		int bits = rand() % 65;
+		unsigned long long bytes = ((unsigned long long)rand() << 42) ^ ((unsigned long long)rand() << 21) ^ (unsigned long long)rand();
+		if(bits < 64) {
+			bytes &= (1ULL << bits) - 1;
+		}
+		checkold(bytes);
+	}
+}
+
+int main()
+{
+	testtable();
+	testold();
+
+	if(failures) {
+		fprintf(stderr, "uibytesizetest: %d failed\n", failures);
+		return 1;
+	}
+	printf("uibytesizetest: ok\n");
+	return 0;
+}
@@ -36,100 +36,98 @@
  */
 
 #include "uibytesize.h"
-#include <stdlib.h>
-#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
 
-#define RESULT_LENGTH 10
+// decimal places shown, and the scale of the fraction (10^READABLE_DECIMALS)
+#define READABLE_DECIMALS 3
+#define READABLE_SCALE 1000ULL
+// significant bits of a double, larger counts are rounded to fit in one
+#define READABLE_DOUBLE_BITS 53
 
-char *uireadablebytes(unsigned int bytes)
+/*
+ * Write a byte count in human-readable form ("1.500KB") into result, which
+ *  must hold READABLE_BYTES_LENGTH characters, and return result; the text
+ *  is what snprintf("%3.3f%s") gives for the count divided (as a double) by
+ *  its unit, cut short to fit, but it is worked out in fixed-point and
+ *  without allocating (the units are powers of two, so the division is
+ *  exact and the fraction is rounded half to even, as printf rounds it)
+ */
+char *uireadablebytes(char *result, unsigned long long bytes)
 {
-	char *result = malloc(RESULT_LENGTH);
-	if(result == NULL) {
-		// TODO: handle memory allocation failure
-	}
-	char *resultsufix = NULL;//malloc(2);
-	double resultnumber = 0;
-
+	int shift = 0;
+	char *suffix = "  ";
 	if(bytes > BYTES_IN_KB_LIMIT) {
 		if(bytes > BYTES_IN_MB_LIMIT) {
 			if(bytes > BYTES_IN_GB_LIMIT) {
-				resultnumber = bytes / BYTES_IN_GB;
-				resultsufix = "GB";
+				shift = 30;
+				suffix = "GB";
 			} else {
-				resultnumber = bytes / BYTES_IN_MB;
-				resultsufix = "MB";
+				shift = 20;
+				suffix = "MB";
 			}
 		} else {
-			resultnumber = bytes / BYTES_IN_KB;
-			resultsufix = "KB";
+			shift = 10;
+			suffix = "KB";
 		}
-	} else {
-		resultnumber = bytes;
-		resultsufix = "  ";
 	}
 
-	snprintf(result, RESULT_LENGTH, "%3.2f%s", resultnumber, resultsufix);
-	return result;
-}
-
-char *uireadablebyteslong(unsigned long bytes)
-{
-	char *result = malloc(RESULT_LENGTH);
-	if(result == NULL) {
-		// TODO: handle memory allocation failure
+	// the count as a double would hold it (rounded half to even), the
+	// rounding can carry out of 64 bits
+	bool carried = false;
+	int bits = READABLE_DOUBLE_BITS;
+	while((bits < 64) && (bytes >> bits)) {
+		++bits;
 	}
-	char *resultsufix = NULL;//malloc(2);
-	double resultnumber = 0;
-
-	if(bytes > BYTES_IN_KB_LIMIT) {
-		if(bytes > BYTES_IN_MB_LIMIT) {
-			if(bytes > BYTES_IN_GB_LIMIT) {
-				resultnumber = bytes / BYTES_IN_GB;
-				resultsufix = "GB";
-			} else {
-				resultnumber = bytes / BYTES_IN_MB;
-				resultsufix = "MB";
-			}
-		} else {
-			resultnumber = bytes / BYTES_IN_KB;
-			resultsufix = "KB";
+	if(bits > READABLE_DOUBLE_BITS) {
+		int drop = bits - READABLE_DOUBLE_BITS;
+		unsigned long long low = bytes & ((1ULL << drop) - 1);
+		unsigned long long half = 1ULL << (drop - 1);
+		bytes -= low;
+		if((low > half) || ((low == half) && ((bytes >> drop) & 1))) {
+			bytes += 1ULL << drop;
+			carried = !bytes;
 		}
-	} else {
-		resultnumber = bytes;
-		resultsufix = "  ";
 	}
 
-	snprintf(result, RESULT_LENGTH, "%3.3f%s", resultnumber, resultsufix);
-	return result;
-}
+	unsigned long long whole = carried ? (1ULL << (64 - shift)) : (bytes >> shift);
+	unsigned long long fraction = bytes & ((1ULL << shift) - 1);
 
-char *uireadablebyteslonglong(unsigned long long bytes)
-{
-	char *result = malloc(RESULT_LENGTH);
-	if(result == NULL) {
-		// TODO: handle memory allocation failure
+	// the fraction to READABLE_DECIMALS places, rounded half to even
+	unsigned long long scaled = fraction * READABLE_SCALE;
+	unsigned long long decimals = scaled >> shift;
+	if(shift) {
+		unsigned long long rest = scaled & ((1ULL << shift) - 1);
+		unsigned long long half = 1ULL << (shift - 1);
+		if((rest > half) || ((rest == half) && (decimals & 1))) {
+			decimals += 1;
+		}
+	}
+	if(decimals == READABLE_SCALE) {
+		whole += 1;
+		decimals = 0;
 	}
-	char *resultsufix = NULL;//malloc(2);
-	double resultnumber = 0;
 
-	if(bytes > BYTES_IN_KB_LIMIT) {
-		if(bytes > BYTES_IN_MB_LIMIT) {
-			if(bytes > BYTES_IN_GB_LIMIT) {
-				resultnumber = bytes / BYTES_IN_GB;
-				resultsufix = "GB";
-			} else {
-				resultnumber = bytes / BYTES_IN_MB;
-				resultsufix = "MB";
-			}
-		} else {
-			resultnumber = bytes / BYTES_IN_KB;
-			resultsufix = "KB";
-		}
-	} else {
-		resultnumber = bytes;
-		resultsufix = "  ";
+	// written right to left, then as much as fits is copied
+	char text[32];
+	int at = (int)sizeof(text);
+	text[--at] = suffix[1];
+	text[--at] = suffix[0];
+	for (int i = 0; i < READABLE_DECIMALS; ++i) {
+		text[--at] = (char)('0' + (decimals % 10));
+		decimals /= 10;
 	}
+	text[--at] = '.';
+	do {
+		text[--at] = (char)('0' + (whole % 10));
+		whole /= 10;
+	} while(whole);
 
-	snprintf(result, RESULT_LENGTH, "%3.3f%s", resultnumber, resultsufix);
+	size_t length = sizeof(text) - (size_t)at;
+	if(length > (READABLE_BYTES_LENGTH - 1)) {
+		length = READABLE_BYTES_LENGTH - 1;
+	}
+	memcpy(result, text + at, length);
+	result[length] = '\0';
 	return result;
 }
@@ -47,8 +47,9 @@
 #define BYTES_IN_MB_LIMIT 1000000.0
 #define BYTES_IN_GB_LIMIT 1000000000.0
 
-extern char *uireadablebytes(unsigned int);
-extern char *uireadablebyteslong(unsigned long);
-extern char *uireadablebyteslonglong(unsigned long long);
+// characters in a readable byte count, with its terminator ("999.999MB")
+#define READABLE_BYTES_LENGTH 10
+
+extern char *uireadablebytes(char*, unsigned long long);
 
 #endif
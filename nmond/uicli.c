@@ -36,12 +36,22 @@
  */
 
 #include "uicli.h"
+#include "burst.h"
 #include <stdio.h>
 
 void uiclhint()
 {
-	printf("\nHint: nmond [-h] [-s <seconds>] [-c <count>] [-f -d <disks> -t -r <name>] [-x]\n\n");
+	printf("\nHint: nmond [-h] [-s <seconds>] [-c <count>] [-f -d <disks> -t -r <name>] [-x] [-w <threads>] [-n <count>] [-z <hz>] [-B] [-o <file>] [-P <file>] [-R <file>] [-M <address> -p <count>] [-m <dir>]\n\n");
 	printf("\t-h            FULL help information\n");
+	printf("\t-w <threads>  sample processes with this many threads [default 1]\n");
+	printf("\t-n <count>    sample at most this many processes per refresh [default all]\n");
+	printf("\t-z <hz>       also sample CPU and network this often, show peaks [default off]\n");
+	printf("\t-B            batch mode, write a record per sample to stdout (no screen)\n");
+	printf("\t-o <file>     also record each sample to a binary file\n");
+	printf("\t-P <file>     play a recording back instead of sampling (- for stdin)\n");
+	printf("\t-R <file>     keep minute, hour, day and month summaries in a file\n");
+	printf("\t-M <address>  serve OpenMetrics on [host]:port or a socket path\n");
+	printf("\t-p <count>    with the busiest processes [default 0, at most 100]\n");
 	printf("\tInteractive-Mode:\n");
 	printf("\tread startup banner and type: \"h\" once it is running\n");
 	printf("\tFor Data-Collect-Mode (-f)\n");
@@ -69,13 +79,36 @@ void uiclhelp(char *version)
 	printf("\t              - disks can appear more than once and in many groups\n");
 	printf("\t-g auto       - will make a file called \"auto\" with just disks fron \"lsblk|grep disk\" output\n");
 	printf("\t-b            black and white [default is colour]\n");
+	printf("\t-w <threads>  sample processes with this many threads [default 1]\n");
+	printf("\t              - helps on machines with many cores and processes\n");
+	printf("\t-n <count>    sample at most this many processes per refresh [default all]\n");
+	printf("\t              - idle processes are always sampled less often than busy ones\n");
+	printf("\t-z <hz>       also sample CPU and network %d to %d times a second [default off]\n", BURST_MIN_HZ, BURST_MAX_HZ);
+	printf("\t              - each refresh shows the avg, min, max and p99 of these samples\n");
+	printf("\t              - hit z to hide or show the peak markers on the CPU bars\n");
+	printf("\t-B            batch mode, no screen: each sample is written to stdout\n");
+	printf("\t              - one line of key=value fields, rates are per second\n");
+	printf("\t              - stops after -c samples, or on SIGINT/SIGTERM\n");
+	printf("\t-o <file>     also record each sample to a binary file (appends to a recording)\n");
+	printf("\t              - works on screen and in batch mode\n");
+	printf("\t-P <file>     play a recording (-o) back through the panes, - reads stdin\n");
+	printf("\t              - space pauses, . steps, < and > halve or double the speed\n");
+	printf("\t              - / seeks to +/-seconds, HH:MM[:SS] or YYYY-MM-DD HH:MM[:SS]\n");
+	printf("\texample: ssh host cat day.rec | nmond -P -\n");
+	printf("\t-R <file>     keep minute, hour, day and month summaries in a file\n");
+	printf("\t-M <address>  serve OpenMetrics on [host]:port or a socket path\n");
+	printf("\t-p <count>    with the busiest processes [default 0, at most 100]\n");
+	printf("\t              - the file stays the same size (under 500 KB) however long it is kept\n");
+	printf("\t              - hit l to switch the CPU, disk and network graphs between them\n");
+	printf("\texample: nmond -B -s 1 -c 3600 > hour.log\n");
 	printf("\texample: nmond -s 1 -c 100\n");
 	printf("\n");
 	printf("For Data-Collect-Mode = spreadsheet format (comma separated values)\n");
 	printf("\tNote: use only one of f,F,z,x or X and make it the first argument\n");
 	printf("\t-f            spreadsheet output format [note: default -s300 -c288]\n");
-	printf("\t\t\t output file is <hostname>_YYYYMMDD_HHMM.nmon\n");
-	printf("\t-F <filename> same as -f but user supplied filename\n");
+	printf("\t\t\t output file is <hostname>_YYMMDD_HHMM.nmon, a new one each day\n");
+	printf("\t\t\t nmond carries on in the background, as nmon does\n");
+	printf("\t-F <filename> same as -f but user supplied filename (no new file each day)\n");
 	printf("\t-r <runname>  used in the spreadsheet file [default hostname]\n");
 	printf("\t-t            include top processes in the output\n");
 	printf("\t-T            as -t plus saves command line arguments in UARG section\n");
@@ -89,7 +122,7 @@ void uiclhelp(char *version)
 	printf("\t-N            include NFS Network File System\n");
 	printf("\t-I <percent>  Include process & disks busy threshold (default 0.1)\n");
 	printf("\t              don't save or show proc/disk using less than this percent\n");
-	printf("\t-m <directory> nmon changes to this directory before saving to file\n");
+	printf("\t-m <directory> the spreadsheet files are saved in this directory\n");
 	printf("\texample: collect for 1 hour at 30 second intervals with top procs\n");
 	printf("\t\t nmond -f -t -r Test1 -s30 -c120\n");
 	printf("\n");
@@ -38,6 +38,7 @@
 #include "uicurses.h"
 #include <sys/sysctl.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include "uibytesize.h"
 
@@ -45,6 +46,8 @@
  * Helpers
  */
 
+unsigned long uipadcells = 0;
+
 static inline void uidisplay(WINDOW *win, int *currow, int cols, int lines, int rows)
 {
 	int rowstart = *currow + 1;
@@ -83,9 +86,7 @@ static inline void uibanner(WINDOW *win, int cols, char *string)
 	wmove(win, 0, 0);
 
 	wattron(win, A_STANDOUT);
-	wprintw(win, " ");
-	wprintw(win, string);
-	wprintw(win, " ");
+	wprintw(win, " %s ", string);
 	wattroff(win, A_STANDOUT);
 }
 
@@ -293,7 +294,14 @@ void uiheader(WINDOW **win, int currow, int usecolor, int blinkon, char *hostnam
 			attrset(COLOR_PAIR(0));
 		}
 	}
-	mvwprintw(*win, currow, 64, "%1.0fs", elapsed);
+	// sub-second refresh delays are shown in milliseconds
+	char interval[8];
+	if(elapsed < 1) {
+		snprintf(interval, sizeof(interval), "%.0fms", elapsed * 1000);
+	} else {
+		snprintf(interval, sizeof(interval), "%.0fs", elapsed);
+	}
+	mvwprintw(*win, currow, 64, "%-6.6s", interval);
 	mvwprintw(*win, currow, 70, "%02d:%02d.%02d", tim->tm_hour, tim->tm_min, tim->tm_sec);
 
 	wnoutrefresh(*win);
@@ -352,20 +360,20 @@ void uihelp(WINDOW **win, int winheight, int *currow, int cols, int lines)
 	}
 
 	mvwprintw(*win, *currow+1,  0, "  [ a =                               ][ N =  Network Usage, long-term     ]");
-	mvwprintw(*win, *currow+2,  0, "  [ b = Black & White mode            ][ o =                               ]");
+	mvwprintw(*win, *currow+2,  0, "  [ b = Black & White mode            ][ p = Profile of nmond (timings)    ]");
 	mvwprintw(*win, *currow+3,  0, "  [ c = CPU Load                      ][ r = Top Processes, order by mem   ]");
 	mvwprintw(*win, *currow+4,  0, "  [ C = CPU Load, long-term           ][ R = Top Processes, command by mem ]");
 	mvwprintw(*win, *currow+5,  0, "  [ d = Disk Usage                    ][ t = Top Processes, order by proc  ]");
 	mvwprintw(*win, *currow+6,  0, "  [ D = Disk Usage, long-term         ][ T = Top Processes, command by prc ]");
 	mvwprintw(*win, *currow+7,  0, "  [ e = Energy Usage (CPU)            ][ v =                               ]");
 	mvwprintw(*win, *currow+8,  0, "  [ g = GPU Load                      ][ w =                               ]");
-	mvwprintw(*win, *currow+9,  0, "  [ f =                               ][                                   ]");
+	mvwprintw(*win, *currow+9,  0, "  [ f =                               ][ z = CPU peak markers (with -z)    ]");
 	mvwprintw(*win, *currow+10, 0, "  [ h = Help                          ][                                   ]");
 	mvwprintw(*win, *currow+11, 0, "  [ i = About This Mac                ][ - = Reduce refresh delay (half)   ]");
 	mvwprintw(*win, *currow+12, 0, "  [ I =                               ][ + = Increase refresh delay (2x)   ]");
-	mvwprintw(*win, *currow+13, 0, "  [ k =                               ][                                   ]");
+	mvwprintw(*win, *currow+13, 0, "  [ l = Long-term resolution (-R)     ][ / . < > space = Replay (-P)       ]");
 	mvwprintw(*win, *currow+14, 0, "  [ m = Memory Usage                  ][ ? = Help                          ]");
-	mvwprintw(*win, *currow+15, 0, "  [ M =                               ][                                   ]");
+	mvwprintw(*win, *currow+15, 0, "  [ M = CPU Map (heatmap by core)     ][ L = Reload hardware/OS details    ]");
 	mvwprintw(*win, *currow+16, 0, "  [ n = Network Usage                 ][ q = Quit/Exit                     ]");
 	mvwprintw(*win, *currow+17, 0, "                                                                            ");
 	mvwprintw(*win, *currow+18, 0, "          %s version %s build %s", APPNAME, VERSION, VERDATE);
@@ -375,8 +383,148 @@ void uihelp(WINDOW **win, int winheight, int *currow, int cols, int lines)
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
-static void uicpudetail(WINDOW *win, int cpuno, int row, int usecolor, double user, double sys, double idle, double nice)
+/*
+ * Forget what a pane drew when its size, position or colors change, the
+ *  whole pane is then drawn on the next frame
+ */
+static void uidamagesize(struct uidamage *damage, size_t count, int origin, int usecolor)
+{
+	if((damage->count != count) || (damage->origin != origin) || (damage->usecolor != usecolor)) {
+		damage->valid = false;
+	}
+	damage->origin = origin;
+	damage->usecolor = usecolor;
+	if(damage->count == count) {
+		return;
+	}
+
+	int *cells = (int *)realloc(damage->cells, sizeof(int) * count);
+	if(cells == NULL) {
+		// TODO: handle memory allocation failure
+		free(damage->cells);
+		damage->cells = NULL;
+		damage->count = 0;
+		return;
+	}
+	damage->cells = cells;
+	damage->count = count;
+}
+
+/*
+ * The pane is drawn, what it remembers is good for the next frame
+ *  (without memory to remember in, every frame draws it all)
+ */
+static inline void uidamagedone(struct uidamage *damage)
+{
+	damage->valid = (damage->cells != NULL);
+}
+
+void uidamagefree(struct uidamage *damage)
+{
+	free(damage->cells);
+	damage->cells = NULL;
+	damage->count = 0;
+	damage->valid = false;
+}
+
+/*
+ * The title bar, only drawn with the whole pane or when the title changed
+ */
+static void uidamagebanner(WINDOW *win, struct uidamage *damage, int cols, char *title)
 {
+	if(damage->valid && !strcmp(damage->title, title)) {
+		return;
+	}
+	snprintf(damage->title, sizeof(damage->title), "%s", title);
+	uibanner(win, cols, title);
+	uipadcells += (unsigned long)(cols - 2);
+}
+
+/*
+ * A cell of a bar, the kind of time (or transfer) it stands for picks
+ *  the color (or the character without colors)
+ */
+static void uibarcell(WINDOW *win, int row, int col, int usecolor, int kind, chtype mark)
+{
+	if(kind == UI_CELL_FIRST) {
+		if(usecolor) {
+			wattrset(win, COLOR_PAIR(10));
+			mvwaddch(win, row, col, mark);
+		} else {
+			wattron(win, A_STANDOUT);
+			mvwaddch(win, row, col, ACS_CKBOARD);
+			wattroff(win, A_STANDOUT);
+		}
+	} else if(kind == UI_CELL_SECOND) {
+		if(usecolor) {
+			wattrset(win, COLOR_PAIR(8));
+			mvwaddch(win, row, col, mark);
+		} else {
+			mvwaddch(win, row, col, ACS_CKBOARD);
+		}
+	} else if(kind == UI_CELL_THIRD) {
+		if(usecolor) {
+			wattrset(win, COLOR_PAIR(9));
+			mvwaddch(win, row, col, mark);
+		} else {
+			mvwaddch(win, row, col, ACS_DIAMOND);
+		}
+	} else {
+		wattrset(win, COLOR_PAIR(0));
+		mvwaddch(win, row, col, mark);
+	}
+	wattrset(win, COLOR_PAIR(0));
+	uipadcells += 1;
+}
+
+/*
+ * Mark the busiest burst sample of a CPU on its bar
+ */
+static void uicpupeak(WINDOW *win, int row, int usecolor, int col)
+{
+	if(usecolor) {
+		wattrset(win, COLOR_PAIR(1));
+		mvwaddch(win, row, col, '>');
+		wattrset(win, COLOR_PAIR(0));
+	} else {
+		wattron(win, A_BOLD);
+		mvwaddch(win, row, col, '>');
+		wattroff(win, A_BOLD);
+	}
+	uipadcells += 1;
+}
+
+/*
+ * The column of the bar which marks a burst peak
+ */
+static inline int uicpupeakcol(double max)
+{
+	int col = 28 + (int)(round(max) / 2);
+	if(col > 76) {
+		col = 76;
+	}
+	return col;
+}
+
+/*
+ * A CPU row, only drawn when its numbers, bar or burst peak column (-1
+ *  for none) are not the ones remembered in drawn[0..7]
+ */
+static void uicpudetail(WINDOW *win, struct uidamage *damage, int *drawn, int cpuno, int row, int usecolor, double user, double sys, double idle, double nice, int peak)
+{
+	int userquant = (int)(round(user) / 2);
+	int systquant = (int)(round(sys) / 2);
+	int nicequant = (int)(round(nice) / 2);
+	if(drawn) {
+		// the numbers are kept in hundredths, as they are shown
+		int shown[8] = { (int)round(user * 100), (int)round(sys * 100), (int)round(nice * 100), \
+			(int)round(idle * 100), userquant, systquant, nicequant, peak };
+		if(damage->valid && !memcmp(drawn, shown, sizeof(shown))) {
+			return;
+		}
+		memcpy(drawn, shown, sizeof(shown));
+	}
+
 	if(cpuno == -1) {
 		mvwprintw(win, row, 0, "Avg");
 	} else {
@@ -386,19 +534,16 @@ static void uicpudetail(WINDOW *win, int cpuno, int row, int usecolor, double us
 	mvwprintw(win, row, 10, "%4.2f ", sys);
 	mvwprintw(win, row, 16, "%4.2f ", nice);
 	mvwprintw(win, row, 22, "%4.2f ", idle);
+	uipadcells += 27;
+
 	if(((cpuno + 1) % 2) || (cpuno < 0)) {
 		mvwaddch(win, row, 27, ACS_VLINE);
 	} else {
 		mvwaddch(win, row, 27, ACS_LTEE);
 	}
 
-	wmove(win, row, 28);
-
 	chtype metermark;
-
-	int userquant = (int)(round(user) / 2);
-	int systquant = (int)(round(sys) / 2);
-	int nicequant = (int)(round(nice) / 2);
+	int kind;
 	for(int i=28; i<77; ++i){
 		if(((i + 3) % 5) == 0) {
 			if(((cpuno + 1) % 2) || (cpuno < 0)) {
@@ -419,49 +564,32 @@ static void uicpudetail(WINDOW *win, int cpuno, int row, int usecolor, double us
 		}
 
 		if(userquant) {
-			if(usecolor) {
-				wattrset(win, COLOR_PAIR(10));
-				waddch(win, metermark);
-			} else {
-				wattron(win, A_STANDOUT);
-				waddch(win, ACS_CKBOARD);
-				wattroff(win, A_STANDOUT);
-			}
+			kind = UI_CELL_FIRST;
 			--userquant;
+		} else if(systquant) {
+			kind = UI_CELL_SECOND;
+			--systquant;
+		} else if(nicequant) {
+			kind = UI_CELL_THIRD;
+			--nicequant;
 		} else {
-			if(systquant) {
-				if(usecolor) {
-					wattrset(win, COLOR_PAIR(8));
-					waddch(win, metermark);
-				} else {
-					waddch(win, ACS_CKBOARD);
-				}
-				--systquant;
-			} else {
-				if(nicequant) {
-					if(usecolor) {
-						wattrset(win, COLOR_PAIR(9));
-						waddch(win, metermark);
-					} else {
-						waddch(win, ACS_DIAMOND);
-					}
-					--nicequant;
-				} else {
-					wattrset(win, COLOR_PAIR(0));
-					waddch(win, metermark);
-				}
-			}
+			kind = UI_CELL_EMPTY;
 		}
+		uibarcell(win, row, i, usecolor, kind, metermark);
 	}
-	wattrset(win, COLOR_PAIR(0));
 	if(((cpuno + 1) % 2) || (cpuno < 0)) {
 		mvwaddch(win, row, 77, ACS_VLINE);
 	} else {
 		mvwaddch(win, row, 77, ACS_RTEE);
 	}
+	uipadcells += 2;
+
+	if(peak >= 0) {
+		uicpupeak(win, row, usecolor, peak);
+	}
 }
 
-void uicpu(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct sysres thisres, int show_raw)
+void uicpu(WINDOW **win, struct uidamage *damage, int winheight, int *currow, int cols, int lines, int usecolor, struct sysres thisres, struct sysburst *burst, bool peaks, int show_raw)
 {
 	if (*win == NULL) {
 		return;
@@ -472,65 +600,195 @@ void uicpu(WINDOW **win, int winheight, int *currow, int cols, int lines, int us
 		*currow = 0;
 	}
 
-	mvwprintw(*win, *currow+1, 0, "CPU");
-	if(usecolor) {
-		wattrset(*win, COLOR_PAIR(4));
-		mvwprintw(*win, *currow+1, 4, "User%%");
-		wattrset(*win, COLOR_PAIR(1));
-		mvwprintw(*win, *currow+1, 10, "Sys %%");
-		wattrset(*win, COLOR_PAIR(2));
-		mvwprintw(*win, *currow+1, 16, "Nice%%");
-		wattrset(*win, COLOR_PAIR(0));
-		mvwprintw(*win, *currow+1, 22, "Idle");
-	} else {
-		mvwprintw(*win, *currow+1, 4, "User%%");
-		mvwprintw(*win, *currow+1, 10, "Sys %%");
-		mvwprintw(*win, *currow+1, 16, "Wait%%");
-		mvwprintw(*win, *currow+1, 22, "Idle");
-	}
-	mvwhline(*win, *currow+1, 27, ACS_HLINE, 50);
-	mvwaddch(*win, *currow+1, 27, ACS_ULCORNER);
-	mvwaddch(*win, *currow+1, 32, ACS_TTEE);
-	mvwprintw(*win, *currow+1, 35, "20");
-	mvwaddch(*win, *currow+1, 37, ACS_PLUS);
-	mvwaddch(*win, *currow+1, 42, ACS_TTEE);
-	mvwprintw(*win, *currow+1, 45, "40");
-	mvwaddch(*win, *currow+1, 47, ACS_PLUS);
-	mvwaddch(*win, *currow+1, 52, ACS_TTEE);
-	mvwprintw(*win, *currow+1, 55, "60");
-	mvwaddch(*win, *currow+1, 57, ACS_PLUS);
-	mvwaddch(*win, *currow+1, 62, ACS_TTEE);
-	mvwprintw(*win, *currow+1, 65, "80");
-	mvwaddch(*win, *currow+1, 67, ACS_PLUS);
-	mvwaddch(*win, *currow+1, 72, ACS_TTEE);
-	mvwaddch(*win, *currow+1, 77, ACS_URCORNER);
+	// the numbers and bar of each CPU and the average are remembered
+	uidamagesize(damage, (size_t)(thisres.cpucount + 1) * 8, *currow, usecolor);
+
+	// the scale does not change, it is only drawn with the whole pane
+	if(!damage->valid) {
+		mvwprintw(*win, *currow+1, 0, "CPU");
+		if(usecolor) {
+			wattrset(*win, COLOR_PAIR(4));
+			mvwprintw(*win, *currow+1, 4, "User%%");
+			wattrset(*win, COLOR_PAIR(1));
+			mvwprintw(*win, *currow+1, 10, "Sys %%");
+			wattrset(*win, COLOR_PAIR(2));
+			mvwprintw(*win, *currow+1, 16, "Nice%%");
+			wattrset(*win, COLOR_PAIR(0));
+			mvwprintw(*win, *currow+1, 22, "Idle");
+		} else {
+			mvwprintw(*win, *currow+1, 4, "User%%");
+			mvwprintw(*win, *currow+1, 10, "Sys %%");
+			mvwprintw(*win, *currow+1, 16, "Wait%%");
+			mvwprintw(*win, *currow+1, 22, "Idle");
+		}
+		mvwhline(*win, *currow+1, 27, ACS_HLINE, 50);
+		mvwaddch(*win, *currow+1, 27, ACS_ULCORNER);
+		mvwaddch(*win, *currow+1, 32, ACS_TTEE);
+		mvwprintw(*win, *currow+1, 35, "20");
+		mvwaddch(*win, *currow+1, 37, ACS_PLUS);
+		mvwaddch(*win, *currow+1, 42, ACS_TTEE);
+		mvwprintw(*win, *currow+1, 45, "40");
+		mvwaddch(*win, *currow+1, 47, ACS_PLUS);
+		mvwaddch(*win, *currow+1, 52, ACS_TTEE);
+		mvwprintw(*win, *currow+1, 55, "60");
+		mvwaddch(*win, *currow+1, 57, ACS_PLUS);
+		mvwaddch(*win, *currow+1, 62, ACS_TTEE);
+		mvwprintw(*win, *currow+1, 65, "80");
+		mvwaddch(*win, *currow+1, 67, ACS_PLUS);
+		mvwaddch(*win, *currow+1, 72, ACS_TTEE);
+		mvwaddch(*win, *currow+1, 77, ACS_URCORNER);
+		uipadcells += 78;
+	}
+
+	// the burst samples taken since the last refresh (-z)
+	bool showpeaks = peaks && burst->hz && (burst->cpucount == thisres.cpucount);
 
 	int cpuno = 0;
+	int *drawn = NULL;
 	for (cpuno = 0; cpuno < thisres.cpucount; ++cpuno) {
-	 	mvwaddch(*win, (*currow+2 + cpuno), 77, ACS_VLINE);
-		uicpudetail(*win, cpuno, (*currow+2 + cpuno), usecolor,
+		drawn = damage->cells ? (damage->cells + (cpuno * 8)) : NULL;
+		uicpudetail(*win, damage, drawn, cpuno, (*currow+2 + cpuno), usecolor,
 			thisres.cpus[cpuno].percentuser,
 			thisres.cpus[cpuno].percentsys,
 			thisres.cpus[cpuno].percentidle,
-			thisres.cpus[cpuno].percentnice);
+			thisres.cpus[cpuno].percentnice,
+			(showpeaks && burst->cpus[cpuno].samples) ? uicpupeakcol(burst->cpus[cpuno].max) : -1);
 	}
 
 	if (thisres.cpucount > 1) {
-		uicpudetail(*win, -1, (*currow+2 + cpuno), usecolor,
+		drawn = damage->cells ? (damage->cells + (cpuno * 8)) : NULL;
+		uicpudetail(*win, damage, drawn, -1, (*currow+2 + cpuno), usecolor,
 			thisres.avgpercentuser,
 			thisres.avgpercentsys,
 			thisres.avgpercentidle,
-			thisres.avgpercentnice);
+			thisres.avgpercentnice,
+			(showpeaks && burst->cpu.samples) ? uicpupeakcol(burst->cpu.max) : -1);
+	}
+
+	if(burst->hz && (burst->cpucount == thisres.cpucount)) {
+		mvwprintw(*win, (*currow+3 + cpuno), 0, "Burst %3dHz  avg %5.1f%%  min %5.1f%%  max %5.1f%%  p99 %5.1f%%  %5u samples",
+			burst->hz, burst->cpu.avg, burst->cpu.min, burst->cpu.max, burst->cpu.p99, burst->cpu.samples);
+		uipadcells += 76;
 	}
 
-	uibanner(*win, cols, "CPU Load");
+	uidamagebanner(*win, damage, cols, "CPU Load");
+	uidamagedone(damage);
 	*currow = currowsave;
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
-void uicpulong(WINDOW **win, int winheight, int *currow, int cols, int lines, int itterin, int usecolor, int *longvals, int valcount)
+/*
+ * Lay out the CPU map for this many CPUs, packages and threads per core
+ *  (falling back to one package, or groups of UI_CPUMAP_GROUP CPUs, when
+ *  the counts do not divide evenly)
+ */
+struct uicpumap *uicpumapnew(int cpucount, int packages, int threads)
 {
-	if (*win == NULL) {
+	if(cpucount < 1) {
+		return NULL;
+	}
+
+	struct uicpumap *map = (struct uicpumap *)calloc(1, sizeof(struct uicpumap));
+	if(map == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	map->cpucount = cpucount;
+	map->groupsize = ((threads > 1) && !(cpucount % threads)) ? threads : UI_CPUMAP_GROUP;
+	map->packages = ((packages > 1) && !(cpucount % (packages * map->groupsize))) ? packages : 1;
+	map->groupsperrow = UI_CPUMAP_WIDTH / (map->groupsize + 1);
+
+	int packagecpus = cpucount / map->packages;
+	int packagegroups = (packagecpus + map->groupsize - 1) / map->groupsize;
+	map->packagerows = (packagegroups + map->groupsperrow - 1) / map->groupsperrow;
+
+	// whole groups per band, as few bands as UI_CPUMAP_BANDS allows
+	int groups = (cpucount + map->groupsize - 1) / map->groupsize;
+	int bands = (groups < UI_CPUMAP_BANDS) ? groups : UI_CPUMAP_BANDS;
+	map->bandsize = ((groups + bands - 1) / bands) * map->groupsize;
+	map->bands = (cpucount + map->bandsize - 1) / map->bandsize;
+
+	map->history = timeseriesnew(map->bands, UI_CPUMAP_WIDTH);
+	if(map->history == NULL) {
+		// TODO: handle memory allocation failure
+		free(map);
+		return NULL;
+	}
+	return map;
+}
+
+/*
+ * Rows of the CPU map pane (title and legend, the CPUs, history heading
+ *  and the bands of history)
+ */
+int uicpumapheight(struct uicpumap *map)
+{
+	return 3 + (map->packages * map->packagerows) + map->bands;
+}
+
+/*
+ * How busy a CPU is (from 0 to 9, a tenth each)
+ */
+static inline int uicpumaplevel(double busy)
+{
+	int level = (int)(busy / 10);
+	if(level < 0) {
+		return 0;
+	}
+	return (level > 9) ? 9 : level;
+}
+
+/*
+ * A cell of the CPU map, a character for how busy it is and a color
+ *  for how close it is to saturated
+ */
+static void uicpumapcell(WINDOW *win, int row, int col, int usecolor, int level)
+{
+	static const char ramp[] = ".:-=+*oO#@";
+
+	if(usecolor) {
+		if(level < 5) {
+			wattrset(win, COLOR_PAIR(2));
+		} else if(level < 8) {
+			wattrset(win, COLOR_PAIR(3));
+		} else {
+			wattrset(win, COLOR_PAIR(1));
+		}
+	} else if(level >= 8) {
+		wattron(win, A_BOLD);
+	}
+	mvwaddch(win, row, col, (chtype)ramp[level]);
+	wattrset(win, COLOR_PAIR(0));
+}
+
+/*
+ * Add the busiest CPU of each band to the CPU map history
+ */
+void uicpumapsample(struct uicpumap *map, struct sysres thisres)
+{
+	if((map == NULL) || (thisres.cpucount != map->cpucount)) {
+		return;
+	}
+
+	double values[UI_CPUMAP_BANDS];
+	double busy = 0;
+	int band = 0;
+	for (band = 0; band < map->bands; ++band) {
+		values[band] = 0;
+	}
+	for (int cpuno = 0; cpuno < thisres.cpucount; ++cpuno) {
+		band = cpuno / map->bandsize;
+		busy = thisres.cpus[cpuno].percentuser + thisres.cpus[cpuno].percentsys + thisres.cpus[cpuno].percentnice;
+		if(busy > values[band]) {
+			values[band] = busy;
+		}
+	}
+	timeseriesappend(map->history, values);
+}
+
+void uicpumap(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct uicpumap *map, struct sysres thisres)
+{
+	if ((*win == NULL) || (map == NULL)) {
 		return;
 	}
 
@@ -539,98 +797,249 @@ void uicpulong(WINDOW **win, int winheight, int *currow, int cols, int lines, in
 		*currow = 0;
 	}
 
-	int tempvalue = 0;
-	int graphlines = 10 + *currow;
-	int offset = 6;
-
-	int userquant = 0;
-	int systquant = 0;
-	int nicequant = 0;
-
-	uiscaleleft(*win, *currow, UI_SCALE_PERCENT);
-	mvwvline(*win, 1, offset-1, ACS_VLINE, graphlines);
-
-	for (int j = 0; j < valcount; ++j) {
-		tempvalue = j * 3;
-		userquant = longvals[tempvalue];
-		systquant = longvals[tempvalue+1];
-		nicequant = longvals[tempvalue+2];
-
-		if(j != itterin) {
-			for (int i = graphlines; i > 0; --i) {
-				wmove(*win, i, j+offset);
-
-				if(userquant) {
-					if(usecolor) {
-						wattrset(*win, COLOR_PAIR(10));
-						waddch(*win, ACS_VLINE);
-					} else {
-						wattron(*win, A_STANDOUT);
-						waddch(*win, ACS_CKBOARD);
-						wattroff(*win, A_STANDOUT);
-					}
-					--userquant;
-				} else {
-					if(systquant) {
-						if(usecolor) {
-							wattrset(*win, COLOR_PAIR(8));
-							waddch(*win, ACS_VLINE);
-						} else {
-							waddch(*win, ACS_CKBOARD);
-						}
-						--systquant;
-					} else {
-						if(nicequant) {
-							if(usecolor) {
-								wattrset(*win, COLOR_PAIR(9));
-								waddch(*win, ACS_VLINE);
-							} else {
-								waddch(*win, ACS_DIAMOND);
-							}
-							--nicequant;
-						} else {
-							wattrset(*win, COLOR_PAIR(0));
-							waddch(*win, ' ');
-						}
-					}
-				}
-				wattrset(*win, COLOR_PAIR(0));
-				wmove(*win, i, itterin+offset+1);
+	// the legend, busiest to the right
+	mvwprintw(*win, *currow+1, 0, "%*s", UI_CPUMAP_LABEL - 1, "0% ");
+	for (int level = 0; level < 10; ++level) {
+		uicpumapcell(*win, *currow+1, UI_CPUMAP_LABEL - 1 + level, usecolor, level);
+	}
+	mvwprintw(*win, *currow+1, UI_CPUMAP_LABEL + 9, " 100%%  %d package%s, %d CPUs, %d per group", \
+		map->packages, (map->packages > 1) ? "s" : "", map->cpucount, map->groupsize);
+
+	// a cell per CPU, only as many as the map was laid out for
+	int cpucount = (thisres.cpucount < map->cpucount) ? thisres.cpucount : map->cpucount;
+	int packagecpus = map->cpucount / map->packages;
+	int row = 0;
+	int col = 0;
+	int group = 0;
+	int within = 0;
+	double busy = 0;
+	for (int package = 0; package < map->packages; ++package) {
+		row = *currow + 2 + (package * map->packagerows);
+		mvwhline(*win, row, 0, ' ', UI_CPUMAP_LABEL + UI_CPUMAP_WIDTH);
+		mvwprintw(*win, row, 0, " pkg %d", package);
+		for (int i = 1; i < map->packagerows; ++i) {
+			mvwhline(*win, row + i, 0, ' ', UI_CPUMAP_LABEL + UI_CPUMAP_WIDTH);
+		}
+	}
+	for (int cpuno = 0; cpuno < cpucount; ++cpuno) {
+		within = cpuno % packagecpus;
+		group = within / map->groupsize;
+		row = *currow + 2 + ((cpuno / packagecpus) * map->packagerows) + (group / map->groupsperrow);
+		col = UI_CPUMAP_LABEL + ((group % map->groupsperrow) * (map->groupsize + 1)) + (within % map->groupsize);
+		busy = thisres.cpus[cpuno].percentuser + thisres.cpus[cpuno].percentsys + thisres.cpus[cpuno].percentnice;
+		uicpumapcell(*win, row, col, usecolor, uicpumaplevel(busy));
+	}
+
+	// the busiest CPU of each band, the newest sample to the right
+	struct timeseries *history = map->history;
+	row = *currow + 2 + (map->packages * map->packagerows);
+	double peak = 0;
+	for (int band = 0; band < map->bands; ++band) {
+		if(timeseriesmax(history, band) > peak) {
+			peak = timeseriesmax(history, band);
+		}
+	}
+	mvwhline(*win, row, 0, ' ', UI_CPUMAP_LABEL + UI_CPUMAP_WIDTH);
+	mvwprintw(*win, row, UI_CPUMAP_LABEL, "busiest CPU of each band, last %d samples, peak %.0f%%", UI_CPUMAP_WIDTH, peak);
+
+	unsigned long long next = history->count;
+	unsigned long long sample = 0;
+	int first = 0;
+	int last = 0;
+	for (int band = 0; band < map->bands; ++band) {
+		++row;
+		first = band * map->bandsize;
+		last = first + map->bandsize - 1;
+		if(last >= map->cpucount) {
+			last = map->cpucount - 1;
+		}
+		mvwprintw(*win, row, 0, "%*d-%-*d", 4, first, UI_CPUMAP_LABEL - 6, last);
+		for (int j = 0; j < UI_CPUMAP_WIDTH; ++j) {
+			col = UI_CPUMAP_LABEL + j;
+			sample = next - (unsigned long long)(UI_CPUMAP_WIDTH - j);
+			if((next >= (unsigned long long)(UI_CPUMAP_WIDTH - j)) && timeserieskept(history, sample)) {
+				uicpumapcell(*win, row, col, usecolor, uicpumaplevel(timeseriesvalue(history, sample, band)));
+			} else {
+				mvwaddch(*win, row, col, ' ');
 			}
+		}
+	}
+
+	uibanner(*win, cols, "CPU Map");
+	*currow = currowsave;
+	uidisplay(*win, currow, cols, lines, winheight);
+}
+
+/*
+ * Free the CPU map and its history
+ */
+void uicpumapfree(struct uicpumap *map)
+{
+	if(map == NULL) {
+		return;
+	}
+	timeseriesfree(map->history);
+	free(map);
+}
+
+/*
+ * Set up a long graph for a frame, the scale is only drawn with the whole
+ *  graph (each column remembers the heights of its three parts)
+ */
+static void uigraphstart(WINDOW *win, struct uidamage *damage, int currow, int usecolor, int valcount, int scaletype, int graphlines)
+{
+	uidamagesize(damage, (size_t)valcount * 3, currow, usecolor);
+	if(!damage->valid) {
+		uiscaleleft(win, currow, scaletype);
+		mvwvline(win, 1, UI_GRAPH_OFFSET-1, ACS_VLINE, graphlines);
+		uipadcells += (unsigned long)(graphlines * (UI_GRAPH_OFFSET));
+	}
+}
+
+/*
+ * A column of a long graph (parts stacked from the bottom, first to third,
+ *  -1 for the cursor), only drawn when it is not what was drawn last time;
+ *  as the graph moves on that is the newest column and the cursor
+ */
+static void uigraphcolumn(WINDOW *win, struct uidamage *damage, int column, int graphlines, int usecolor, int first, int second, int third)
+{
+	if(damage->cells) {
+		int *drawn = damage->cells + (column * 3);
+		if(damage->valid && (drawn[0] == first) && (drawn[1] == second) && (drawn[2] == third)) {
+			return;
+		}
+		drawn[0] = first;
+		drawn[1] = second;
+		drawn[2] = third;
+	}
+
+	int col = column + UI_GRAPH_OFFSET;
+	if(first < 0) {
+		mvwvline(win, 1, col, ACS_VLINE, graphlines);
+		uipadcells += (unsigned long)graphlines;
+		return;
+	}
+
+	int kind;
+	for (int i = graphlines; i > 0; --i) {
+		if(first) {
+			kind = UI_CELL_FIRST;
+			--first;
+		} else if(second) {
+			kind = UI_CELL_SECOND;
+			--second;
+		} else if(third) {
+			kind = UI_CELL_THIRD;
+			--third;
 		} else {
-			mvwvline(*win, 1, j+offset, ACS_VLINE, graphlines);
+			kind = UI_CELL_EMPTY;
+		}
+		uibarcell(win, i, col, usecolor, kind, kind ? ACS_VLINE : ' ');
+	}
+}
+
+/*
+ * Columns of a long graph for a terminal this wide (one is the cursor)
+ */
+int uichartcolumns(int cols)
+{
+	int columns = cols - BORDER_WIDTH - UI_GRAPH_OFFSET - 2;
+	if(columns < UI_CHART_MIN) {
+		columns = UI_CHART_MIN;
+	}
+	if(columns > (MAXCOLS - UI_GRAPH_OFFSET - 2)) {
+		columns = MAXCOLS - UI_GRAPH_OFFSET - 2;
+	}
+	return columns;
+}
+
+/*
+ * The heights of the parts of one long graph column, percentages are a
+ *  line per 10%, bytes are a line per decimal digit of the total (split
+ *  between the first two channels)
+ */
+static void uichartparts(struct timeseries *series, unsigned long long sample, int scaletype, int *parts)
+{
+	if(scaletype == UI_SCALE_PERCENT) {
+		for (int i = 0; (i < series->channels) && (i < 3); ++i) {
+			parts[i] = (int)(round(timeseriesvalue(series, sample, i)) / 10);
+		}
+		return;
+	}
+
+	double first = timeseriesvalue(series, sample, 0);
+	double second = (series->channels > 1) ? timeseriesvalue(series, sample, 1) : 0;
+	double total = first + second;
+	if(total > 0) {
+		int tmpquant = (int)floor(log10(total));
+		// TODO: this ratio cannot be right for logrithmic output
+		parts[0] = (int)(tmpquant * (first / total));
+		parts[1] = (int)(tmpquant * (second / total));
+	}
+}
+
+/*
+ * A long graph of a time series, a column per sample; the cursor is the
+ *  column after the newest sample and moves right, wrapping around, so
+ *  the column left of it is the newest and the one right of it the oldest
+ *  (columns without a sample are empty)
+ */
+void uichart(WINDOW **win, struct uidamage *damage, int winheight, int *currow, int cols, int lines, int usecolor, struct timeseries *series, int columns, int scaletype, char *title)
+{
+	if (*win == NULL) {
+		return;
+	}
+
+	int currowsave = *currow;
+	if(*currow > 0) {
+		*currow = 0;
+	}
+
+	int graphlines = 10 + *currow;
+	unsigned long long next = series->count;
+	int cursor = (int)(next % (unsigned long long)columns);
+	unsigned long long age = 0;
+	int parts[3] = {0, 0, 0};
+
+	uigraphstart(*win, damage, *currow, usecolor, columns, scaletype, graphlines);
+	for (int j = 0; j < columns; ++j) {
+		if(j == cursor) {
+			uigraphcolumn(*win, damage, j, graphlines, usecolor, -1, -1, -1);
+			continue;
+		}
+
+		parts[0] = 0;
+		parts[1] = 0;
+		parts[2] = 0;
+		// 1 for the column left of the cursor, columns - 1 right of it
+		age = (unsigned long long)((cursor - j + columns) % columns);
+		if((age <= next) && timeserieskept(series, next - age)) {
+			uichartparts(series, next - age, scaletype, parts);
 		}
+		uigraphcolumn(*win, damage, j, graphlines, usecolor, parts[0], parts[1], parts[2]);
 	}
 
-	uibanner(*win, cols, "CPU Load");
+	uidamagebanner(*win, damage, cols, title);
+	uidamagedone(damage);
 	*currow = currowsave;
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
 static void uidiskdetail(WINDOW *win, int currow, int usecolor, unsigned long diskr, unsigned long diskw, double unitdivisor, char *units, int scale)
 {
-	char *bytestring = NULL;
+	char bytestringa[READABLE_BYTES_LENGTH];
+	char bytestringb[READABLE_BYTES_LENGTH];
+	uireadablebytes(bytestringa, diskr);
+	uireadablebytes(bytestringb, diskw);
 
-	bytestring = uireadablebyteslong(diskr);
-	mvwprintw(win, currow-1, 2, "Reads:  %9.9s", bytestring);
-	free(bytestring);
-	bytestring = NULL;
-	bytestring = uireadablebyteslong(diskw);
-	mvwprintw(win, currow, 2, "Writes: %9.9s", bytestring);
-	free(bytestring);
-	bytestring = NULL;
+	mvwprintw(win, currow-1, 2, "Reads:  %9.9s", bytestringa);
+	mvwprintw(win, currow, 2, "Writes: %9.9s", bytestringb);
 
 	if(usecolor) {
 		wattrset(win, COLOR_PAIR(4));
-		bytestring = uireadablebyteslong(diskr);
-		mvwprintw(win, currow-1, 10, "%9.9s", bytestring);
-		free(bytestring);
-		bytestring = NULL;
+		mvwprintw(win, currow-1, 10, "%9.9s", bytestringa);
 		wattrset(win, COLOR_PAIR(1));
-        bytestring = uireadablebyteslong(diskw);
-		mvwprintw(win, currow, 10, "%9.9s", bytestring);
-		free(bytestring);
-		bytestring = NULL;
+		mvwprintw(win, currow, 10, "%9.9s", bytestringb);
 		wattrset(win, COLOR_PAIR(0));
 	}
 
@@ -760,87 +1169,6 @@ extern void uidisks(WINDOW **win, int winheight, int *currow, int cols, int line
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
-void uidisklong(WINDOW **win, int winheight, int *currow, int cols, int lines, int itterin, int usecolor, unsigned int *longvals, int valcount)
-{
-	if (*win == NULL) {
-		return;
-	}
-
-	int currowsave = *currow;
-	if(*currow > 0) {
-		*currow = 0;
-	}
-
-	int tempvalue = 0;
-	int graphlines = 10 + *currow;
-	int offset = 6;
-
-	unsigned int diskr = 0;
-	unsigned int diskw = 0;
-	double disktotal = 0;
-	int tmpquant = 0;
-	int readquant = 0;
-	int writequant = 0;
-
-	uiscaleleft(*win, *currow, UI_SCALE_LOG_BYTES);
-	mvwvline(*win, 1, offset-1, ACS_VLINE, graphlines);
-
-	for (int j = 0; j < valcount; ++j) {
-		tempvalue = j * 2;
-		diskr = longvals[tempvalue];
-		diskw = longvals[tempvalue+1];
-		readquant = 0;
-		writequant = 0;
-
-		disktotal = (double)(diskr + diskw);
-		if(disktotal) {
-			tmpquant = (int)floor(log10(disktotal));
-			// TODO: this ratio cannot be right for logrithmic output
-			readquant = (int)(tmpquant * (diskr / (disktotal))) - 0;
-			writequant = (int)(tmpquant * (diskw / (disktotal))) - 0;
-		}
-
-		if(j != itterin) {
-			for (int i = graphlines; i > 0; --i) {
-				wmove(*win, i, j+offset);
-
-				if(readquant) {
-					if(usecolor) {
-						wattrset(*win, COLOR_PAIR(10));
-						waddch(*win, ACS_VLINE);
-					} else {
-						wattron(*win, A_STANDOUT);
-						waddch(*win, ACS_CKBOARD);
-						wattroff(*win, A_STANDOUT);
-					}
-					--readquant;
-				} else {
-					if(writequant) {
-						if(usecolor) {
-							wattrset(*win, COLOR_PAIR(8));
-							waddch(*win, ACS_VLINE);
-						} else {
-							waddch(*win, ACS_CKBOARD);
-						}
-						--writequant;
-					} else {
-						wattrset(*win, COLOR_PAIR(0));
-						waddch(*win, ' ');
-					}
-				}
-				wattrset(*win, COLOR_PAIR(0));
-				wmove(*win, i, itterin+offset+1);
-			}
-		} else {
-			mvwvline(*win, 1, j+offset, ACS_VLINE, graphlines);
-		}
-	}
-
-	uibanner(*win, cols, "Disk Usage");
-	*currow = currowsave;
-	uidisplay(*win, currow, cols, lines, winheight);
-}
-
 extern void uidiskgroup(WINDOW **winin, int winheight, int *currow, int cols, int lines)
 {
 	return;
@@ -1072,19 +1400,13 @@ extern void uikernel(WINDOW **winin, int winheight, int *currow, int cols, int l
 
 static void uimemdetail(WINDOW *win, int currow, int usecolor, unsigned long long used, unsigned long long total, double percent, unsigned long long swap)
 {
-	char *bytestring_swap = uireadablebyteslonglong(swap);
-	mvwprintw(win, currow-1, 2, "%8s swap", bytestring_swap);
-	free(bytestring_swap);
-	bytestring_swap = NULL;
+	char bytestring_swap[READABLE_BYTES_LENGTH];
+	mvwprintw(win, currow-1, 2, "%8s swap", uireadablebytes(bytestring_swap, swap));
 	mvwprintw(win, currow-1, 24, "LOG");
 
-	char *bytestring_used = uireadablebyteslonglong(used);
-	char *bytestring_total = uireadablebyteslonglong(total);
-	mvwprintw(win, currow, 2, "%8s/%-8s %5.2f%%", bytestring_used, bytestring_total, percent);
-	free(bytestring_used);
-	bytestring_used = NULL;
-	free(bytestring_total);
-	bytestring_total = NULL;
+	char bytestring_used[READABLE_BYTES_LENGTH];
+	char bytestring_total[READABLE_BYTES_LENGTH];
+	mvwprintw(win, currow, 2, "%8s/%-8s %5.2f%%", uireadablebytes(bytestring_used, used), uireadablebytes(bytestring_total, total), percent);
 
 	if(usecolor) {
 		wattrset(win, COLOR_PAIR(4));
@@ -1167,28 +1489,19 @@ extern void uinetfilesys(WINDOW **winin, int winheight, int *currow, int cols, i
 
 static void uinetdetail(WINDOW *win, int currow, int usecolor, unsigned long netin, unsigned long netout, double unitdivisor, char *units, int scale)
 {
-	char *bytestring = NULL;
+	char bytestringa[READABLE_BYTES_LENGTH];
+	char bytestringb[READABLE_BYTES_LENGTH];
+	uireadablebytes(bytestringa, netin);
+	uireadablebytes(bytestringb, netout);
 
-	bytestring = uireadablebyteslong(netin);
-	mvwprintw(win, currow-1, 2, "In:     %9.9s", bytestring);
-	free(bytestring);
-	bytestring = NULL;
-	bytestring = uireadablebyteslong(netout);
-	mvwprintw(win, currow, 2, "Out:    %9.9s", bytestring);
-	free(bytestring);
-	bytestring = NULL;
+	mvwprintw(win, currow-1, 2, "In:     %9.9s", bytestringa);
+	mvwprintw(win, currow, 2, "Out:    %9.9s", bytestringb);
 
 	if(usecolor) {
 		wattrset(win, COLOR_PAIR(4));
-		bytestring = uireadablebyteslong(netin);
-		mvwprintw(win, currow-1, 10, "%9.9s", bytestring);
-		free(bytestring);
-		bytestring = NULL;
+		mvwprintw(win, currow-1, 10, "%9.9s", bytestringa);
 		wattrset(win, COLOR_PAIR(1));
-        bytestring = uireadablebyteslong(netout);
-		mvwprintw(win, currow, 10, "%9.9s", bytestring);
-		free(bytestring);
-		bytestring = NULL;
+		mvwprintw(win, currow, 10, "%9.9s", bytestringb);
 		wattrset(win, COLOR_PAIR(0));
 	}
 
@@ -1254,7 +1567,7 @@ static void uinetdetail(WINDOW *win, int currow, int usecolor, unsigned long net
 	mvwaddch(win, currow, 77, ACS_VLINE);
 }
 
-extern void uinetwork(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct sysnet thisnet)
+extern void uinetwork(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, unsigned long netin, unsigned long netout, struct sysburst *burst)
 {
 	if (*win == NULL) {
 		return;
@@ -1267,97 +1580,24 @@ extern void uinetwork(WINDOW **win, int winheight, int *currow, int cols, int li
 
 	uibanner(*win, cols, "Network Usage");
 	uiscaletop(*win, *currow, UI_SCALE_LOG_BYTES);
-	uinetdetail(*win, *currow+2, usecolor, \
-		(thisnet.ibytes - thisnet.oldibytes), \
-		(thisnet.obytes - thisnet.oldobytes), \
-		0, "", 0);
-
-	*currow = currowsave;
-	uidisplay(*win, currow, cols, lines, winheight);
-}
-
-void uinetlong(WINDOW **win, int winheight, int *currow, int cols, int lines, int itterin, int usecolor, unsigned long *longvals, int valcount)
-{
-	if (*win == NULL) {
-		return;
-	}
+	uinetdetail(*win, *currow+2, usecolor, netin, netout, 0, "", 0);
 
-	int currowsave = *currow;
-	if(*currow > 0) {
-		*currow = 0;
+	// the busiest burst samples taken since the last refresh (-z)
+	if(burst->hz) {
+		char bytestring[4][READABLE_BYTES_LENGTH];
+		mvwprintw(*win, *currow+3, 2, "Burst %3dHz  In max %9.9s p99 %9.9s  Out max %9.9s p99 %9.9s",
+			burst->hz,
+			uireadablebytes(bytestring[0], (unsigned long long)burst->netin.max),
+			uireadablebytes(bytestring[1], (unsigned long long)burst->netin.p99),
+			uireadablebytes(bytestring[2], (unsigned long long)burst->netout.max),
+			uireadablebytes(bytestring[3], (unsigned long long)burst->netout.p99));
 	}
 
-	int tempvalue = 0;
-	int graphlines = 10 + *currow;
-	int offset = 6;
-
-	unsigned long netin = 0;
-	unsigned long netout = 0;
-	double nettotal = 0;
-	int tmpquant = 0;
-	int readquant = 0;
-	int writequant = 0;
-
-	uiscaleleft(*win, *currow, UI_SCALE_LOG_BYTES);
-	mvwvline(*win, 1, offset-1, ACS_VLINE, graphlines);
-
-	for (int j = 0; j < valcount; ++j) {
-		tempvalue = j * 2;
-		netin = longvals[tempvalue];
-		netout = longvals[tempvalue+1];
-		readquant = 0;
-		writequant = 0;
-
-		nettotal = (double)(netin + netout);
-		if(nettotal) {
-			tmpquant = (int)floor(log10(nettotal));
-			// TODO: this ratio cannot be right for logrithmic output
-			readquant = (int)(tmpquant * (netin / (nettotal))) - 0;
-			writequant = (int)(tmpquant * (netout / (nettotal))) - 0;
-		}
-
-		if(j != itterin) {
-			for (int i = graphlines; i > 0; --i) {
-				wmove(*win, i, j+offset);
-
-				if(readquant) {
-					if(usecolor) {
-						wattrset(*win, COLOR_PAIR(10));
-						waddch(*win, ACS_VLINE);
-					} else {
-						wattron(*win, A_STANDOUT);
-						waddch(*win, ACS_CKBOARD);
-						wattroff(*win, A_STANDOUT);
-					}
-					--readquant;
-				} else {
-					if(writequant) {
-						if(usecolor) {
-							wattrset(*win, COLOR_PAIR(8));
-							waddch(*win, ACS_VLINE);
-						} else {
-							waddch(*win, ACS_CKBOARD);
-						}
-						--writequant;
-					} else {
-						wattrset(*win, COLOR_PAIR(0));
-						waddch(*win, ' ');
-					}
-				}
-				wattrset(*win, COLOR_PAIR(0));
-				wmove(*win, i, itterin+offset+1);
-			}
-		} else {
-			mvwvline(*win, 1, j+offset, ACS_VLINE, graphlines);
-		}
-	}
-
-	uibanner(*win, cols, "Network Usage");
 	*currow = currowsave;
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
-void uisys(WINDOW **win, int winheight, int *currow, int cols, int lines, struct syshw hw, struct syskern kern)
+void uisys(WINDOW **win, int winheight, int *currow, int cols, int lines, struct syshw hw, struct syskern kern, struct syshwdyn hwdyn, struct syskerndyn kerndyn)
 {
 	if (*win == NULL) {
 		return;
@@ -1368,8 +1608,10 @@ void uisys(WINDOW **win, int winheight, int *currow, int cols, int lines, struct
 		*currow = 0;
 	}
 
-	char *bytestringa = uireadablebyteslong(hw.memorysize);
-	char *bytestringb = uireadablebyteslong(hw.usermemory);
+	char bytestringa[READABLE_BYTES_LENGTH];
+	char bytestringb[READABLE_BYTES_LENGTH];
+	uireadablebytes(bytestringa, hw.memorysize);
+	uireadablebytes(bytestringb, hw.usermemory);
 
 	mvwprintw(*win, *currow+1, 0, " %s", hw.model);
 	mvwprintw(*win, *currow+2, 0, " %s %s", hw.cpuvendor, hw.cpubrand);
@@ -1377,52 +1619,55 @@ void uisys(WINDOW **win, int winheight, int *currow, int cols, int lines, struct
 	mvwprintw(*win, *currow+4, 0, " OS Release: %s / OS Version: %s", kern.osrelease, kern.osversion);
 	mvwprintw(*win, *currow+5, 0, " CPUs: %d (%d cores, %d physical, %d logical)", hw.cpucount, kern.corecount, hw.physicalcpucount, hw.logicalcpucount);
 	mvwprintw(*win, *currow+6, 0, " Memory: %9.9s, %9.9s non-kernel in use", bytestringa, bytestringb);
-	free(bytestringa);
-	free(bytestringb);
 
 	mvwprintw(*win, *currow+8, 0, " Domain   : %s", kern.domainname);
 	mvwprintw(*win, *currow+9, 0, " Booted   : %s", kern.boottimestring);
+	// the dynamic facts are refreshed every few seconds (COLLECTOR_SLOW_NS)
+	long upminutes = (long)(kerndyn.uptime.tv_sec / 60);
+	mvwprintw(*win, *currow+10, 0, " Up       : %ld days, %02ld:%02ld", upminutes / (24 * 60), (upminutes / 60) % 24, upminutes % 60);
+	mvwprintw(*win, *currow+11, 0, " Active   : %u CPUs, thermal level CPU %u GPU %u IO %u", \
+		hwdyn.cpuactive, hwdyn.thermallevelcpu, hwdyn.thermallevelgpu, hwdyn.thermallevelio);
 
 	uibanner(*win, cols, "About This Mac");
 	*currow = currowsave;
 	uidisplay(*win, currow, cols, lines, winheight);
 }
 
-static int comparepercentdes(const void *val1, const void *val2)
+/*
+ * The order of the top pane's rows in a top mode (NULL when it has none)
+ */
+int (*uitopcompare(int topmode))(struct sysproctable*, int, int)
 {
-	struct sysproc **percent1 = (struct sysproc **)val1;
-	struct sysproc **percent2 = (struct sysproc **)val2;
-
-	if ((*percent1)->percentage > (*percent2)->percentage) {
-		return -1;
-	} else if ((*percent1)->percentage < (*percent2)->percentage) {
-		return 1;
-	} else {
-		return 0;
+	switch(topmode) {
+		case TOP_MODE_A:
+		case TOP_MODE_B:
+			return sysproctablecomparecpu;
+		case TOP_MODE_C:
+		case TOP_MODE_D:
+			return sysproctablecomparemem;
 	}
+	return NULL;
 }
 
-static int compareresmemdes(const void *val1, const void *val2)
+/*
+ * Number of processes the top pane shows (and sorts) on a screen of lines
+ */
+int uitoprows(int processcount, int lines)
 {
-	struct sysproc **percent1 = (struct sysproc **)val1;
-	struct sysproc **percent2 = (struct sysproc **)val2;
-
-	if ((*percent1)->residentmem > (*percent2)->residentmem) {
-		return -1;
-	} else if ((*percent1)->residentmem < (*percent2)->residentmem) {
-		return 1;
-	} else {
-		return 0;
+	if(processcount > lines) {
+		// the header rows, a very short screen shows none
+		return (lines > 4) ? (lines - 4) : 0;
 	}
+	return processcount;
 }
 
-void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct sysproc **procs, int processcount, int topmode, bool updateddata, char *user)
+void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct sysproctable *procs, int topmode, bool updateddata, char *user)
 {
 	if (*win == NULL) {
 		return;
 	}
 
-	if(!procs){
+	if(!procs || !procs->count){
 		return;
 	}
 
@@ -1431,25 +1676,13 @@ void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int us
 		*currow = 0;
 	}
 
-	int procstoshow = processcount;
-	if(procstoshow > lines) {
-		procstoshow = lines - 4;
-	}
+	int procstoshow = uitoprows((int)procs->count, lines);
 
 	wmove(*win, *currow, 1);
 	wclrtobot(*win);
 
-	if(updateddata) {
-		switch(topmode) {
-			case TOP_MODE_A:
-			case TOP_MODE_B:
-				heapsort(procs, (size_t)processcount, sizeof(struct sysproc *), comparepercentdes);
-				break;
-			case TOP_MODE_C:
-			case TOP_MODE_D:
-				heapsort(procs, (size_t)processcount, sizeof(struct sysproc *), compareresmemdes);
-				break;
-		}
+	if(updateddata && uitopcompare(topmode)) {
+		sysproctableselect(procs, procstoshow, uitopcompare(topmode));
 	}
 
 	switch(topmode) {
@@ -1464,8 +1697,8 @@ void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int us
 	}
 
 	char *statustext = NULL;
-	char *rmem = NULL;
-	char *pmem = NULL;
+	char rmem[READABLE_BYTES_LENGTH];
+	char pmem[READABLE_BYTES_LENGTH];
 
 	char *tmppath = NULL;
 	int tmppathlen = 0;
@@ -1473,13 +1706,23 @@ void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int us
 	int appnameend = 0;
 	bool appnamefound = false;
 
+	int row = 0;
+	struct sysproc *proc = NULL;
 	for (int i = 0; i < procstoshow; i++) {
-		switch(procs[i]->status){
+		row = procs->order[i];
+		proc = procs->records[row];
+		// a snapshot taken before the top mode or screen size changed
+		// only has the records of the rows shown then (see samplershow)
+		if(proc == NULL) {
+			break;
+		}
+
+		switch(procs->status[row]){
 			case SIDL:
 				statustext = "IDLE";
 				break;
 			case SRUN:
-				if(procs[i]->percentage > 0) {
+				if(procs->percentage[row] > 0) {
 					statustext = "RUN";
 				} else {
 					// I made up this classification, I think
@@ -1501,47 +1744,44 @@ void uitop(WINDOW **win, int winheight, int *currow, int cols, int lines, int us
 		switch(topmode) {
 			case TOP_MODE_A:
 			case TOP_MODE_C:
-				rmem = uireadablebyteslonglong(procs[i]->residentmem);
-				pmem = uireadablebyteslonglong(procs[i]->physicalmem);
+				uireadablebytes(rmem, procs->residentmem[row]);
+				uireadablebytes(pmem, procs->physicalmem[row]);
 				mvwprintw(*win, (*currow + 2 + i), 1, "%-6d %-16.16s%5.1f %9.9s %9.9s %9.9s %-6d %-6d%-5.5s",
-					procs[i]->pid,
-					procs[i]->name,
-					procs[i]->percentage,
+					procs->pid[row],
+					proc->name,
+					procs->percentage[row],
 					rmem,
 					pmem,
-					procs[i]->realusername,
-					procs[i]->pgid,
-					procs[i]->parentpid,
+					proc->realusername,
+					procs->pgid[row],
+					procs->parentpid[row],
 					statustext
 					);
-				free(rmem);
-				free(pmem);
 
-				if(!strcmp(user, procs[i]->realusername)) {
+				if(user && (proc->realusername == user)) {
 					wattron(*win, A_BOLD);
-					mvwprintw(*win, (*currow + 2 + i), 50, "%9.9s", procs[i]->realusername);
+					mvwprintw(*win, (*currow + 2 + i), 50, "%9.9s", proc->realusername);
 					wattroff(*win, A_BOLD);
 				}
 				break;
 			case TOP_MODE_B:
 			case TOP_MODE_D:
-				rmem = uireadablebyteslonglong(procs[i]->residentmem);
+				uireadablebytes(rmem, procs->residentmem[row]);
 				mvwprintw(*win, (*currow + 2 + i), 1, "%-6d%5.1f %9.9s %9.9s %-45.45s",
-					procs[i]->pid,
-					procs[i]->percentage,
+					procs->pid[row],
+					procs->percentage[row],
 					rmem,
-					procs[i]->realusername,
-					procs[i]->path
+					proc->realusername,
+					proc->path
 					);
-				if(!strcmp(user, procs[i]->realusername)) {
+				if(user && (proc->realusername == user)) {
 					wattron(*win, A_BOLD);
-					mvwprintw(*win, (*currow + 2 + i), 23, "%9.9s", procs[i]->realusername);
+					mvwprintw(*win, (*currow + 2 + i), 23, "%9.9s", proc->realusername);
 					wattroff(*win, A_BOLD);
 				}
-				free(rmem);
 
 				if(usecolor) {
-					tmppath = procs[i]->path;
+					tmppath = proc->path;
 					tmppathlen = (int)strlen(tmppath);
 					appnamebegin = 0;
 					appnameend = tmppathlen;
@@ -1595,3 +1835,57 @@ void uiwarn(WINDOW **win, int winheight, int *currow, int cols, int lines)
 	*currow = currowsave;
 	uidisplay(*win, currow, cols, lines, winheight);
 }
+
+/*
+ * Rows of the profile pane, the measures are in two columns
+ */
+int uiprofileheight()
+{
+	return 2 + ((PROFILE_CHANNELS + 1) / 2);
+}
+
+/*
+ * Timings (us) and counts of nmond itself, for the last tick and over the
+ *  last PROFILE_TICKS ticks
+ */
+void uiprofile(WINDOW **win, int winheight, int *currow, int cols, int lines, int usecolor, struct profile *profile)
+{
+	if ((*win == NULL) || (profile == NULL)) {
+		return;
+	}
+
+	int currowsave = *currow;
+	if(*currow > 0) {
+		*currow = 0;
+	}
+
+	int rows = (PROFILE_CHANNELS + 1) / 2;
+	int row = 0;
+	int col = 0;
+	double scale = 0;
+
+	if(usecolor) {
+		wattrset(*win, COLOR_PAIR(4));
+	}
+	mvwprintw(*win, *currow+1, 0, "%-10s %8s %8s %8s", "us/count", "last", "p50", "p99");
+	mvwprintw(*win, *currow+1, 39, "%-10s %8s %8s %8s", "us/count", "last", "p50", "p99");
+	if(usecolor) {
+		wattrset(*win, COLOR_PAIR(0));
+	}
+	for (int i = 0; i < PROFILE_CHANNELS; ++i) {
+		row = *currow + 2 + (i % rows);
+		col = (i < rows) ? 0 : 39;
+		// times are kept in ns
+		scale = (i < PROFILE_COUNTS) ? 1000.0 : 1.0;
+		mvwprintw(*win, row, col, "%-10.10s %8.1f %8.1f %8.1f", profilename(i),
+			profilelast(profile, i) / scale,
+			profilepercentile(profile, i, 50) / scale,
+			profilepercentile(profile, i, 99) / scale);
+	}
+
+	char title[48];
+	snprintf(title, sizeof(title), "Profile (%zu ticks)", timeserieswindowcount(profile->ticks));
+	uibanner(*win, cols, title);
+	*currow = currowsave;
+	uidisplay(*win, currow, cols, lines, winheight);
+}
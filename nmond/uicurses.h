@@ -38,7 +38,10 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "burst.h"
+#include "profile.h"
 #include "sysinfo.h"
+#include "timeseries.h"
 #include <ncurses.h>
 #include <stdbool.h>
 #include <sys/time.h>
@@ -58,6 +61,26 @@
 #define UI_SCALE_HUNDRED 4
 #define UI_SCALE_THOUSAND 5
 
+// the parts of a bar (user, system, nice time, or reads and writes)
+#define UI_CELL_EMPTY 0
+#define UI_CELL_FIRST 1
+#define UI_CELL_SECOND 2
+#define UI_CELL_THIRD 3
+
+// columns left of a long graph, for its scale
+#define UI_GRAPH_OFFSET 6
+// columns of the narrowest long graph, and samples kept for the long
+// graphs (wider than the widest, so they survive a resize)
+#define UI_CHART_MIN 10
+#define UI_CHART_HISTORY 1024
+
+// the CPU map, a label then a cell per CPU (or per sample of history)
+#define UI_CPUMAP_LABEL 10
+#define UI_CPUMAP_WIDTH 66
+// CPUs drawn together when cores have no hyperthreads, and rows of history
+#define UI_CPUMAP_GROUP 8
+#define UI_CPUMAP_BANDS 8
+
 #define DISK_METER_MODE 2  // change me
 #define DISK_METER_MB 0    // do NOT change
 #define DISK_METER_LOG 1   // do NOT change
@@ -79,10 +102,40 @@
 
 #define MSG_WRN_NOT_SHOWN "Warning: Some Statistics may not shown"
 
+// what a pane last drew into its pad, so that a frame only rewrites the pad
+// cells which changed (values per column of a long graph, or per row of the
+// CPU bars), this saves the formatting and pad writes, ncurses already sends
+// only the changed cells to the terminal
+struct uidamage {
+	bool valid; // false draws the whole pane on the next frame
+	int usecolor;
+	int origin; // the pane's first row when it was drawn
+	int *cells;
+	size_t count;
+	char title[64];
+};
+
+// The CPU map, a cell per logical CPU: the threads of a core (numbered
+// together) are side by side, each package starts a new row. Below it the
+// CPUs are split into bands of whole cores, with the busiest CPU of each
+// band over the last UI_CPUMAP_WIDTH samples.
+struct uicpumap {
+	int cpucount;
+	int packages;
+	int groupsize; // CPUs between spaces (a core, or UI_CPUMAP_GROUP)
+	int groupsperrow;
+	int packagerows;
+	int bandsize; // CPUs per band of history
+	int bands;
+	struct timeseries *history; // a channel per band
+};
+
 struct uiwin {
 	WINDOW *win;
 	bool visible;
 	int height;
+	unsigned int collectors; // COLLECT_* statistics the pane consumes
+	struct uidamage damage;
 };
 struct uiwins {
 	int visiblecount;
@@ -92,6 +145,7 @@ struct uiwins {
 
 	struct uiwin cpu;
 	struct uiwin cpulong;
+	struct uiwin cpumap;
 
 	struct uiwin gpu;
 
@@ -115,26 +169,39 @@ struct uiwins {
 
 	struct uiwin sys;
 	struct uiwin warn;
+	struct uiwin profile;
 };
 #define UIWINS_INIT { 0, \
-{NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, \
+{NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, \
 {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, \
 {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, \
 {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, {NULL, false}, \
-{NULL, false}, {NULL, false} }
+{NULL, false}, {NULL, false}, {NULL, false} }
+
+// pad cells written by the damage tracked panes (reset by the caller each
+// frame), not the terminal output, which ncurses keeps to the changed cells
+extern unsigned long uipadcells;
 
 extern void uiheader(WINDOW**, int, int, int, char*, char*, double, time_t);
 
 extern void uiwelcome(WINDOW**, int, int*, int, int, int, struct syshw);
 extern void uihelp(WINDOW**, int, int*, int, int);
 
-extern void uicpu(WINDOW**, int, int*, int, int, int, struct sysres, int);
-extern void uicpulong(WINDOW**, int, int*, int, int, int, int, int*, int);
+extern void uidamagefree(struct uidamage*);
+extern void uicpu(WINDOW**, struct uidamage*, int, int*, int, int, int, struct sysres, struct sysburst*, bool, int);
+
+extern struct uicpumap *uicpumapnew(int, int, int);
+extern int uicpumapheight(struct uicpumap*);
+extern void uicpumapsample(struct uicpumap*, struct sysres);
+extern void uicpumap(WINDOW**, int, int*, int, int, int, struct uicpumap*, struct sysres);
+extern void uicpumapfree(struct uicpumap*);
+
+extern int uichartcolumns(int);
+extern void uichart(WINDOW**, struct uidamage*, int, int*, int, int, int, struct timeseries*, int, int, char*);
 
 extern void uigpu(WINDOW**, int, int*, int, int, int, unsigned long long);
 
 extern void uidisks(WINDOW**, int, int*, int, int, int, unsigned int, unsigned int);
-extern void uidisklong(WINDOW**, int, int*, int, int, int, int, unsigned int*, int);
 extern void uidiskgroup(WINDOW**, int, int*, int, int);
 extern void uidiskmap(WINDOW**, int, int*, int, int);
 extern void uienergy(WINDOW**, int, int*, int, int, int, unsigned int, unsigned int);
@@ -145,10 +212,13 @@ extern void uimemlarge(WINDOW**, int, int*, int, int);
 extern void uimemvirtual(WINDOW**, int, int*, int, int);
 extern void uineterrors(WINDOW**, int, int*, int, int);
 extern void uinetfilesys(WINDOW**, int, int*, int, int);
-extern void uinetwork(WINDOW**, int, int*, int, int, int, struct sysnet);
-extern void uinetlong(WINDOW**, int, int*, int, int, int, int, unsigned long*, int);
-extern void uitop(WINDOW**, int, int*, int, int, int, struct sysproc**, int, int, bool, char*);
-extern void uisys(WINDOW**, int, int*, int, int, struct syshw, struct syskern);
+extern void uinetwork(WINDOW**, int, int*, int, int, int, unsigned long, unsigned long, struct sysburst*);
+extern int (*uitopcompare(int))(struct sysproctable*, int, int);
+extern int uitoprows(int, int);
+extern void uitop(WINDOW**, int, int*, int, int, int, struct sysproctable*, int, bool, char*);
+extern void uisys(WINDOW**, int, int*, int, int, struct syshw, struct syskern, struct syshwdyn, struct syskerndyn);
 extern void uiwarn(WINDOW**, int, int*, int, int);
+extern int uiprofileheight(void);
+extern void uiprofile(WINDOW**, int, int*, int, int, int, struct profile*);
 
 #endif
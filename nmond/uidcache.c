@@ -0,0 +1,167 @@
+/**
+ * uidcache.c -- Cache of user names by user ID
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "uidcache.h"
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * Return the stored copy of a name, storing it first if it is new
+ */
+char *uidcacheintern(struct uidcache *cache, const char *name)
+{
+	if(name == NULL) {
+		return NULL;
+	}
+
+	// there are few distinct names, and this only runs on a cache miss
+	for (size_t i = 0; i < cache->namecount; ++i) {
+		if(!strcmp(cache->names[i], name)) {
+			return cache->names[i];
+		}
+	}
+
+	if(cache->namecount >= cache->namecapacity) {
+		size_t capacity = cache->namecapacity ? (cache->namecapacity * 2) : UIDCACHE_NAMES_MIN;
+		char **names = (char **)realloc(cache->names, sizeof(char*) * capacity);
+		if(names == NULL) {
+			// TODO: handle memory allocation failure
+			return NULL;
+		}
+		cache->names = names;
+		cache->namecapacity = capacity;
+	}
+
+	char *result = strdup(name);
+	if(result == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	cache->names[cache->namecount] = result;
+	cache->namecount += 1;
+	return result;
+}
+
+/*
+ * Forget the uid to name mappings when the passwd file changed or the
+ *  names are older than the TTL (the interned names are kept)
+ */
+void uidcacherefresh(struct uidcache *cache)
+{
+	time_t now = time(NULL);
+	struct stat passwdstat;
+	time_t passwdmtime = 0;
+	if(!stat(UIDCACHE_PASSWD_PATH, &passwdstat)) {
+		passwdmtime = passwdstat.st_mtime;
+	}
+
+	if(cache->hash && (passwdmtime == cache->passwdmtime) && ((now - cache->loaded) < UIDCACHE_TTL)) {
+		return;
+	}
+
+	hashtfree(cache->hash);
+	cache->hash = hashtnew();
+	cache->loaded = now;
+	cache->passwdmtime = passwdmtime;
+	cache->refreshes += 1;
+}
+
+/*
+ * Get the (interned) name for a user ID, unknown users get their number
+ */
+char *uidcachename(struct uidcache *cache, unsigned int uid)
+{
+	if(cache->hash == NULL) {
+		uidcacherefresh(cache);
+	}
+
+	char *result = NULL;
+	if(cache->hash) {
+		result = (char *)hashtget(cache->hash, (int)uid);
+	}
+	if(result) {
+		cache->hits += 1;
+		return result;
+	}
+	cache->misses += 1;
+
+	struct passwd *user = getpwuid(uid);
+	if(user) {
+		result = uidcacheintern(cache, user->pw_name);
+	} else {
+		char uidstring[16];
+		snprintf(uidstring, sizeof(uidstring), "%u", uid);
+		result = uidcacheintern(cache, uidstring);
+	}
+
+	if(result && cache->hash) {
+		hashtset(cache->hash, (int)uid, result);
+	}
+	return result;
+}
+
+/*
+ * Percent of lookups answered without calling getpwuid()
+ */
+double uidcachehitrate(struct uidcache *cache)
+{
+	unsigned long long lookups = cache->hits + cache->misses;
+	if(!lookups) {
+		return 0.0;
+	}
+	return ((double)cache->hits / (double)lookups) * 100;
+}
+
+/*
+ * Free the uid table and the interned names (callers holding a name must
+ *  be done with it)
+ */
+void uidcachefree(struct uidcache *cache)
+{
+	hashtfree(cache->hash);
+	for (size_t i = 0; i < cache->namecount; ++i) {
+		free(cache->names[i]);
+	}
+	free(cache->names);
+	cache->hash = NULL;
+	cache->names = NULL;
+	cache->namecount = 0;
+	cache->namecapacity = 0;
+}
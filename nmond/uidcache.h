@@ -0,0 +1,75 @@
+#ifndef UIDCACHE_H
+#define UIDCACHE_H
+
+/**
+ * uidcache.h -- Cache of user names by user ID
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <time.h>
+#include "pidhash.h"
+
+// names are looked up again after this many seconds (directory services
+// users are not in /etc/passwd, so its mtime cannot catch every change)
+#define UIDCACHE_TTL 600
+#define UIDCACHE_PASSWD_PATH "/etc/passwd"
+#define UIDCACHE_NAMES_MIN 32
+
+// names are interned, each distinct name is stored once and the pointer
+// stays valid for the life of the cache (even across refreshes), so
+// callers can hold on to them and compare names by pointer
+struct uidcache {
+	struct hashtable *hash; // uid -> interned name
+	char **names;
+	size_t namecount;
+	size_t namecapacity;
+
+	time_t loaded; // when the uid table was last emptied
+	time_t passwdmtime;
+
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long refreshes;
+};
+#define UIDCACHE_INIT { NULL, NULL, 0, 0, 0, 0, 0, 0, 0 }
+
+extern void uidcacherefresh(struct uidcache*);
+extern char *uidcachename(struct uidcache*, unsigned int);
+extern char *uidcacheintern(struct uidcache*, const char*);
+extern double uidcachehitrate(struct uidcache*);
+extern void uidcachefree(struct uidcache*);
+
+#endif
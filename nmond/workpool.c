@@ -0,0 +1,184 @@
+/**
+ * workpool.c -- Small pool of worker threads for data collection
+ *
+ *
+ * nmond -- Ncurses based System Performance Monitor for Darwin (Mac OS X)
+ *  https://github.com/stollcri/nmond
+ *
+ *
+ * Copyright (c) 2015, Christopher Stoll
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of nmond nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "workpool.h"
+#include <signal.h>
+#include <stdlib.h>
+
+struct workpoolthread {
+	struct workpool *pool;
+	int worker;
+};
+
+static void *workpoolmain(void *threadarg)
+{
+	struct workpoolthread *thread = (struct workpoolthread *)threadarg;
+	struct workpool *pool = thread->pool;
+	int worker = thread->worker;
+	free(thread);
+
+	unsigned long seen = 0;
+	void (*job)(void*, int, int) = NULL;
+	void *arg = NULL;
+	int workers = 0;
+
+	for(;;) {
+		pthread_mutex_lock(&pool->lock);
+		while(!pool->quit && (pool->generation == seen)) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if(pool->quit) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		seen = pool->generation;
+		job = pool->job;
+		arg = pool->arg;
+		workers = pool->workers;
+		pthread_mutex_unlock(&pool->lock);
+
+		job(arg, worker, workers);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->running -= 1;
+		if(!pool->running) {
+			pthread_cond_signal(&pool->done);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/*
+ * Create a pool of workers (the caller counts as one of them)
+ */
+struct workpool *workpoolnew(int workers)
+{
+	if(workers < 1) {
+		workers = 1;
+	} else if(workers > WORKPOOL_MAX_WORKERS) {
+		workers = WORKPOOL_MAX_WORKERS;
+	}
+
+	struct workpool *pool = (struct workpool *)calloc(1, sizeof(struct workpool));
+	if(pool == NULL) {
+		// TODO: handle memory allocation failure
+		return NULL;
+	}
+	pool->workers = 1;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	if(workers > 1) {
+		pool->threads = (pthread_t *)calloc((size_t)workers, sizeof(pthread_t));
+		if(pool->threads == NULL) {
+			// TODO: handle memory allocation failure
+			return pool;
+		}
+	}
+
+	// signals (resize, reload, interrupt) are left to the UI thread
+	sigset_t blocked;
+	sigset_t previous;
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_SETMASK, &blocked, &previous);
+	// a pool with fewer threads than asked for still works
+	for (int i = 1; i < workers; ++i) {
+		struct workpoolthread *thread = (struct workpoolthread *)malloc(sizeof(struct workpoolthread));
+		if(thread == NULL) {
+			break;
+		}
+		thread->pool = pool;
+		thread->worker = i;
+		if(pthread_create(&pool->threads[i], NULL, workpoolmain, thread)) {
+			free(thread);
+			break;
+		}
+		pool->workers += 1;
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	return pool;
+}
+
+/*
+ * Run job on every worker and wait for all of them to finish
+ */
+void workpoolrun(struct workpool *pool, void (*job)(void*, int, int), void *arg)
+{
+	if((pool == NULL) || (pool->workers <= 1)) {
+		job(arg, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->job = job;
+	pool->arg = arg;
+	pool->running = pool->workers - 1;
+	pool->generation += 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	job(arg, 0, pool->workers);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->running) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void workpoolfree(struct workpool *pool)
+{
+	if(pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 1; i < pool->workers; ++i) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
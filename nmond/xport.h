@@ -38,6 +38,13 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "nmond.h"
 
+// what each snapshot holds, the static facts are read once
+#define XPORT_COLLECT (COLLECT_RES | COLLECT_NET | COLLECT_PROC | COLLECT_VM)
+// processes using less CPU (percent) are left out of the TOP lines
+#define XPORT_TOP_MIN 0.1
+
+extern int xportrun(struct nmondstate*, int, char**);
 
 #endif